@@ -26,6 +26,7 @@
 #include <linux/wl12xx.h>
 #include <linux/memblock.h>
 #include <linux/cdc_tcxo.h>
+#include <linux/ktime.h>
 
 #include <mach/omap4-common.h>
 #include <mach/emif.h>
@@ -774,11 +775,26 @@ struct usbhs_omap_board_data usbhs_bdata __initdata = {
 };
 #endif
 
+/*
+ * With initcall_debug, time the board setup steps the same way the
+ * initcalls are timed, so a boot log shows where the board init spends
+ * its time before any driver gets to probe.
+ */
+#define jet_init_step(call)						\
+do {									\
+	ktime_t calltime = ktime_get();					\
+	call;								\
+	if (initcall_debug)						\
+		printk(KERN_DEBUG "jet init: %s took %lld usecs\n", #call,	\
+			(long long)ktime_to_us(ktime_sub(ktime_get(),	\
+							 calltime)));	\
+} while (0)
+
 static void __init omap_4430jet_init(void)
 {
 	int package = OMAP_PACKAGE_CBS;
-	omap4_mux_init(board_mux, NULL, package);
-	jet_gpio_init();
+	jet_init_step(omap4_mux_init(board_mux, NULL, package));
+	jet_init_step(jet_gpio_init());
 	omap_emif_setup_device_details(&emif_devices, &emif_devices);
 
 	omap_board_config = jet4430_config;
@@ -792,27 +808,28 @@ static void __init omap_4430jet_init(void)
 	jet_camera_init();
 #endif
 	jet_set_osc_timings();
-	omap4_i2c_init();
-	jet_power_init();
+	jet_init_step(omap4_i2c_init());
+	jet_init_step(jet_power_init());
 
-	jet_sensor_init();
-	jet_pwbutton_init();
+	jet_init_step(jet_sensor_init());
+	jet_init_step(jet_pwbutton_init());
 	omap4_register_ion();
-	platform_add_devices(jet4430_devices, ARRAY_SIZE(jet4430_devices));
+	jet_init_step(platform_add_devices(jet4430_devices,
+					   ARRAY_SIZE(jet4430_devices)));
 	wake_lock_init(&st_wk_lock, WAKE_LOCK_SUSPEND, "st_wake_lock");
-	omap4_jet4430_wifi_bt_init();
-	omap4_twl6030_hsmmc_init(mmc);
+	jet_init_step(omap4_jet4430_wifi_bt_init());
+	jet_init_step(omap4_twl6030_hsmmc_init(mmc));
 
-	board_serial_init();
+	jet_init_step(board_serial_init());
 
 #ifdef CONFIG_MFD_OMAP_USB_HOST
-	usbhs_init(&usbhs_bdata);
+	jet_init_step(usbhs_init(&usbhs_bdata));
 #endif
-	usb_musb_init(&musb_board_data);
+	jet_init_step(usb_musb_init(&musb_board_data));
 
 	omap_dmm_init();
 
-	omap_4430jet_display_init();
+	jet_init_step(omap_4430jet_display_init());
 	init_duty_governor();
 
 	omap_enable_smartreflex_on_init();
@@ -25,6 +25,9 @@
 #include <linux/io.h>
 
 #include <linux/bitops.h>
+#include <linux/sched.h>
+
+#include <trace/events/power.h>
 
 #include <plat/clock.h>
 #include "clockdomain.h"
@@ -252,6 +255,32 @@ static void _resolve_clkdm_deps(struct clockdomain *clkdm,
 	}
 }
 
+/**
+ * _clkdm_account - trace a clockdomain usecount edge and track residency
+ * @clkdm: struct clockdomain *
+ * @active: true if @clkdm gained its first enabled clock, false if it
+ *	lost its last one
+ *
+ * Called from clkdm_clk_enable()/clkdm_clk_disable() with the clock
+ * framework lock held.  The accumulated active time is reported through
+ * pm_debug/clkdm_time.  No return value.
+ */
+static void _clkdm_account(struct clockdomain *clkdm, bool active)
+{
+#ifdef CONFIG_PM_DEBUG
+	s64 t = sched_clock();
+
+	if (active) {
+		clkdm->active_stamp = t;
+		clkdm->active_count++;
+	} else if (clkdm->active_stamp) {
+		clkdm->active_time += t - clkdm->active_stamp;
+		clkdm->active_stamp = 0;
+	}
+#endif
+	trace_clock_domain_target(clkdm->name, active, smp_processor_id());
+}
+
 /* Public functions */
 
 /**
@@ -840,6 +869,8 @@ int clkdm_is_idle(struct clockdomain *clkdm)
  */
 int clkdm_clk_enable(struct clockdomain *clkdm, struct clk *clk)
 {
+	int usecount;
+
 	/*
 	 * XXX Rewrite this code to maintain a list of enabled
 	 * downstream clocks for debugging purposes?
@@ -856,7 +887,11 @@ int clkdm_clk_enable(struct clockdomain *clkdm, struct clk *clk)
 	 * should be called for every clock instance that is
 	 * enabled, so the clkdm can be force woken up.
 	 */
-	if ((atomic_inc_return(&clkdm->usecount) > 1) && autodeps)
+	usecount = atomic_inc_return(&clkdm->usecount);
+	if (usecount == 1)
+		_clkdm_account(clkdm, true);
+
+	if ((usecount > 1) && autodeps)
 		return 0;
 
 	/* Clockdomain now has one enabled downstream clock */
@@ -910,6 +945,8 @@ int clkdm_clk_disable(struct clockdomain *clkdm, struct clk *clk)
 
 	/* All downstream clocks of this clockdomain are now disabled */
 
+	_clkdm_account(clkdm, false);
+
 	pr_debug("clockdomain: clkdm %s: clk %s now disabled\n", clkdm->name,
 		 clk->name);
 
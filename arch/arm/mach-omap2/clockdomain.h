@@ -98,6 +98,10 @@ struct clkdm_dep {
  * @omap_chip: OMAP chip types that this clockdomain is valid on
  * @usecount: Usecount tracking
  * @node: list_head to link all clockdomains together
+ * @active_stamp: sched_clock() when @usecount last left 0 (PM debug only)
+ * @active_time: accumulated time with @usecount above 0, in ns
+ * @active_count: number of times @usecount left 0
+ * @block_count: number of missed pwrdm targets while this clkdm was active
  *
  * @prcm_partition should be a macro from mach-omap2/prcm44xx.h (OMAP4 only)
  * @cm_inst should be a macro ending in _INST from the OMAP4 CM instance
@@ -122,6 +126,12 @@ struct clockdomain {
 	const struct omap_chip_id omap_chip;
 	atomic_t usecount;
 	struct list_head node;
+#ifdef CONFIG_PM_DEBUG
+	s64 active_stamp;
+	s64 active_time;
+	u32 active_count;
+	u32 block_count;
+#endif
 };
 
 /**
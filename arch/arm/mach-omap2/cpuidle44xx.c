@@ -19,6 +19,9 @@
 #include <linux/cpu.h>
 #include <linux/delay.h>
 #include <linux/cpu_pm.h>
+#include <linux/bitops.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <asm/cacheflush.h>
 #include <asm/proc-fns.h>
@@ -78,6 +81,11 @@ module_param(only_state, int, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(only_state,
 	"Select only power state allowed (0=any, 1=WFI, 2=INA, 3=CSWR, 4=OSWR)");
 
+static bool predict = true;
+module_param(predict, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(predict,
+	"Demote shared C-states when a periodic wakeup source is due first");
+
 static const int omap4_poke_interrupt[2] = {
 	OMAP44XX_IRQ_CPUIDLE_POKE0,
 	OMAP44XX_IRQ_CPUIDLE_POKE1
@@ -110,6 +118,61 @@ static struct clockdomain *cpu1_cd;
  * C4		769		1323
  */
 
+/*
+ * Idle prediction.  The menu governor only knows about the next timer
+ * event; periodic device interrupts (sensor polls on I2C/GPIO, mailbox
+ * traffic, GP timers) keep waking the MPU out of shared C-states long
+ * before they break even.  Each cpu learns, per GIC interrupt, the
+ * interval between the wakeups that interrupt caused, and at idle entry
+ * demotes the requested state when a source that fires periodically is
+ * due before the state's target residency.  As the shared state is the
+ * shallowest one requested by either cpu, a prediction on one cpu also
+ * protects the coupled entry.
+ */
+#define OMAP4_IDLE_NR_WAKE_IRQS	(OMAP44XX_IRQ_GIC_START + 128)
+/* ignore intervals longer than this, they tell nothing about the next idle */
+#define OMAP4_IDLE_MAX_INTERVAL	(10 * USEC_PER_SEC)
+/* wakeups needed before a source is trusted */
+#define OMAP4_IDLE_MIN_COUNT	3
+
+struct omap4_idle_wake_src {
+	ktime_t last;
+	u32 interval;
+	u32 deviation;
+	u32 count;
+};
+
+/**
+ * struct omap4_idle_predictor - per-cpu wakeup statistics
+ * @src:		per-interrupt wakeup history
+ * @periodic:		interrupts whose wakeups are currently regular
+ * @requested:		state asked for by the governor on the last entry
+ * @predicted_us:	predicted idle time of the last entry, 0 if none
+ * @predictions:	entries for which a prediction was available
+ * @hits:		predictions within 25% of the measured idle time
+ * @early:		wakeups more than 25% before the prediction
+ * @late:		wakeups more than 25% after the prediction
+ * @demotions:		entries demoted by the prediction
+ * @demote_misses:	demotions where the requested state would have paid
+ * @breakeven_misses:	shared state entries exited before break-even
+ * @wakeups:		wakeups attributed to an interrupt
+ */
+struct omap4_idle_predictor {
+	struct omap4_idle_wake_src src[OMAP4_IDLE_NR_WAKE_IRQS];
+	DECLARE_BITMAP(periodic, OMAP4_IDLE_NR_WAKE_IRQS);
+	struct omap4_processor_cx *requested;
+	u32 predicted_us;
+	u32 predictions;
+	u32 hits;
+	u32 early;
+	u32 late;
+	u32 demotions;
+	u32 demote_misses;
+	u32 breakeven_misses;
+	u32 wakeups;
+};
+static DEFINE_PER_CPU(struct omap4_idle_predictor, omap4_idle_pred);
+
 static struct cpuidle_params cpuidle_params_table[] = {
 	/* C1 - CPUx WFI + MPU ON  + CORE ON */
 	{.exit_latency = 2 + 2,	.target_residency = 5, .valid = 1},
@@ -212,6 +275,138 @@ static void omap4_poke_cpu(int cpu)
 	__raw_writel(bit, gic_dist + GIC_DIST_PENDING_SET + reg);
 }
 
+/**
+ * omap4_idle_predict
+ * @cpu: cpu entering idle
+ * @cx: state requested by the governor
+ *
+ * Returns the deepest state that the periodic wakeup sources of @cpu
+ * leave time for, which is @cx itself when nothing is due before its
+ * target residency.
+ */
+static struct omap4_processor_cx *omap4_idle_predict(int cpu,
+	struct omap4_processor_cx *cx)
+{
+	struct omap4_idle_predictor *pred = &per_cpu(omap4_idle_pred, cpu);
+	ktime_t now = ktime_get();
+	u32 next_us = (u32)~0;
+	int irq, i;
+
+	pred->requested = cx;
+	pred->predicted_us = 0;
+
+	for_each_set_bit(irq, pred->periodic, OMAP4_IDLE_NR_WAKE_IRQS) {
+		struct omap4_idle_wake_src *src = &pred->src[irq];
+		s64 elapsed = ktime_to_us(ktime_sub(now, src->last));
+		u64 periods;
+		u32 due;
+
+		if (elapsed < 0 || elapsed > OMAP4_IDLE_MAX_INTERVAL) {
+			clear_bit(irq, pred->periodic);
+			continue;
+		}
+
+		/* next expected wakeup, allowing for the usual jitter */
+		periods = elapsed;
+		due = src->interval - do_div(periods, src->interval);
+		due = (due > src->deviation) ? due - src->deviation : 0;
+		if (due < next_us)
+			next_us = due;
+	}
+
+	if (next_us == (u32)~0 || !predict)
+		return cx;
+
+	pred->predicted_us = next_us ? next_us : 1;
+	pred->predictions++;
+
+	if (next_us >= cx->target_residency)
+		return cx;
+
+	for (i = cx->type - 1; i > OMAP4_STATE_C1; i--) {
+		if (omap4_power_states[i].valid &&
+		    omap4_power_states[i].target_residency <= next_us)
+			break;
+	}
+
+	pred->demotions++;
+	return &omap4_power_states[i];
+}
+
+/**
+ * omap4_idle_account
+ * @cpu: cpu leaving idle
+ * @actual_cx: state the cpu actually reached
+ * @idle_us: time spent in idle
+ *
+ * Called with irqs still disabled, so the interrupt that ended idle is
+ * still the highest pending one in the GIC.
+ */
+static void omap4_idle_account(int cpu, struct omap4_processor_cx *actual_cx,
+	s64 idle_us)
+{
+	struct omap4_idle_predictor *pred = &per_cpu(omap4_idle_pred, cpu);
+	void __iomem *gic_cpu = omap4_get_gic_cpu_base();
+	struct omap4_idle_wake_src *src;
+	u32 irq = __raw_readl(gic_cpu + GIC_CPU_HIGHPRI) & 0x3FF;
+	ktime_t now = ktime_get();
+	s64 sample;
+
+	if (pred->predicted_us) {
+		u32 slack = pred->predicted_us / 4;
+
+		if (idle_us + slack < pred->predicted_us)
+			pred->early++;
+		else if (idle_us > pred->predicted_us + slack)
+			pred->late++;
+		else
+			pred->hits++;
+	}
+
+	if (pred->requested && actual_cx->type < pred->requested->type &&
+	    idle_us >= pred->requested->target_residency)
+		pred->demote_misses++;
+	pred->requested = NULL;
+	pred->predicted_us = 0;
+
+	if (actual_cx->type != OMAP4_STATE_C1 &&
+	    idle_us < actual_cx->target_residency)
+		pred->breakeven_misses++;
+
+	if (irq >= OMAP4_IDLE_NR_WAKE_IRQS ||
+	    irq == omap4_poke_interrupt[0] || irq == omap4_poke_interrupt[1])
+		return;
+
+	pred->wakeups++;
+	src = &pred->src[irq];
+	sample = ktime_to_us(ktime_sub(now, src->last));
+	src->last = now;
+
+	if (!src->count || sample <= 0 || sample > OMAP4_IDLE_MAX_INTERVAL) {
+		src->count = 1;
+		src->interval = 0;
+		src->deviation = 0;
+		clear_bit(irq, pred->periodic);
+		return;
+	}
+
+	if (src->count++ == 1) {
+		src->interval = sample;
+	} else {
+		u32 diff = abs((s32)sample - (s32)src->interval);
+
+		src->deviation = (src->deviation * 3 + diff) / 4;
+		src->interval = (src->interval * 7 + (u32)sample) / 8;
+	}
+
+	/* only trust sources whose jitter is small against their period */
+	if (src->count > OMAP4_IDLE_MIN_COUNT && src->interval &&
+	    src->deviation * 4 <= src->interval)
+		set_bit(irq, pred->periodic);
+	else
+		clear_bit(irq, pred->periodic);
+}
+
 /**
  * omap4_enter_idle
  * @dev: cpuidle device
@@ -234,6 +429,9 @@ static int omap4_enter_idle_wfi(struct cpuidle_device *dev,
 
 	postidle = ktime_get();
 
+	omap4_idle_account(dev->cpu, &omap4_power_states[OMAP4_STATE_C1],
+			   ktime_to_us(ktime_sub(postidle, preidle)));
+
 	local_fiq_enable();
 	local_irq_enable();
 
@@ -442,6 +640,8 @@ static int omap4_enter_idle(struct cpuidle_device *dev,
 			cx = &omap4_power_states[only_state - 1];
 	}
 
+	cx = omap4_idle_predict(cpu, cx);
+
 	if (cx->type == OMAP4_STATE_C1)
 		return omap4_enter_idle_wfi(dev, state);
 
@@ -588,6 +788,9 @@ static int omap4_enter_idle(struct cpuidle_device *dev,
 out:
 	postidle = ktime_get();
 
+	omap4_idle_account(cpu, actual_cx,
+			   ktime_to_us(ktime_sub(postidle, preidle)));
+
 	omap4_update_actual_state(dev, actual_cx);
 
 	local_irq_enable();
@@ -668,6 +871,82 @@ void omap4_init_power_states(void)
 
 }
 
+#ifdef CONFIG_DEBUG_FS
+static const char *omap4_idle_irq_class(int irq)
+{
+	if (irq == OMAP44XX_IRQ_LOCALTIMER ||
+	    (irq >= OMAP44XX_IRQ_GPT1 && irq <= OMAP44XX_IRQ_GPT11) ||
+	    irq == OMAP44XX_IRQ_GPT12)
+		return "timer";
+	if (irq == OMAP44XX_IRQ_I2C1 || irq == OMAP44XX_IRQ_I2C2 ||
+	    irq == OMAP44XX_IRQ_I2C3 || irq == OMAP44XX_IRQ_I2C4)
+		return "i2c";
+	if (irq >= OMAP44XX_IRQ_GPIO1 && irq <= OMAP44XX_IRQ_GPIO6)
+		return "gpio";
+	if (irq == OMAP44XX_IRQ_MAIL_U0)
+		return "mailbox";
+	return "other";
+}
+
+static int omap4_idle_pred_show(struct seq_file *s, void *unused)
+{
+	int cpu, irq;
+
+	for_each_possible_cpu(cpu) {
+		struct omap4_idle_predictor *pred =
+			&per_cpu(omap4_idle_pred, cpu);
+
+		seq_printf(s, "cpu%d: predictions %u hits %u early %u "
+			   "late %u demotions %u demote_misses %u "
+			   "breakeven_misses %u wakeups %u\n", cpu,
+			   pred->predictions, pred->hits, pred->early,
+			   pred->late, pred->demotions, pred->demote_misses,
+			   pred->breakeven_misses, pred->wakeups);
+
+		for (irq = 0; irq < OMAP4_IDLE_NR_WAKE_IRQS; irq++) {
+			struct omap4_idle_wake_src *src = &pred->src[irq];
+
+			if (src->count < 2)
+				continue;
+			seq_printf(s, "  irq %3d %-7s count %u interval %uus "
+				   "deviation %uus%s\n", irq,
+				   omap4_idle_irq_class(irq), src->count,
+				   src->interval, src->deviation,
+				   test_bit(irq, pred->periodic) ?
+				   " periodic" : "");
+		}
+	}
+
+	return 0;
+}
+
+static int omap4_idle_pred_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap4_idle_pred_show, inode->i_private);
+}
+
+static const struct file_operations omap4_idle_pred_fops = {
+	.open = omap4_idle_pred_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void __init omap4_idle_debugfs_init(void)
+{
+	struct dentry *d;
+
+	d = debugfs_create_dir("omap4_idle", NULL);
+	if (IS_ERR_OR_NULL(d))
+		return;
+
+	(void) debugfs_create_file("predictor", S_IRUGO, d, NULL,
+				   &omap4_idle_pred_fops);
+}
+#else
+static inline void omap4_idle_debugfs_init(void) { }
+#endif
+
 struct cpuidle_driver omap4_idle_driver = {
 	.name =		"omap4_idle",
 	.owner =	THIS_MODULE,
@@ -737,6 +1016,8 @@ int __init omap4_idle_init(void)
 			GIC_DIST_TARGET + omap4_poke_interrupt[cpu_id]);
 	}
 
+	omap4_idle_debugfs_init();
+
 	return 0;
 }
 #else
@@ -17,6 +17,10 @@
 #include <linux/err.h>
 #include <linux/slab.h>
 #include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/opp.h>
+#include <linux/rcupdate.h>
+#include <linux/thermal_framework.h>
 
 #include <mach/hardware.h>
 #include <mach/irqs.h>
@@ -932,6 +936,106 @@ int omap_device_scale_gpu(struct device *req_dev, struct device *target_dev,
 }
 #endif
 
+#ifdef CONFIG_OMAP_THERMAL
+/*
+ * Skin cooling for the SGX.  Rate requests from the GPU driver go through
+ * omap_gpu_thermal_scale(), which remembers the last one and caps it at
+ * omap_gpu_max_rate, so the cap can be moved and re-applied at any time.
+ */
+static DEFINE_MUTEX(omap_gpu_thermal_lock);
+static struct device *omap_gpu_dev;
+static struct device *omap_gpu_req_dev;
+static struct device *omap_gpu_target_dev;
+static unsigned long omap_gpu_req_rate;
+static unsigned long omap_gpu_max_rate = ULONG_MAX;
+
+static int omap_gpu_do_scale(struct device *req_dev,
+			struct device *target_dev, unsigned long rate)
+{
+#ifdef CONFIG_OMAP4_DPLL_CASCADING
+	return omap_device_scale_gpu(req_dev, target_dev, rate);
+#else
+	return omap_device_scale(req_dev, target_dev, rate);
+#endif
+}
+
+static int omap_gpu_thermal_scale(struct device *req_dev,
+			struct device *target_dev, unsigned long rate)
+{
+	int ret;
+
+	mutex_lock(&omap_gpu_thermal_lock);
+	omap_gpu_req_dev = req_dev;
+	omap_gpu_target_dev = target_dev;
+	omap_gpu_req_rate = rate;
+	ret = omap_gpu_do_scale(req_dev, target_dev,
+				min(rate, omap_gpu_max_rate));
+	mutex_unlock(&omap_gpu_thermal_lock);
+
+	return ret;
+}
+
+/* @throttle: share of the GPU OPP range to shed, 0..1000 */
+static int omap_gpu_cool_device(struct thermal_dev *tdev, int throttle)
+{
+	unsigned long min_rate = 0, max_rate = ULONG_MAX, cap;
+	struct opp *opp;
+	int ret = 0;
+
+	throttle = clamp(throttle, 0, 1000);
+
+	rcu_read_lock();
+	opp = opp_find_freq_ceil(omap_gpu_dev, &min_rate);
+	if (!IS_ERR(opp))
+		opp = opp_find_freq_floor(omap_gpu_dev, &max_rate);
+	if (IS_ERR(opp)) {
+		rcu_read_unlock();
+		return PTR_ERR(opp);
+	}
+	cap = max_rate - (max_rate - min_rate) / 1000 * throttle;
+	opp = opp_find_freq_floor(omap_gpu_dev, &cap);
+	if (IS_ERR(opp))
+		cap = min_rate;
+	rcu_read_unlock();
+
+	if (!throttle)
+		cap = ULONG_MAX;
+
+	mutex_lock(&omap_gpu_thermal_lock);
+	if (cap != omap_gpu_max_rate) {
+		pr_debug("%s: throttle %d, cap %lu\n", __func__, throttle, cap);
+		omap_gpu_max_rate = cap;
+		if (omap_gpu_req_dev)
+			ret = omap_gpu_do_scale(omap_gpu_req_dev,
+					omap_gpu_target_dev,
+					min(omap_gpu_req_rate, cap));
+	}
+	mutex_unlock(&omap_gpu_thermal_lock);
+
+	return ret;
+}
+
+static struct thermal_dev_ops omap_gpu_cooling_ops = {
+	.cool_device = omap_gpu_cool_device,
+};
+
+static struct thermal_dev omap_gpu_cooling = {
+	.name		= "gpu_cooling",
+	.domain_name	= "skin",
+	.dev_ops	= &omap_gpu_cooling_ops,
+};
+
+static int __init omap_gpu_cooling_init(void)
+{
+	if (!omap_gpu_dev)
+		return 0;
+
+	omap_gpu_cooling.dev = omap_gpu_dev;
+	return thermal_cooling_dev_register(&omap_gpu_cooling);
+}
+late_initcall(omap_gpu_cooling_init);
+#endif
+
 static void omap_init_gpu(void)
 {
 	struct omap_hwmod *oh;
@@ -960,7 +1064,9 @@ static void omap_init_gpu(void)
 		pr_err("omap_init_gpu: Platform data memory allocation failed\n");
 		return;
 	}
-#ifdef CONFIG_OMAP4_DPLL_CASCADING
+#if defined(CONFIG_OMAP_THERMAL)
+	pdata->device_scale = omap_gpu_thermal_scale;
+#elif defined(CONFIG_OMAP4_DPLL_CASCADING)
 	pdata->device_scale = omap_device_scale_gpu;
 #else
 	pdata->device_scale = omap_device_scale;
@@ -981,6 +1087,10 @@ static void omap_init_gpu(void)
 			     omap_gpu_latency, ARRAY_SIZE(omap_gpu_latency), 0);
 	WARN(IS_ERR(od), "Could not build omap_device for %s %s\n",
 	     name, oh_name);
+#ifdef CONFIG_OMAP_THERMAL
+	if (!IS_ERR(od))
+		omap_gpu_dev = &od->pdev.dev;
+#endif
 
 	kfree(pdata);
 }
@@ -27,6 +27,9 @@
 #include <linux/io.h>
 #include <linux/bitops.h>
 #include <linux/clkdev.h>
+#include <linux/sched.h>
+#include <linux/math64.h>
+#include <trace/events/power.h>
 
 #include <plat/cpu.h>
 #include <plat/clock.h>
@@ -179,6 +182,60 @@ static u16 _omap3_dpll_compute_freqsel(struct clk *clk, u8 n)
 	return f;
 }
 
+#ifdef CONFIG_PM_DEBUG
+/*
+ * _omap3_dpll_stats - update the lock statistics of a DPLL
+ * @dd: pointer to the DPLL's struct dpll_data
+ * @locked: true if the DPLL just locked, false if it bypassed or stopped
+ * @now: sched_clock() value of the transition
+ * @lock_us: time the DPLL took to lock, in microseconds
+ */
+static void _omap3_dpll_stats(struct dpll_data *dd, bool locked, u64 now,
+			      u32 lock_us)
+{
+	if (locked) {
+		dd->lock_count++;
+		dd->lock_us_last = lock_us;
+		if (lock_us > dd->lock_us_max)
+			dd->lock_us_max = lock_us;
+		if (!dd->lock_stamp)
+			dd->lock_stamp = now;
+	} else if (dd->lock_stamp) {
+		dd->locked_time += now - dd->lock_stamp;
+		dd->lock_stamp = 0;
+	}
+}
+#else
+static inline void _omap3_dpll_stats(struct dpll_data *dd, bool locked,
+				     u64 now, u32 lock_us)
+{
+}
+#endif
+
+/*
+ * _omap3_dpll_account - trace a DPLL transition and update its statistics
+ * @clk: pointer to a DPLL struct clk
+ * @locked: true if the DPLL just locked, false if it bypassed or stopped
+ * @start: sched_clock() value taken before the lock was requested
+ *
+ * Only transitions requested through the clock framework are seen here,
+ * hardware autoidle of the DPLL is not.  Locked residency is therefore
+ * counted from the first software lock of a DPLL left locked by the
+ * bootloader.
+ */
+static void _omap3_dpll_account(struct clk *clk, bool locked, u64 start)
+{
+	u64 now = sched_clock();
+	u32 lock_us = 0;
+
+	if (locked)
+		lock_us = (u32)div_u64(now - start, NSEC_PER_USEC);
+
+	_omap3_dpll_stats(clk->dpll_data, locked, now, lock_us);
+
+	trace_dpll_transition(clk->name, locked, lock_us);
+}
+
 /*
  * _omap3_noncore_dpll_lock - instruct a DPLL to lock and wait for readiness
  * @clk: pointer to a DPLL struct clk
@@ -192,6 +249,7 @@ static u16 _omap3_dpll_compute_freqsel(struct clk *clk, u8 n)
 static int _omap3_noncore_dpll_lock(struct clk *clk)
 {
 	const struct dpll_data *dd;
+	u64 start;
 	u8 ai;
 	u8 state = 1;
 	int r = 0;
@@ -209,9 +267,13 @@ static int _omap3_noncore_dpll_lock(struct clk *clk)
 
 	omap3_dpll_deny_idle(clk);
 
+	start = sched_clock();
+
 	_omap3_dpll_write_clken(clk, DPLL_LOCKED);
 
 	r = _omap3_wait_dpll_status(clk, 1);
+	if (!r)
+		_omap3_dpll_account(clk, true, start);
 
 	if (ai)
 		omap3_dpll_allow_idle(clk);
@@ -249,6 +311,8 @@ static int _omap3_noncore_dpll_bypass(struct clk *clk)
 	_omap3_dpll_write_clken(clk, DPLL_LOW_POWER_BYPASS);
 
 	r = _omap3_wait_dpll_status(clk, 0);
+	if (!r)
+		_omap3_dpll_account(clk, false, 0);
 
 	if (ai)
 		omap3_dpll_allow_idle(clk);
@@ -279,6 +343,7 @@ static int _omap3_noncore_dpll_stop(struct clk *clk)
 	ai = omap3_dpll_autoidle_read(clk);
 
 	_omap3_dpll_write_clken(clk, DPLL_LOW_POWER_STOP);
+	_omap3_dpll_account(clk, false, 0);
 
 	if (ai)
 		omap3_dpll_allow_idle(clk);
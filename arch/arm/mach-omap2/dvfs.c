@@ -153,6 +153,8 @@ struct omap_dev_user_list {
  * @freq_user_list: The list of users for vdd device
  * @clk:	frequency control clock for this dev
  * @user_lock:	The lock for plist manipulation
+ * @user_hint:	last user updated in @freq_user_list, checked before
+ *		walking the list
  */
 struct omap_vdd_dev_list {
 	struct device *dev;
@@ -160,6 +162,7 @@ struct omap_vdd_dev_list {
 	struct plist_head freq_user_list;
 	struct clk *clk;
 	spinlock_t user_lock; /* spinlock for plist */
+	struct omap_dev_user_list *user_hint;
 };
 
 /**
@@ -173,6 +176,44 @@ struct omap_vdd_user_list {
 	struct plist_node node;
 };
 
+struct omap_vdd_dvfs_info;
+
+/**
+ * struct omap_dvfs_dep_action - A resolved request on a dependent domain
+ * @dvfs_info:	omap_vdd_dvfs_info of the dependent vdd
+ * @tdev:	device of the dependent vdd which receives the request
+ * @freq:	frequency to request for @tdev
+ * @volt:	voltage to request on the dependent vdd
+ */
+struct omap_dvfs_dep_action {
+	struct omap_vdd_dvfs_info *dvfs_info;
+	struct omap_vdd_dev_list *tdev;
+	unsigned long freq;
+	unsigned long volt;
+};
+
+/* omap_dvfs_dep_map.nr_actions values other than an action count */
+#define DVFS_DEP_MAP_UNCOMPILED	-1
+#define DVFS_DEP_MAP_INVALID	-2
+
+/**
+ * struct omap_dvfs_dep_map - Dependent domain requests for one vdd OPP
+ * @main_volt:	nominal voltage of the vdd OPP this entry describes
+ * @nr_actions:	number of entries in @actions, or DVFS_DEP_MAP_UNCOMPILED /
+ *		DVFS_DEP_MAP_INVALID
+ * @actions:	requests to place on every dependent domain
+ *
+ * The voltage dependency tables and OPP tables do not change once the
+ * system has booted (all opp_enable/opp_disable callers are __init), so
+ * the outcome of _dep_scan_table() for a given vdd and voltage is fixed.
+ * It is resolved on first use and replayed from here afterwards.
+ */
+struct omap_dvfs_dep_map {
+	unsigned long main_volt;
+	int nr_actions;
+	struct omap_dvfs_dep_action *actions;
+};
+
 /**
  * struct omap_vdd_dvfs_info - The per vdd dvfs info
  * @node:	list node for vdd_dvfs_info list
@@ -180,6 +221,10 @@ struct omap_vdd_user_list {
  * @vdd_user_list: The vdd user list
  * @voltdm:	Voltage domains for which dvfs info stored
  * @dev_list:	Device list maintained per domain
+ * @user_hint:	last user updated in @vdd_user_list, checked before
+ *		walking the list
+ * @dep_map:	dependency map, one entry per voltage of the vdd
+ * @nr_dep_map:	number of entries in @dep_map
  *
  * This is a fundamental structure used to store all the required
  * DVFS related information for a vdd.
@@ -191,6 +236,10 @@ struct omap_vdd_dvfs_info {
 	struct plist_head vdd_user_list;
 	struct voltagedomain *voltdm;
 	struct list_head dev_list;
+	struct omap_vdd_user_list *user_hint;
+
+	struct omap_dvfs_dep_map *dep_map;
+	int nr_dep_map;
 };
 
 static LIST_HEAD(omap_dvfs_info_list);
@@ -269,6 +318,26 @@ struct omap_vdd_dvfs_info *_voltdm_to_dvfs_info(struct voltagedomain *voltdm)
 	return NULL;
 }
 
+/**
+ * _dvfs_info_to_vdd_dev() - Locate the vdd device entry for a device
+ * @dvfs_info:	dvfs_info of the vdd the device belongs to
+ * @dev:	dev to search for
+ *
+ * Returns NULL on failure.
+ */
+static struct omap_vdd_dev_list *_dvfs_info_to_vdd_dev(
+		struct omap_vdd_dvfs_info *dvfs_info, struct device *dev)
+{
+	struct omap_vdd_dev_list *temp_dev;
+
+	list_for_each_entry(temp_dev, &dvfs_info->dev_list, node) {
+		if (temp_dev->dev == dev)
+			return temp_dev;
+	}
+
+	return NULL;
+}
+
 /* rest of the helper functions */
 /**
  * _add_vdd_user() - Add a voltage request
@@ -293,10 +362,15 @@ static int _add_vdd_user(struct omap_vdd_dvfs_info *dvfs_info,
 	}
 
 	spin_lock(&dvfs_info->user_lock);
-	plist_for_each_entry(temp_user, &dvfs_info->vdd_user_list, node) {
-		if (temp_user->dev == dev) {
-			user = temp_user;
-			break;
+	if (dvfs_info->user_hint && dvfs_info->user_hint->dev == dev) {
+		user = dvfs_info->user_hint;
+	} else {
+		plist_for_each_entry(temp_user, &dvfs_info->vdd_user_list,
+				     node) {
+			if (temp_user->dev == dev) {
+				user = temp_user;
+				break;
+			}
 		}
 	}
 
@@ -310,13 +384,17 @@ static int _add_vdd_user(struct omap_vdd_dvfs_info *dvfs_info,
 			return -ENOMEM;
 		}
 		user->dev = dev;
+	} else if (user->node.prio == volt) {
+		/* Same request again, the maximum cannot change */
+		goto out;
 	} else {
 		plist_del(&user->node, &dvfs_info->vdd_user_list);
 	}
 
 	plist_node_init(&user->node, volt);
 	plist_add(&user->node, &dvfs_info->vdd_user_list);
-
+out:
+	dvfs_info->user_hint = user;
 	spin_unlock(&dvfs_info->user_lock);
 	return 0;
 }
@@ -350,9 +428,11 @@ static int _remove_vdd_user(struct omap_vdd_dvfs_info *dvfs_info,
 		}
 	}
 
-	if (user)
+	if (user) {
 		plist_del(&user->node, &dvfs_info->vdd_user_list);
-	else {
+		if (dvfs_info->user_hint == user)
+			dvfs_info->user_hint = NULL;
+	} else {
 		dev_err(dev, "%s: Unable to find the user for vdd_%s\n",
 					__func__, dvfs_info->voltdm->name);
 		ret = -ENOENT;
@@ -365,44 +445,30 @@ static int _remove_vdd_user(struct omap_vdd_dvfs_info *dvfs_info,
 }
 
 /**
- * _add_freq_request() - Add a requested device frequency
+ * __add_freq_request() - Add a requested frequency to a vdd device
  * @dvfs_info:	omap_vdd_dvfs_info pointer for the required vdd
+ * @temp_dev:	vdd device entry for which the request is being made
  * @req_dev:	device making the request
- * @target_dev:	target device for which frequency request is being made
  * @freq:	target device frequency
  *
- * This adds a requested frequency into target device's frequency list.
- *
  * Returns 0 on success.
  */
-static int _add_freq_request(struct omap_vdd_dvfs_info *dvfs_info,
-	struct device *req_dev, struct device *target_dev, unsigned long freq)
+static int __add_freq_request(struct omap_vdd_dvfs_info *dvfs_info,
+	struct omap_vdd_dev_list *temp_dev, struct device *req_dev,
+	unsigned long freq)
 {
 	struct omap_dev_user_list *dev_user = NULL, *tmp_user;
-	struct omap_vdd_dev_list *temp_dev;
-
-	if (!dvfs_info || IS_ERR(dvfs_info)) {
-		dev_warn(target_dev, "%s: VDD specified does not exist!\n",
-			__func__);
-		return -EINVAL;
-	}
-
-	list_for_each_entry(temp_dev, &dvfs_info->dev_list, node) {
-		if (temp_dev->dev == target_dev)
-			break;
-	}
-
-	if (temp_dev->dev != target_dev) {
-		dev_warn(target_dev, "%s: target_dev does not exist!\n",
-			__func__);
-		return -EINVAL;
-	}
 
 	spin_lock(&temp_dev->user_lock);
-	plist_for_each_entry(tmp_user, &temp_dev->freq_user_list, node) {
-		if (tmp_user->dev == req_dev) {
-			dev_user = tmp_user;
-			break;
+	if (temp_dev->user_hint && temp_dev->user_hint->dev == req_dev) {
+		dev_user = temp_dev->user_hint;
+	} else {
+		plist_for_each_entry(tmp_user, &temp_dev->freq_user_list,
+				     node) {
+			if (tmp_user->dev == req_dev) {
+				dev_user = tmp_user;
+				break;
+			}
 		}
 	}
 
@@ -410,23 +476,59 @@ static int _add_freq_request(struct omap_vdd_dvfs_info *dvfs_info,
 		dev_user = kzalloc(sizeof(struct omap_dev_user_list),
 					GFP_ATOMIC);
 		if (!dev_user) {
-			dev_err(target_dev,
+			dev_err(temp_dev->dev,
 				"%s: Unable to creat a new user for vdd_%s\n",
 				__func__, dvfs_info->voltdm->name);
 			spin_unlock(&temp_dev->user_lock);
 			return -ENOMEM;
 		}
 		dev_user->dev = req_dev;
+	} else if (dev_user->node.prio == freq) {
+		goto out;
 	} else {
 		plist_del(&dev_user->node, &temp_dev->freq_user_list);
 	}
 
 	plist_node_init(&dev_user->node, freq);
 	plist_add(&dev_user->node, &temp_dev->freq_user_list);
+out:
+	temp_dev->user_hint = dev_user;
 	spin_unlock(&temp_dev->user_lock);
 	return 0;
 }
 
+/**
+ * _add_freq_request() - Add a requested device frequency
+ * @dvfs_info:	omap_vdd_dvfs_info pointer for the required vdd
+ * @req_dev:	device making the request
+ * @target_dev:	target device for which frequency request is being made
+ * @freq:	target device frequency
+ *
+ * This adds a requested frequency into target device's frequency list.
+ *
+ * Returns 0 on success.
+ */
+static int _add_freq_request(struct omap_vdd_dvfs_info *dvfs_info,
+	struct device *req_dev, struct device *target_dev, unsigned long freq)
+{
+	struct omap_vdd_dev_list *temp_dev;
+
+	if (!dvfs_info || IS_ERR(dvfs_info)) {
+		dev_warn(target_dev, "%s: VDD specified does not exist!\n",
+			__func__);
+		return -EINVAL;
+	}
+
+	temp_dev = _dvfs_info_to_vdd_dev(dvfs_info, target_dev);
+	if (!temp_dev) {
+		dev_warn(target_dev, "%s: target_dev does not exist!\n",
+			__func__);
+		return -EINVAL;
+	}
+
+	return __add_freq_request(dvfs_info, temp_dev, req_dev, freq);
+}
+
 /**
  * _remove_freq_request() - Remove the requested device frequency
  *
@@ -451,13 +553,8 @@ static int _remove_freq_request(struct omap_vdd_dvfs_info *dvfs_info,
 		return -EINVAL;
 	}
 
-
-	list_for_each_entry(temp_dev, &dvfs_info->dev_list, node) {
-		if (temp_dev->dev == target_dev)
-			break;
-	}
-
-	if (temp_dev->dev != target_dev) {
+	temp_dev = _dvfs_info_to_vdd_dev(dvfs_info, target_dev);
+	if (!temp_dev) {
 		dev_warn(target_dev, "%s: target_dev does not exist!\n",
 			__func__);
 		return -EINVAL;
@@ -473,6 +570,8 @@ static int _remove_freq_request(struct omap_vdd_dvfs_info *dvfs_info,
 
 	if (dev_user) {
 		plist_del(&dev_user->node, &temp_dev->freq_user_list);
+		if (temp_dev->user_hint == dev_user)
+			temp_dev->user_hint = NULL;
 	} else {
 		dev_err(target_dev,
 			"%s: Unable to remove the user for vdd_%s\n",
@@ -487,25 +586,27 @@ static int _remove_freq_request(struct omap_vdd_dvfs_info *dvfs_info,
 }
 
 /**
- * _dep_scan_table() - Scan a dependency table and mark for scaling
+ * _dep_resolve() - Resolve a dependency table entry into a request
  * @dev:	device requesting the dependency scan (req_dev)
  * @dep_info:	dependency information (contains the table)
  * @main_volt:	voltage dependency to search for
+ * @act:	filled with the request to place on the dependent domain
  *
  * This runs down the table provided to find the match for main_volt
- * provided and sets up a scale request for the dependent domain
- * for the dependent OPP.
+ * provided and works out the dependent domain, device and OPP which
+ * have to be requested for it.
  *
  * Returns 0 if all went well.
  */
-static int _dep_scan_table(struct device *dev,
-		struct omap_vdd_dep_info *dep_info, unsigned long main_volt)
+static int _dep_resolve(struct device *dev,
+		struct omap_vdd_dep_info *dep_info, unsigned long main_volt,
+		struct omap_dvfs_dep_action *act)
 {
 	struct omap_vdd_dep_volt *dep_table = dep_info->dep_table;
 	struct device *target_dev;
 	struct omap_vdd_dvfs_info *tdvfs_info;
 	struct opp *opp;
-	int i, ret;
+	int i;
 	unsigned long dep_volt = 0, new_dep_volt, new_freq = 0;
 
 	if (!dep_table) {
@@ -572,34 +673,80 @@ static int _dep_scan_table(struct device *dev,
 		return -ENODATA;
 	}
 
+	act->dvfs_info = tdvfs_info;
+	act->tdev = list_first_entry(&tdvfs_info->dev_list,
+				     struct omap_vdd_dev_list, node);
+	act->freq = new_freq;
+	act->volt = new_dep_volt;
+
+	return 0;
+}
+
+/**
+ * _dep_apply() - Place a resolved request on a dependent domain
+ * @dev:	device requesting the dependency scan (req_dev)
+ * @act:	request returned by _dep_resolve()
+ *
+ * Returns 0 if all went well.
+ */
+static int _dep_apply(struct device *dev, struct omap_dvfs_dep_action *act)
+{
+	struct device *target_dev = act->tdev->dev;
+	int ret;
+
 	/* TODO: In case of _add_vdd_user() failure
-	 * _dep_scan_table() will end up with previous voltage request,
+	 * _dep_apply() will end up with previous voltage request,
 	 * but without a frequency request.
 	 * System should be left in previous state in case of failure.
 	 * Same issue is present in omap_device_scale() function.
 	 */
-	ret = _add_freq_request(tdvfs_info, dev, target_dev, new_freq);
+	ret = __add_freq_request(act->dvfs_info, act->tdev, dev, act->freq);
 	if (ret) {
 		dev_err(target_dev, "%s: freqadd(%s) failed %d"
-				"[f=%ld, v=%ld(%ld)]\n",
-				__func__, dev_name(dev), ret, new_freq,
-				new_dep_volt, dep_volt);
+				"[f=%ld, v=%ld]\n",
+				__func__, dev_name(dev), ret, act->freq,
+				act->volt);
 		return ret;
 	}
 
-	ret = _add_vdd_user(tdvfs_info, dev, new_dep_volt);
+	ret = _add_vdd_user(act->dvfs_info, dev, act->volt);
 	if (ret) {
 		dev_err(target_dev, "%s: vddadd(%s) failed %d"
-				"[f=%ld, v=%ld(%ld)]\n",
-				__func__, dev_name(dev), ret, new_freq,
-				new_dep_volt, dep_volt);
-		_remove_freq_request(tdvfs_info, dev, target_dev);
+				"[f=%ld, v=%ld]\n",
+				__func__, dev_name(dev), ret, act->freq,
+				act->volt);
+		_remove_freq_request(act->dvfs_info, dev, target_dev);
 		return ret;
 	}
 
 	return ret;
 }
 
+/**
+ * _dep_scan_table() - Scan a dependency table and mark for scaling
+ * @dev:	device requesting the dependency scan (req_dev)
+ * @dep_info:	dependency information (contains the table)
+ * @main_volt:	voltage dependency to search for
+ *
+ * This runs down the table provided to find the match for main_volt
+ * provided and sets up a scale request for the dependent domain
+ * for the dependent OPP.
+ *
+ * Returns 0 if all went well.
+ */
+static int _dep_scan_table(struct device *dev,
+		struct omap_vdd_dep_info *dep_info, unsigned long main_volt)
+{
+	struct omap_dvfs_dep_action act;
+	int ret;
+
+	ret = _dep_resolve(dev, dep_info, main_volt, &act);
+	if (ret)
+		return ret;
+
+	return _dep_apply(dev, &act);
+}
+
 /**
  * _dep_scan_domains() - Scan dependency domains for a device
  * @dev:	device requesting the scan
@@ -635,6 +782,119 @@ static int _dep_scan_domains(struct device *dev,
 	return ret;
 }
 
+/**
+ * _dep_map_compile() - Resolve all dependencies of a vdd OPP
+ * @dev:	device requesting the scan
+ * @vdd:	vdd_info corresponding to the device
+ * @map:	dependency map entry to fill
+ *
+ * If any dependency cannot be resolved the entry is marked invalid and
+ * the caller falls back to _dep_scan_domains(), which reports the error
+ * on every scale as before.
+ */
+static void _dep_map_compile(struct device *dev, struct omap_vdd_info *vdd,
+		struct omap_dvfs_dep_map *map)
+{
+	struct omap_vdd_dep_info *dep_info = vdd->dep_vdd_info;
+	struct omap_dvfs_dep_action *actions;
+	int nr = 0, i;
+
+	map->nr_actions = DVFS_DEP_MAP_INVALID;
+
+	while (dep_info && dep_info[nr].nr_dep_entries)
+		nr++;
+	if (!nr) {
+		map->nr_actions = 0;
+		return;
+	}
+
+	actions = kcalloc(nr, sizeof(*actions), GFP_KERNEL);
+	if (!actions)
+		return;
+
+	for (i = 0; i < nr; i++) {
+		if (_dep_resolve(dev, &dep_info[i], map->main_volt,
+				 &actions[i])) {
+			kfree(actions);
+			return;
+		}
+	}
+
+	map->actions = actions;
+	map->nr_actions = nr;
+}
+
+/**
+ * _dep_map_lookup() - Find the dependency map entry for a vdd OPP
+ * @dev:	device requesting the scan
+ * @dvfs_info:	dvfs_info of the vdd being scaled
+ * @main_volt:	voltage the vdd is requested at
+ *
+ * Returns NULL if there is no usable entry for @main_volt, in which case
+ * the dependency tables have to be scanned.
+ */
+static struct omap_dvfs_dep_map *_dep_map_lookup(struct device *dev,
+		struct omap_vdd_dvfs_info *dvfs_info, unsigned long main_volt)
+{
+	struct omap_vdd_info *vdd = dvfs_info->voltdm->vdd;
+	struct omap_dvfs_dep_map *map;
+	int i;
+
+	if (!dvfs_info->dep_map) {
+		struct omap_volt_data *volt_data = vdd->volt_data;
+		int nr = 0;
+
+		while (volt_data && volt_data[nr].volt_nominal)
+			nr++;
+		if (!nr)
+			return NULL;
+
+		map = kcalloc(nr, sizeof(*map), GFP_KERNEL);
+		if (!map)
+			return NULL;
+
+		for (i = 0; i < nr; i++) {
+			map[i].main_volt = volt_data[i].volt_nominal;
+			map[i].nr_actions = DVFS_DEP_MAP_UNCOMPILED;
+		}
+		dvfs_info->dep_map = map;
+		dvfs_info->nr_dep_map = nr;
+	}
+
+	for (i = 0; i < dvfs_info->nr_dep_map; i++) {
+		map = &dvfs_info->dep_map[i];
+		if (map->main_volt != main_volt)
+			continue;
+
+		if (map->nr_actions == DVFS_DEP_MAP_UNCOMPILED)
+			_dep_map_compile(dev, vdd, map);
+
+		return (map->nr_actions >= 0) ? map : NULL;
+	}
+
+	return NULL;
+}
+
+/**
+ * _dep_map_apply() - Place all precomputed dependency requests
+ * @dev:	device requesting the scan
+ * @map:	dependency map entry returned by _dep_map_lookup()
+ *
+ * Returns 0 if all went well.
+ */
+static int _dep_map_apply(struct device *dev, struct omap_dvfs_dep_map *map)
+{
+	int i, ret = 0, r;
+
+	for (i = 0; i < map->nr_actions; i++) {
+		r = _dep_apply(dev, &map->actions[i]);
+		/* Store last failed value */
+		ret = (r) ? r : ret;
+	}
+
+	return ret;
+}
+
 /**
  * _dep_scale_domains() - Cause a scale of all dependent domains
  * @req_dev:	device requesting the scale
@@ -949,6 +1209,7 @@ int omap_device_scale(struct device *req_dev, struct device *target_dev,
 	struct opp *opp;
 	unsigned long volt, freq = rate;
 	struct omap_vdd_dvfs_info *tdvfs_info;
+	struct omap_dvfs_dep_map *dep_map;
 	struct platform_device *pdev;
 	struct omap_device *od;
 	struct device *dev;
@@ -1023,7 +1284,12 @@ int omap_device_scale(struct device *req_dev, struct device *target_dev,
 	}
 
 	/* Check for any dep domains and add the user request */
-	ret = _dep_scan_domains(target_dev, tdvfs_info->voltdm->vdd, volt);
+	dep_map = _dep_map_lookup(target_dev, tdvfs_info, volt);
+	if (dep_map)
+		ret = _dep_map_apply(target_dev, dep_map);
+	else
+		ret = _dep_scan_domains(target_dev, tdvfs_info->voltdm->vdd,
+					volt);
 	if (ret) {
 		dev_err(target_dev,
 			"%s: Error in scan domains for vdd_%s\n",
@@ -1206,6 +1472,33 @@ static int dvfs_dump_vdd(struct seq_file *sf, void *unused)
 		dep_info++;
 	}
 
+	if (!anyreq)
+		seq_printf(sf, "   `- none\n");
+	else
+		seq_printf(sf, "   X  X\n");
+
+	seq_printf(sf, "`- dependency map\n   |\n");
+	anyreq = 0;
+	for (k = 0; k < dvfs_info->nr_dep_map; k++) {
+		struct omap_dvfs_dep_map *map = &dvfs_info->dep_map[k];
+		int a;
+
+		if (map->nr_actions == DVFS_DEP_MAP_UNCOMPILED)
+			continue;
+
+		seq_printf(sf, "   |-%ld%s\n", map->main_volt,
+			   map->nr_actions < 0 ? ": invalid" : "");
+		for (a = 0; a < map->nr_actions; a++) {
+			struct omap_dvfs_dep_action *act = &map->actions[a];
+
+			seq_printf(sf, "   |  |- vdd_%s %s: %ld Hz, %ld\n",
+				   act->dvfs_info->voltdm->name,
+				   dev_name(act->tdev->dev),
+				   act->freq, act->volt);
+		}
+		anyreq = 1;
+	}
+
 	if (!anyreq)
 		seq_printf(sf, "   `- none\n");
 	else
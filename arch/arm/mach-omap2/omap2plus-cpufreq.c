@@ -30,6 +30,9 @@
 #include <linux/io.h>
 #include <linux/opp.h>
 #include <linux/cpu.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/moduleparam.h>
 #include <linux/thermal_framework.h>
 #include <linux/platform_device.h>
 #include <linux/omap4_duty_cycle.h>
@@ -48,6 +51,8 @@
 #include <mach/omap4-common.h>
 #endif
 
+#include <trace/events/power.h>
+
 #include "dvfs.h"
 
 #ifdef CONFIG_SMP
@@ -68,12 +73,36 @@ static struct device *mpu_dev;
 static DEFINE_MUTEX(omap_cpufreq_lock);
 
 static unsigned int max_thermal;
+static unsigned int max_skin = UINT_MAX;
 static unsigned int max_freq;
+static unsigned int policy_max_freq = UINT_MAX;
 static unsigned int current_target_freq;
 static unsigned int current_cooling_level;
 static bool omap_cpufreq_ready;
 static bool omap_cpufreq_suspended;
 
+/*
+ * Governor requests are handed to omap_cpufreq_task and applied
+ * asynchronously, so a boost from the governor never waits for the
+ * voltage ramp, SmartReflex and DPLL relock in omap_device_scale().
+ * Only the latest request is kept; requests arriving while a transition
+ * is in flight are coalesced into the next one.  Completion is signalled
+ * through the regular CPUFREQ_POSTCHANGE notification, which is also what
+ * updates policy->cur.
+ */
+static bool omap_cpufreq_async = true;
+module_param_named(async, omap_cpufreq_async, bool, 0644);
+
+static struct task_struct *omap_cpufreq_task;
+static DEFINE_SPINLOCK(omap_cpufreq_req_lock);
+static struct {
+	bool pending;
+	bool cascade_hold;
+	unsigned int freq;
+	unsigned int coalesced;
+	ktime_t stamp;
+} omap_cpufreq_req;
+
 static unsigned int omap_getspeed(unsigned int cpu)
 {
 	unsigned long rate;
@@ -117,6 +146,29 @@ static void omap_cpufreq_lpj_recalculate(unsigned int target_freq,
 #endif
 }
 
+/*
+ * Publish the capacity of the OPP actually running, and of the highest OPP
+ * the policy and the thermal caps let us reach, for frequency invariant
+ * load tracking.  Both CPUs share the MPU clock.
+ */
+static void omap_cpufreq_publish_capacity(void)
+{
+	unsigned int cur, max;
+	int cpu;
+
+	if (!max_freq)
+		return;
+
+	cur = omap_getspeed(0);
+	max = min3(policy_max_freq, max_thermal ? : max_freq, max_skin);
+	max = min(max, max_freq);
+
+	for_each_possible_cpu(cpu)
+		cpufreq_set_capacity(cpu,
+			((unsigned long)cur << CPUFREQ_CAPACITY_SHIFT) / max_freq,
+			((unsigned long)max << CPUFREQ_CAPACITY_SHIFT) / max_freq);
+}
+
 static int omap_cpufreq_scale(unsigned int target_freq, unsigned int cur_freq)
 {
 	int ret;
@@ -131,9 +183,13 @@ static int omap_cpufreq_scale(unsigned int target_freq, unsigned int cur_freq)
 	 */
 	if (freqs.new > max_thermal)
 		freqs.new = max_thermal;
+	if (freqs.new > max_skin)
+		freqs.new = max_skin;
 
-	if ((freqs.old == freqs.new) && (cur_freq = freqs.new))
+	if ((freqs.old == freqs.new) && (cur_freq = freqs.new)) {
+		omap_cpufreq_publish_capacity();
 		return 0;
+	}
 
 	get_online_cpus();
 
@@ -161,6 +217,8 @@ static int omap_cpufreq_scale(unsigned int target_freq, unsigned int cur_freq)
 
 	put_online_cpus();
 
+	omap_cpufreq_publish_capacity();
+
 	return ret;
 }
 
@@ -243,6 +301,96 @@ static int omap_verify_speed(struct cpufreq_policy *policy)
 	return cpufreq_frequency_table_verify(policy, freq_table);
 }
 
+/*
+ * Scale to a governor request.  @cascade_hold is set for targets above the
+ * policy minimum, which must keep DPLL cascading out of the way.
+ * Caller must hold omap_cpufreq_lock.
+ */
+static int omap_cpufreq_apply(unsigned int target_freq, bool cascade_hold,
+			      ktime_t stamp, unsigned int coalesced)
+{
+	unsigned int old;
+	ktime_t start;
+	int ret;
+
+	current_target_freq = target_freq;
+
+	if (omap_cpufreq_suspended)
+		return 0;
+
+	start = ktime_get();
+	old = omap_getspeed(0);
+
+#ifdef CONFIG_OMAP4_DPLL_CASCADING
+	if (cpu_is_omap44xx() && cascade_hold)
+		omap4_dpll_cascading_blocker_hold(mpu_dev);
+#endif
+	ret = omap_cpufreq_scale(target_freq, old);
+#ifdef CONFIG_OMAP4_DPLL_CASCADING
+	if (cpu_is_omap44xx() && !cascade_hold)
+		omap4_dpll_cascading_blocker_release(mpu_dev);
+#endif
+
+	trace_cpu_frequency_transition(old, omap_getspeed(0),
+			ktime_to_us(ktime_sub(start, stamp)),
+			ktime_to_us(ktime_sub(ktime_get(), start)), coalesced);
+
+	return ret;
+}
+
+static int omap_cpufreq_dvfs_task(void *data)
+{
+	unsigned int freq, coalesced;
+	bool cascade_hold;
+	ktime_t stamp;
+
+	while (1) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (kthread_should_stop())
+			break;
+
+		spin_lock_irq(&omap_cpufreq_req_lock);
+		if (!omap_cpufreq_req.pending) {
+			spin_unlock_irq(&omap_cpufreq_req_lock);
+			schedule();
+			continue;
+		}
+
+		__set_current_state(TASK_RUNNING);
+		freq = omap_cpufreq_req.freq;
+		cascade_hold = omap_cpufreq_req.cascade_hold;
+		coalesced = omap_cpufreq_req.coalesced;
+		stamp = omap_cpufreq_req.stamp;
+		omap_cpufreq_req.pending = false;
+		omap_cpufreq_req.coalesced = 0;
+		spin_unlock_irq(&omap_cpufreq_req_lock);
+
+		mutex_lock(&omap_cpufreq_lock);
+		omap_cpufreq_apply(freq, cascade_hold, stamp, coalesced);
+		mutex_unlock(&omap_cpufreq_lock);
+	}
+
+	__set_current_state(TASK_RUNNING);
+	return 0;
+}
+
+static void omap_cpufreq_queue(unsigned int freq, bool cascade_hold)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&omap_cpufreq_req_lock, flags);
+	if (omap_cpufreq_req.pending)
+		omap_cpufreq_req.coalesced++;
+	else
+		omap_cpufreq_req.stamp = ktime_get();
+	omap_cpufreq_req.pending = true;
+	omap_cpufreq_req.freq = freq;
+	omap_cpufreq_req.cascade_hold = cascade_hold;
+	spin_unlock_irqrestore(&omap_cpufreq_req_lock, flags);
+
+	wake_up_process(omap_cpufreq_task);
+}
+
 static int omap_target(struct cpufreq_policy *policy,
 		       unsigned int target_freq,
 		       unsigned int relation)
@@ -264,22 +412,17 @@ static int omap_target(struct cpufreq_policy *policy,
 		return ret;
 	}
 
-	mutex_lock(&omap_cpufreq_lock);
-
-	current_target_freq = freq_table[i].frequency;
+	policy_max_freq = policy->max;
 
-	if (!omap_cpufreq_suspended) {
-#ifdef CONFIG_OMAP4_DPLL_CASCADING
-		if (cpu_is_omap44xx() && target_freq > policy->min)
-			omap4_dpll_cascading_blocker_hold(mpu_dev);
-#endif
-		ret = omap_cpufreq_scale(current_target_freq, policy->cur);
-#ifdef CONFIG_OMAP4_DPLL_CASCADING
-		if (cpu_is_omap44xx() && target_freq == policy->min)
-			omap4_dpll_cascading_blocker_release(mpu_dev);
-#endif
+	if (omap_cpufreq_async && omap_cpufreq_task) {
+		omap_cpufreq_queue(freq_table[i].frequency,
+				   target_freq > policy->min);
+		return 0;
 	}
 
+	mutex_lock(&omap_cpufreq_lock);
+	ret = omap_cpufreq_apply(freq_table[i].frequency,
+				 target_freq > policy->min, ktime_get(), 0);
 	mutex_unlock(&omap_cpufreq_lock);
 
 	return ret;
@@ -469,13 +612,78 @@ static struct thermal_dev thermal_dev = {
 	.dev_ops	= &cpufreq_cooling_ops,
 };
 
+/*
+ * cpufreq_apply_skin_cooling: cap the cpu for the skin temperature governor
+ * @param throttle: share of the frequency range to shed, 0..1000
+ *
+ * The skin cap is kept apart from max_thermal, which belongs to the die
+ * and duty cycle policies, and the lower of the two wins.
+ */
+static int cpufreq_apply_skin_cooling(struct thermal_dev *dev, int throttle)
+{
+	unsigned int min_freq = UINT_MAX, limit, cap = 0, cur;
+	int i;
+
+	if (!omap_cpufreq_ready)
+		return 0;
+
+	throttle = clamp(throttle, 0, 1000);
+
+	mutex_lock(&omap_cpufreq_lock);
+
+	for (i = 0; freq_table[i].frequency != CPUFREQ_TABLE_END; i++)
+		if (freq_table[i].frequency != CPUFREQ_ENTRY_INVALID)
+			min_freq = min(freq_table[i].frequency, min_freq);
+
+	limit = max_freq - (max_freq - min_freq) * throttle / 1000;
+	for (i = 0; freq_table[i].frequency != CPUFREQ_TABLE_END; i++)
+		if (freq_table[i].frequency != CPUFREQ_ENTRY_INVALID &&
+		    freq_table[i].frequency <= limit)
+			cap = max(freq_table[i].frequency, cap);
+	if (!cap)
+		cap = min_freq;
+	if (!throttle)
+		cap = UINT_MAX;
+
+	if (cap != max_skin) {
+		pr_debug("%s: skin throttle %d, cap %u\n", __func__,
+			 throttle, cap);
+		max_skin = cap;
+		if (!omap_cpufreq_suspended) {
+			cur = omap_getspeed(0);
+			omap_cpufreq_scale(current_target_freq ? : cur, cur);
+		}
+	}
+
+	mutex_unlock(&omap_cpufreq_lock);
+
+	return 0;
+}
+
+static struct thermal_dev_ops cpufreq_skin_cooling_ops = {
+	.cool_device = cpufreq_apply_skin_cooling,
+};
+
+static struct thermal_dev skin_thermal_dev = {
+	.name		= "cpufreq_skin_cooling",
+	.domain_name	= "skin",
+	.dev_ops	= &cpufreq_skin_cooling_ops,
+};
+
 static int __init omap_cpufreq_cooling_init(void)
 {
-	return thermal_cooling_dev_register(&thermal_dev);
+	int ret;
+
+	ret = thermal_cooling_dev_register(&thermal_dev);
+	if (ret)
+		return ret;
+
+	return thermal_cooling_dev_register(&skin_thermal_dev);
 }
 
 static void __exit omap_cpufreq_cooling_exit(void)
 {
+	thermal_cooling_dev_unregister(&skin_thermal_dev);
 	thermal_governor_dev_unregister(&thermal_dev);
 }
 #else
@@ -627,8 +835,28 @@ static int __init omap_cpufreq_init(void)
 		return -EINVAL;
 	}
 
+	omap_cpufreq_task = kthread_create(omap_cpufreq_dvfs_task, NULL,
+					   "omap_cpufreq");
+	if (IS_ERR(omap_cpufreq_task)) {
+		pr_warn("%s: no dvfs task, scaling synchronously\n", __func__);
+		omap_cpufreq_task = NULL;
+	} else {
+		struct sched_param param = { .sched_priority = MAX_RT_PRIO-1 };
+
+		sched_setscheduler_nocheck(omap_cpufreq_task, SCHED_FIFO,
+					   &param);
+		get_task_struct(omap_cpufreq_task);
+		wake_up_process(omap_cpufreq_task);
+	}
+
+	/* the task must be running before the first policy is set up */
 	ret = cpufreq_register_driver(&omap_driver);
 	omap_cpufreq_ready = !ret;
+	if (ret && omap_cpufreq_task) {
+		kthread_stop(omap_cpufreq_task);
+		put_task_struct(omap_cpufreq_task);
+		omap_cpufreq_task = NULL;
+	}
 
 	max_thermal = max_freq;
 	current_cooling_level = 0;
@@ -665,6 +893,11 @@ static void __exit omap_cpufreq_exit(void)
 	cpufreq_unregister_driver(&omap_driver);
 	platform_driver_unregister(&omap_cpufreq_platform_driver);
 	platform_device_unregister(&omap_cpufreq_device);
+
+	if (omap_cpufreq_task) {
+		kthread_stop(omap_cpufreq_task);
+		put_task_struct(omap_cpufreq_task);
+	}
 }
 
 MODULE_DESCRIPTION("cpufreq driver for OMAP2PLUS SOCs");
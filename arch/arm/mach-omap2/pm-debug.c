@@ -212,8 +212,16 @@ enum {
 	DEBUG_FILE_TIMERS,
 	DEBUG_FILE_LAST_COUNTERS,
 	DEBUG_FILE_LAST_TIMERS,
+	DEBUG_FILE_CLKDM_TIMERS,
+	DEBUG_FILE_BLOCKERS,
+	DEBUG_FILE_DPLLS,
 };
 
+/* Sample clockdomain usecounts on idle entry to blame missed targets */
+static u32 pm_dbg_idle_blockers;
+/* Walk the clock list to blame individual clocks for missed targets */
+static u32 pm_dbg_blocker_clocks;
+
 struct pm_module_def {
 	char name[8]; /* Name of the module */
 	short type; /* CM or PRM */
@@ -390,6 +398,76 @@ void pm_dbg_update_time(struct powerdomain *pwrdm, int prev)
 	pwrdm->timer = t;
 }
 
+/* Called from pwrdm_pre_transition() with interrupts disabled */
+void pm_dbg_pre_transition(struct powerdomain *pwrdm)
+{
+	struct clockdomain *clkdm;
+	int i;
+
+	if (!pm_dbg_init_done)
+		return;
+
+	if (!pm_dbg_idle_blockers) {
+		pwrdm->idle_target = -1;
+		return;
+	}
+
+	pwrdm->idle_target = pwrdm_read_next_pwrst(pwrdm);
+	pwrdm->idle_blockers = 0;
+
+	for (i = 0; i < PWRDM_MAX_CLKDMS; i++) {
+		clkdm = pwrdm->pwrdm_clkdms[i];
+		if (clkdm && atomic_read(&clkdm->usecount) > 0)
+			pwrdm->idle_blockers |= 1 << i;
+	}
+}
+
+static int pm_dbg_blame_clk(struct clk *clk, void *user)
+{
+	struct powerdomain *pwrdm = user;
+	int i;
+
+	if (clk->usecount <= 0 || !clk->clkdm)
+		return 0;
+
+	for (i = 0; i < PWRDM_MAX_CLKDMS; i++)
+		if ((pwrdm->idle_blockers & (1 << i)) &&
+		    pwrdm->pwrdm_clkdms[i] == clk->clkdm)
+			clk->block_count++;
+
+	return 0;
+}
+
+/*
+ * Called from pwrdm_post_transition().  If @pwrdm did not reach the
+ * state it was programmed for, blame the clockdomains that still had
+ * enabled clocks when idle was entered.
+ */
+void pm_dbg_check_target(struct powerdomain *pwrdm, int prev)
+{
+	int i;
+
+	if (!pm_dbg_init_done)
+		return;
+
+	if (prev < 0 || pwrdm->idle_target < 0 || prev <= pwrdm->idle_target)
+		return;
+
+	pwrdm->miss_count++;
+
+	if (!pwrdm->idle_blockers) {
+		pwrdm->miss_unknown++;
+		return;
+	}
+
+	for (i = 0; i < PWRDM_MAX_CLKDMS; i++)
+		if (pwrdm->idle_blockers & (1 << i))
+			pwrdm->pwrdm_clkdms[i]->block_count++;
+
+	if (pm_dbg_blocker_clocks)
+		omap_clk_for_each(pm_dbg_blame_clk, pwrdm);
+}
+
 static int clkdm_dbg_show_counter(struct clockdomain *clkdm, void *user)
 {
 	struct seq_file *s = (struct seq_file *)user;
@@ -527,6 +605,89 @@ static int pwrdm_dbg_show_last_timer(struct powerdomain *pwrdm, void *user)
 	return 0;
 }
 
+static int clkdm_dbg_show_timer(struct clockdomain *clkdm, void *user)
+{
+	struct seq_file *s = (struct seq_file *)user;
+	s64 active = clkdm->active_time;
+
+	if (clkdm->active_stamp)
+		active += sched_clock() - clkdm->active_stamp;
+
+	seq_printf(s, "%s->%s (%d),ACTIVE:%lld,COUNT:%u,BLOCKED:%u\n",
+		   clkdm->name, clkdm->pwrdm.ptr ? clkdm->pwrdm.ptr->name : "",
+		   atomic_read(&clkdm->usecount), active,
+		   clkdm->active_count, clkdm->block_count);
+
+	return 0;
+}
+
+struct pm_dbg_blocker_walk {
+	struct seq_file *s;
+	struct clockdomain *clkdm;
+};
+
+static int pm_dbg_show_blocker_clk(struct clk *clk, void *user)
+{
+	struct pm_dbg_blocker_walk *walk = user;
+
+	if (clk->clkdm != walk->clkdm)
+		return 0;
+
+	if (clk->usecount > 0 || clk->block_count)
+		seq_printf(walk->s, "    %s (%d),BLOCKED:%u\n", clk->name,
+			   clk->usecount, clk->block_count);
+
+	return 0;
+}
+
+static int pwrdm_dbg_show_blockers(struct powerdomain *pwrdm, void *user)
+{
+	struct pm_dbg_blocker_walk walk = { .s = user };
+	struct clockdomain *clkdm;
+	int i;
+
+	if (!pwrdm->miss_count)
+		return 0;
+
+	seq_printf(walk.s, "%s (%s),MISSED:%u,UNKNOWN:%u\n", pwrdm->name,
+		   pwrdm_state_names[pwrdm->state], pwrdm->miss_count,
+		   pwrdm->miss_unknown);
+
+	for (i = 0; i < PWRDM_MAX_CLKDMS; i++) {
+		clkdm = pwrdm->pwrdm_clkdms[i];
+		if (!clkdm || !clkdm->block_count)
+			continue;
+
+		seq_printf(walk.s, "  %s (%d),BLOCKED:%u\n", clkdm->name,
+			   atomic_read(&clkdm->usecount), clkdm->block_count);
+
+		walk.clkdm = clkdm;
+		omap_clk_for_each(pm_dbg_show_blocker_clk, &walk);
+	}
+
+	return 0;
+}
+
+static int pm_dbg_show_dpll(struct clk *clk, void *user)
+{
+	struct seq_file *s = (struct seq_file *)user;
+	struct dpll_data *dd = clk->dpll_data;
+	s64 locked;
+
+	if (!dd || !dd->lock_count)
+		return 0;
+
+	locked = dd->locked_time;
+	if (dd->lock_stamp)
+		locked += sched_clock() - dd->lock_stamp;
+
+	seq_printf(s, "%s (%s),LOCKED:%lld,COUNT:%u,LOCK_US:%u,MAX_US:%u\n",
+		   clk->name, dd->lock_stamp ? "LOCK" : "BYP", locked,
+		   dd->lock_count, dd->lock_us_last, dd->lock_us_max);
+
+	return 0;
+}
+
 static int pm_dbg_show_counters(struct seq_file *s, void *unused)
 {
 	pwrdm_for_each(pwrdm_dbg_show_counter, s);
@@ -555,6 +716,24 @@ static int pm_dbg_show_last_timers(struct seq_file *s, void *unused)
 	return 0;
 }
 
+static int pm_dbg_show_clkdm_timers(struct seq_file *s, void *unused)
+{
+	clkdm_for_each(clkdm_dbg_show_timer, s);
+	return 0;
+}
+
+static int pm_dbg_show_blockers(struct seq_file *s, void *unused)
+{
+	pwrdm_for_each(pwrdm_dbg_show_blockers, s);
+	return 0;
+}
+
+static int pm_dbg_show_dplls(struct seq_file *s, void *unused)
+{
+	omap_clk_for_each(pm_dbg_show_dpll, s);
+	return 0;
+}
+
 static int pm_dbg_open(struct inode *inode, struct file *file)
 {
 	switch ((int)inode->i_private) {
@@ -567,6 +746,15 @@ static int pm_dbg_open(struct inode *inode, struct file *file)
 	case DEBUG_FILE_LAST_COUNTERS:
 		return single_open(file, pm_dbg_show_last_counters,
 			&inode->i_private);
+	case DEBUG_FILE_CLKDM_TIMERS:
+		return single_open(file, pm_dbg_show_clkdm_timers,
+			&inode->i_private);
+	case DEBUG_FILE_BLOCKERS:
+		return single_open(file, pm_dbg_show_blockers,
+			&inode->i_private);
+	case DEBUG_FILE_DPLLS:
+		return single_open(file, pm_dbg_show_dplls,
+			&inode->i_private);
 	case DEBUG_FILE_LAST_TIMERS:
 	default:
 		return single_open(file, pm_dbg_show_last_timers,
@@ -697,6 +885,7 @@ static int __init pwrdms_setup(struct powerdomain *pwrdm, void *dir)
 		pwrdm->time.state[i] = 0;
 
 	pwrdm->timer = t;
+	pwrdm->idle_target = -1;
 
 	if (strncmp(pwrdm->name, "dpll", 4) == 0)
 		return 0;
@@ -786,6 +975,16 @@ static int __init pm_dbg_init(void)
 		d, (void *)DEBUG_FILE_LAST_COUNTERS, &debug_fops);
 	(void) debugfs_create_file("last_time", S_IRUGO,
 		d, (void *)DEBUG_FILE_LAST_TIMERS, &debug_fops);
+	(void) debugfs_create_file("clkdm_time", S_IRUGO,
+		d, (void *)DEBUG_FILE_CLKDM_TIMERS, &debug_fops);
+	(void) debugfs_create_file("blockers", S_IRUGO,
+		d, (void *)DEBUG_FILE_BLOCKERS, &debug_fops);
+	(void) debugfs_create_file("dpll", S_IRUGO,
+		d, (void *)DEBUG_FILE_DPLLS, &debug_fops);
+	debugfs_create_u32("idle_blockers", S_IRUGO | S_IWUSR, d,
+			   &pm_dbg_idle_blockers);
+	debugfs_create_u32("blocker_clocks", S_IRUGO | S_IWUSR, d,
+			   &pm_dbg_blocker_clocks);
 
 	pwrdm_for_each(pwrdms_setup, (void *)d);
 
@@ -116,10 +116,14 @@ static inline void omap4_pm_suspend_save_regs(void) { }
 
 #if defined(CONFIG_PM_DEBUG) && defined(CONFIG_DEBUG_FS)
 extern void pm_dbg_update_time(struct powerdomain *pwrdm, int prev);
+extern void pm_dbg_pre_transition(struct powerdomain *pwrdm);
+extern void pm_dbg_check_target(struct powerdomain *pwrdm, int prev);
 extern int pm_dbg_regset_save(int reg_set);
 extern int pm_dbg_regset_init(int reg_set);
 #else
 #define pm_dbg_update_time(pwrdm, prev) do {} while (0);
+#define pm_dbg_pre_transition(pwrdm) do {} while (0);
+#define pm_dbg_check_target(pwrdm, prev) do {} while (0);
 #define pm_dbg_regset_save(reg_set) do {} while (0);
 #define pm_dbg_regset_init(reg_set) do {} while (0);
 #endif /* CONFIG_PM_DEBUG */
@@ -132,6 +132,10 @@ struct powerdomain_time_stats {
  * @state_counter:
  * @timer:
  * @state_timer:
+ * @idle_target: next power state sampled before the last idle transition
+ * @idle_blockers: bitmask of @pwrdm_clkdms that were active at that time
+ * @miss_count: number of idle transitions that did not reach @idle_target
+ * @miss_unknown: misses with no active clockdomain to blame
  * @wakeup_lat: Wakeup latencies for possible powerdomain power states
  * @wakeuplat_lock: spinlock for plist
  * @wakeuplat_dev_list: plist_head linking all devices placing constraint
@@ -164,6 +168,10 @@ struct powerdomain {
 	s64 timer;
 	struct powerdomain_time_stats time;
 	struct powerdomain_time_stats last_time;
+	int idle_target;
+	u32 idle_blockers;
+	u32 miss_count;
+	u32 miss_unknown;
 #endif
 	const u32 wakeup_lat[PWRDM_MAX_FUNC_PWRSTS];
 	spinlock_t wakeuplat_lock;
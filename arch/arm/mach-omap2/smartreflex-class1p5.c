@@ -27,6 +27,7 @@
 #include <linux/slab.h>
 #include <linux/opp.h>
 #include <linux/pm_qos_params.h>
+#include <linux/thermal_framework.h>
 
 #include "smartreflex.h"
 #include "voltage.h"
@@ -43,6 +44,17 @@
  */
 #define MAX_CHECK_VPTRANS_US	20
 
+/*
+ * Calibrated voltages depend on die temperature, so they are cached per
+ * temperature band and swapped in when the die moves to another band.
+ * Going back to a band we have already seen then costs no recalibration.
+ */
+#define SR1P5_TEMP_DOMAIN	"cpu"
+#define SR1P5_TEMP_BANDS	6
+#define SR1P5_TEMP_BAND_WIDTH	20000	/* milli-celsius */
+#define SR1P5_TEMP_HYSTERESIS	2000	/* milli-celsius */
+#define SR1P5_TEMP_POLL_MS	2000
+
 /**
  * struct sr_class1p5_work_data - data meant to be used by calibration work
  * @work:	calibration work
@@ -55,6 +67,11 @@
  *			consumed by the work item.
  * @work_active:	have we scheduled a work item?
  * @qos:		pm qos handle
+ * @calib_cache:	calibrated voltages saved per temperature band,
+ *			SR1P5_TEMP_BANDS rows of @num_vdata entries
+ * @num_vdata:		number of voltage entries of the domain
+ * @temp_band:		band the current volt_calibrated values belong to,
+ *			-1 until the first temperature reading
  */
 struct sr_class1p5_work_data {
 	struct delayed_work work;
@@ -65,8 +82,19 @@ struct sr_class1p5_work_data {
 	unsigned long u_volt_samples[SR1P5_STABLE_SAMPLES];
 	bool work_active;
 	struct pm_qos_request_list qos;
+	u32 *calib_cache;
+	int num_vdata;
+	int temp_band;
 };
 
+/* domains with a calibration cache, protected by omap_dvfs_lock */
+static struct sr_class1p5_work_data *sr1p5_domains[MAX_VDDS];
+
+#ifdef CONFIG_THERMAL_FRAMEWORK
+/* temp_work:	temperature band tracking work */
+static struct delayed_work temp_work;
+#endif
+
 #if CONFIG_OMAP_SR_CLASS1P5_RECALIBRATION_DELAY
 /* recal_work:	recalibration calibration work */
 static struct delayed_work recal_work;
@@ -333,8 +361,168 @@ done_calib:
 	mutex_unlock(&omap_dvfs_lock);
 }
 
+#ifdef CONFIG_THERMAL_FRAMEWORK
+/**
+ * sr_class1p5_temp_band() - temperature band for a die temperature
+ * @temp:	die temperature in milli-celsius
+ * @band:	band we are currently in, -1 if none yet
+ *
+ * We stay in @band until the temperature is more than the hysteresis
+ * outside of it, so that we do not toggle on a band boundary.
+ */
+static int sr_class1p5_temp_band(int temp, int band)
+{
+	if (band >= 0 &&
+	    temp >= band * SR1P5_TEMP_BAND_WIDTH - SR1P5_TEMP_HYSTERESIS &&
+	    temp < (band + 1) * SR1P5_TEMP_BAND_WIDTH + SR1P5_TEMP_HYSTERESIS)
+		return band;
+
+	return clamp(temp / SR1P5_TEMP_BAND_WIDTH, 0, SR1P5_TEMP_BANDS - 1);
+}
+
+/**
+ * sr_class1p5_switch_band() - swap in the calibration of another band
+ * @work_data:	domain to switch
+ * @band:	temperature band to switch to
+ *
+ * The calibrated voltages of the band we leave are saved and the ones
+ * of @band are restored. OPPs never calibrated in @band get calibrated
+ * on their next use, starting from their dynamic nominal voltage. If
+ * the voltage of the running OPP changed, the domain is moved to it
+ * right away (and calibrated if needed).
+ *
+ * NOTE: Appropriate locks must be held by calling path to ensure mutual
+ * exclusivity
+ */
+static void sr_class1p5_switch_band(struct sr_class1p5_work_data *work_data,
+				    int band)
+{
+	struct voltagedomain *voltdm = work_data->voltdm;
+	struct omap_volt_data *vdata = voltdm->vdd->volt_data;
+	struct omap_volt_data *curr_vdata;
+	u32 *old_row, *new_row;
+	unsigned long curr_volt;
+	int i;
+
+	/* calibrations done before the first reading belong to this band */
+	if (work_data->temp_band < 0) {
+		work_data->temp_band = band;
+		return;
+	}
+
+	old_row = work_data->calib_cache +
+			work_data->temp_band * work_data->num_vdata;
+	new_row = work_data->calib_cache + band * work_data->num_vdata;
+
+	curr_vdata = omap_voltage_get_curr_vdata(voltdm);
+	curr_volt = omap_get_operation_voltage(curr_vdata);
+
+	for (i = 0; i < work_data->num_vdata; i++) {
+		old_row[i] = vdata[i].volt_calibrated;
+		vdata[i].volt_calibrated = new_row[i];
+		if (new_row[i])
+			vdata[i].volt_dynamic_nominal =
+				omap_get_dyn_nominal(&vdata[i]);
+	}
+
+	pr_debug("%s: %s: temperature band %d -> %d\n", __func__,
+		 voltdm->name, work_data->temp_band, band);
+	work_data->temp_band = band;
+
+	if (!curr_vdata || omap_get_operation_voltage(curr_vdata) == curr_volt)
+		return;
+
+	omap_sr_disable(voltdm);
+	voltdm_reset(voltdm);
+	omap_sr_enable(voltdm, curr_vdata);
+}
+
+/**
+ * sr_class1p5_temp_work() - track the die temperature band
+ * @work: pointer to the work
+ *
+ * Domains in the middle of a calibration are left alone and switched on
+ * a later pass, so that a calibration is always stored in the band it
+ * was measured in.
+ */
+static void sr_class1p5_temp_work(struct work_struct *work)
+{
+	struct sr_class1p5_work_data *work_data;
+	int temp, band, i;
+
+	/*
+	 * class deinit runs with omap_dvfs_lock held and cancels us, so
+	 * never block on it; a missed poll is retried on the next one.
+	 */
+	temp = thermal_lookup_temp(SR1P5_TEMP_DOMAIN);
+	if (temp >= 0 && mutex_trylock(&omap_dvfs_lock)) {
+		for (i = 0; i < MAX_VDDS; i++) {
+			work_data = sr1p5_domains[i];
+			if (!work_data || work_data->work_active)
+				continue;
+			band = sr_class1p5_temp_band(temp,
+						     work_data->temp_band);
+			if (band != work_data->temp_band)
+				sr_class1p5_switch_band(work_data, band);
+		}
+		mutex_unlock(&omap_dvfs_lock);
+	}
+
+	schedule_delayed_work(&temp_work, msecs_to_jiffies(SR1P5_TEMP_POLL_MS));
+}
+
+/**
+ * sr_class1p5_temp_update() - start or stop temperature band tracking
+ *
+ * Band tracking runs while at least one domain has a calibration cache.
+ *
+ * NOTE: Appropriate locks must be held by calling path to ensure mutual
+ * exclusivity
+ */
+static void sr_class1p5_temp_update(void)
+{
+	int i;
+
+	for (i = 0; i < MAX_VDDS; i++) {
+		if (sr1p5_domains[i]) {
+			if (!delayed_work_pending(&temp_work))
+				schedule_delayed_work(&temp_work,
+					msecs_to_jiffies(SR1P5_TEMP_POLL_MS));
+			return;
+		}
+	}
+
+	cancel_delayed_work_sync(&temp_work);
+}
+#else
+static inline void sr_class1p5_temp_update(void)
+{
+}
+#endif			/* CONFIG_THERMAL_FRAMEWORK */
+
 #if CONFIG_OMAP_SR_CLASS1P5_RECALIBRATION_DELAY
 
+/**
+ * sr_class1p5_cache_reset() - forget the cached voltages of all bands
+ * @voltdm:	voltage domain to reset the cache for
+ *
+ * NOTE: Appropriate locks must be held by calling path to ensure mutual
+ * exclusivity
+ */
+static void sr_class1p5_cache_reset(struct voltagedomain *voltdm)
+{
+	struct sr_class1p5_work_data *work_data;
+	int i;
+
+	for (i = 0; i < MAX_VDDS; i++) {
+		work_data = sr1p5_domains[i];
+		if (!work_data || work_data->voltdm != voltdm)
+			continue;
+		memset(work_data->calib_cache, 0, SR1P5_TEMP_BANDS *
+		       work_data->num_vdata * sizeof(u32));
+	}
+}
+
 /**
  * sr_class1p5_voltdm_recal() - Helper routine to reset calibration.
  * @voltdm:	Voltage domain to reset calibration for
@@ -366,6 +554,7 @@ static int sr_class1p5_voltdm_recal(struct voltagedomain *voltdm,
 
 	omap_sr_disable(voltdm);
 	omap_voltage_calib_reset(voltdm);
+	sr_class1p5_cache_reset(voltdm);
 	voltdm_reset(voltdm);
 	omap_sr_enable(voltdm, vdata);
 	pr_info("%s: %s: calibration reset\n", __func__, voltdm->name);
@@ -561,6 +750,8 @@ static int sr_class1p5_init(struct voltagedomain *voltdm,
 			    void **voltdm_cdata, void *class_priv_data)
 {
 	struct sr_class1p5_work_data *work_data;
+	struct omap_volt_data *vdata;
+	int i;
 
 	if (IS_ERR_OR_NULL(voltdm) || IS_ERR_OR_NULL(voltdm_cdata)) {
 		pr_err("%s: bad parameters!\n", __func__);
@@ -581,8 +772,29 @@ static int sr_class1p5_init(struct voltagedomain *voltdm,
 	}
 
 	work_data->voltdm = voltdm;
+	work_data->temp_band = -1;
 	INIT_DELAYED_WORK_DEFERRABLE(&work_data->work, sr_class1p5_calib_work);
 	*voltdm_cdata = (void *)work_data;
+
+	/* one row of calibrated voltages per temperature band */
+	if (voltdm->vdd && voltdm->vdd->volt_data) {
+		vdata = voltdm->vdd->volt_data;
+		while (vdata[work_data->num_vdata].volt_nominal)
+			work_data->num_vdata++;
+		work_data->calib_cache = kzalloc(SR1P5_TEMP_BANDS *
+						 work_data->num_vdata *
+						 sizeof(u32), GFP_KERNEL);
+	}
+	for (i = 0; work_data->calib_cache && i < MAX_VDDS; i++) {
+		if (!sr1p5_domains[i]) {
+			sr1p5_domains[i] = work_data;
+			break;
+		}
+	}
+	if (work_data->calib_cache && i == MAX_VDDS)
+		pr_warning("%s: no calibration cache slot for %s\n",
+			   __func__, voltdm->name);
+	sr_class1p5_temp_update();
 	pm_qos_add_request(&work_data->qos, PM_QOS_CPU_DMA_LATENCY,
 			  PM_QOS_DEFAULT_VALUE);
 
@@ -607,6 +819,7 @@ static int sr_class1p5_deinit(struct voltagedomain *voltdm,
 			      void **voltdm_cdata, void *class_priv_data)
 {
 	struct sr_class1p5_work_data *work_data;
+	int i;
 
 	if (IS_ERR_OR_NULL(voltdm) || IS_ERR_OR_NULL(voltdm_cdata)) {
 		pr_err("%s: bad parameters!\n", __func__);
@@ -621,6 +834,11 @@ static int sr_class1p5_deinit(struct voltagedomain *voltdm,
 
 	work_data = (struct sr_class1p5_work_data *) *voltdm_cdata;
 
+	for (i = 0; i < MAX_VDDS; i++)
+		if (sr1p5_domains[i] == work_data)
+			sr1p5_domains[i] = NULL;
+	sr_class1p5_temp_update();
+
 	/*
 	 * we dont have SR periodic calib anymore.. so reset calibs
 	 * we are already protected by appropriate locks, so no lock needed
@@ -636,6 +854,7 @@ static int sr_class1p5_deinit(struct voltagedomain *voltdm,
 	pm_qos_remove_request(&work_data->qos);
 
 	*voltdm_cdata = NULL;
+	kfree(work_data->calib_cache);
 	kfree(work_data);
 
 	return 0;
@@ -672,6 +891,10 @@ static int __init sr_class1p5_driver_init(void)
 	if (!(cpu_is_omap3630() || cpu_is_omap44xx()))
 		return -EINVAL;
 
+#ifdef CONFIG_THERMAL_FRAMEWORK
+	/* scheduled by class init once a domain has a calibration cache */
+	INIT_DELAYED_WORK_DEFERRABLE(&temp_work, sr_class1p5_temp_work);
+#endif
 	r = sr_register_class(&class1p5_data);
 	if (r) {
 		pr_err("SmartReflex class 1.5 driver: "
@@ -456,6 +456,34 @@ int omap_clk_disable_autoidle_all(void)
 	return 0;
 }
 
+/**
+ * omap_clk_for_each - call a function for each registered struct clk
+ * @fn: callback, iteration stops at the first non-zero return value
+ * @user: arbitrary pointer passed to @fn
+ *
+ * Walk the list of registered clocks with clockfw_lock held, so @fn
+ * must not call back into the clock framework.  Safe to call from the
+ * idle path.  Returns the last value returned by @fn.
+ */
+int omap_clk_for_each(int (*fn)(struct clk *clk, void *user), void *user)
+{
+	struct clk *c;
+	unsigned long flags;
+	int ret = 0;
+
+	spin_lock_irqsave(&clockfw_lock, flags);
+
+	list_for_each_entry(c, &clocks, node) {
+		ret = (*fn)(c, user);
+		if (ret)
+			break;
+	}
+
+	spin_unlock_irqrestore(&clockfw_lock, flags);
+
+	return ret;
+}
+
 /*
  * clock notifiers
  */
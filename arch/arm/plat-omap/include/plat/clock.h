@@ -129,6 +129,11 @@ struct clksel {
  * @recal_en_bit: bitshift of the PRM_IRQENABLE_* bit for recalibration IRQs
  * @recal_st_bit: bitshift of the PRM_IRQSTATUS_* bit for recalibration IRQs
  * @flags: DPLL type/features (see below)
+ * @lock_stamp: sched_clock() of the last software lock, 0 while unlocked
+ * @locked_time: accumulated locked residency in ns (PM debug only)
+ * @lock_count: number of software lock transitions (PM debug only)
+ * @lock_us_last: duration of the last wait for lock, in microseconds
+ * @lock_us_max: longest wait for lock seen, in microseconds
  *
  * Possible values for @flags:
  * DPLL_J_TYPE: "J-type DPLL" (only some 36xx, 4xxx DPLLs)
@@ -171,6 +176,13 @@ struct dpll_data {
 	u8			recal_st_bit;
 	u8			flags;
 #  endif
+#ifdef CONFIG_PM_DEBUG
+	s64			lock_stamp;
+	s64			locked_time;
+	u32			lock_count;
+	u32			lock_us_last;
+	u32			lock_us_max;
+#endif
 };
 
 #endif
@@ -334,6 +346,7 @@ struct clk {
 #endif
 #if defined(CONFIG_PM_DEBUG) && defined(CONFIG_DEBUG_FS)
 	struct dentry		*dent;	/* For visible tree hierarchy */
+	u32			block_count;	/* held a pwrdm out of idle */
 #endif
 };
 
@@ -377,6 +390,8 @@ extern void clk_exit_cpufreq_table(struct cpufreq_frequency_table **table);
 extern struct clk *omap_clk_get_by_name(const char *name);
 extern int omap_clk_enable_autoidle_all(void);
 extern int omap_clk_disable_autoidle_all(void);
+extern int omap_clk_for_each(int (*fn)(struct clk *clk, void *user),
+			     void *user);
 
 extern const struct clkops clkops_null;
 extern long clk_dummy_round_rate(struct clk *clk, unsigned long rate);
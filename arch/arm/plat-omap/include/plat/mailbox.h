@@ -8,6 +8,7 @@
 #include <linux/interrupt.h>
 #include <linux/device.h>
 #include <linux/kfifo.h>
+#include <linux/ktime.h>
 
 typedef u32 mbox_msg_t;
 struct omap_mbox;
@@ -41,6 +42,37 @@ struct omap_mbox_ops {
 	void		(*restore_ctx)(struct omap_mbox *mbox);
 };
 
+/*
+ * Single-producer/single-consumer ring used by the rx fast path: the
+ * hard irq handler is the only writer of @head and the irq thread is
+ * the only writer of @tail, so no lock is needed to pass messages.
+ */
+struct omap_mbox_rx_slot {
+	mbox_msg_t		msg;
+	ktime_t			stamp;
+};
+
+struct omap_mbox_ring {
+	struct omap_mbox_rx_slot *slot;
+	unsigned int		size;	/* power of two */
+	unsigned int		head;
+	unsigned int		tail;
+};
+
+#define OMAP_MBOX_LAT_BUCKETS	8
+
+struct omap_mbox_stats {
+	u32			rx_count;
+	u32			rx_full;
+	u32			tx_count;
+	u32			tx_queued;
+	u64			lat_min;	/* ns */
+	u64			lat_max;	/* ns */
+	u64			lat_total;	/* ns */
+	/* log4 buckets starting at < 4us, last one is open ended */
+	u32			lat_hist[OMAP_MBOX_LAT_BUCKETS];
+};
+
 struct omap_mbox_queue {
 	spinlock_t		lock;
 	struct kfifo		fifo;
@@ -48,6 +80,9 @@ struct omap_mbox_queue {
 	struct tasklet_struct	tasklet;
 	struct omap_mbox	*mbox;
 	bool full;
+#ifdef CONFIG_OMAP_MBOX_FASTPATH
+	struct omap_mbox_ring	ring;
+#endif
 };
 
 struct omap_mbox {
@@ -60,6 +95,11 @@ struct omap_mbox {
 	int			use_count;
 	struct blocking_notifier_head   notifier;
 	unsigned int		pm_constraint;
+	spinlock_t		stats_lock;	/* taken from hard irq */
+	struct omap_mbox_stats	stats;
+#ifdef CONFIG_DEBUG_FS
+	struct dentry		*dbg_dir;
+#endif
 };
 
 int omap_mbox_msg_send(struct omap_mbox *, mbox_msg_t msg);
@@ -60,6 +60,9 @@
  * completed some essential initialization during its boot. This notification
  * is used to relax any constraints put in to speed up the remote processor
  * boot.
+ *
+ * @RP_MBOX_TRACE_UPDATE: sent by the remote processor after it has written
+ * to its trace buffer, to wake up streaming trace readers.
  */
 enum {
 	RP_MBOX_READY		= 0xFFFFFF00,
@@ -69,6 +72,7 @@ enum {
 	RP_MBOX_ECHO_REPLY	= 0xFFFFFF04,
 	RP_MBOX_ABORT_REQUEST	= 0xFFFFFF05,
 	RP_MSG_BOOTINIT_DONE	= 0xFFFFFF08,
+	RP_MBOX_TRACE_UPDATE	= 0xFFFFFF0A,
 };
 
 #endif /* _PLAT_RPMSG_H */
@@ -27,9 +27,15 @@
 #include <linux/delay.h>
 #include <linux/slab.h>
 #include <linux/kfifo.h>
+#include <linux/circ_buf.h>
+#include <linux/log2.h>
 #include <linux/err.h>
 #include <linux/notifier.h>
 #include <linux/pm_qos_params.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#include <asm/div64.h>
 
 #include <plat/mailbox.h>
 
@@ -72,6 +78,41 @@ static inline int is_mbox_irq(struct omap_mbox *mbox, omap_mbox_irq_t irq)
 	return mbox->ops->is_irq(mbox, irq);
 }
 
+/*
+ * rx latency accounting, called from the context that hands the message
+ * over to the notifiers (irq thread or workqueue)
+ */
+static void mbox_rx_account(struct omap_mbox *mbox, ktime_t stamp)
+{
+	struct omap_mbox_stats *st = &mbox->stats;
+	u64 lat = ktime_to_ns(ktime_sub(ktime_get(), stamp));
+	int b = 0;
+	u64 us = lat >> 10;
+	unsigned long flags;
+
+	while ((us >>= 2) && b < OMAP_MBOX_LAT_BUCKETS - 1)
+		b++;
+
+	spin_lock_irqsave(&mbox->stats_lock, flags);
+	st->rx_count++;
+	st->lat_total += lat;
+	if (!st->lat_min || lat < st->lat_min)
+		st->lat_min = lat;
+	if (lat > st->lat_max)
+		st->lat_max = lat;
+	st->lat_hist[b]++;
+	spin_unlock_irqrestore(&mbox->stats_lock, flags);
+}
+
+static inline void mbox_stats_inc(struct omap_mbox *mbox, u32 *counter)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&mbox->stats_lock, flags);
+	(*counter)++;
+	spin_unlock_irqrestore(&mbox->stats_lock, flags);
+}
+
 /*
  * message sender
  */
@@ -101,6 +142,8 @@ int omap_mbox_msg_send(struct omap_mbox *mbox, mbox_msg_t msg)
 		goto out;
 	}
 
+	mbox_stats_inc(mbox, &mbox->stats.tx_count);
+
 	if (kfifo_is_empty(&mq->fifo) && !__mbox_poll_for_space(mbox)) {
 		mbox_fifo_write(mbox, msg);
 		goto out;
@@ -108,6 +151,7 @@ int omap_mbox_msg_send(struct omap_mbox *mbox, mbox_msg_t msg)
 
 	len = kfifo_in(&mq->fifo, (unsigned char *)&msg, sizeof(msg));
 	WARN_ON(len != sizeof(msg));
+	mbox_stats_inc(mbox, &mbox->stats.tx_queued);
 
 	tasklet_schedule(&mbox->txq->tasklet);
 
@@ -145,15 +189,17 @@ static void mbox_rx_work(struct work_struct *work)
 {
 	struct omap_mbox_queue *mq =
 			container_of(work, struct omap_mbox_queue, work);
-	mbox_msg_t msg;
+	struct omap_mbox_rx_slot slot;
 	int len;
 
-	while (kfifo_len(&mq->fifo) >= sizeof(msg)) {
-		len = kfifo_out(&mq->fifo, (unsigned char *)&msg, sizeof(msg));
-		WARN_ON(len != sizeof(msg));
+	while (kfifo_len(&mq->fifo) >= sizeof(slot)) {
+		len = kfifo_out(&mq->fifo, (unsigned char *)&slot,
+								sizeof(slot));
+		WARN_ON(len != sizeof(slot));
 
-		blocking_notifier_call_chain(&mq->mbox->notifier, len,
-								(void *)msg);
+		mbox_rx_account(mq->mbox, slot.stamp);
+		blocking_notifier_call_chain(&mq->mbox->notifier,
+					sizeof(slot.msg), (void *)slot.msg);
 		spin_lock_irq(&mq->lock);
 		if (mq->full) {
 			mq->full = false;
@@ -173,23 +219,119 @@ static void __mbox_tx_interrupt(struct omap_mbox *mbox)
 	tasklet_schedule(&mbox->txq->tasklet);
 }
 
+#ifdef CONFIG_OMAP_MBOX_FASTPATH
+/*
+ * Fast path: the hard irq handler moves messages from the h/w fifo into
+ * a lockless ring and wakes the irq thread, which calls the notifiers
+ * directly. This avoids bouncing every message through a kworker.
+ */
 static void __mbox_rx_interrupt(struct omap_mbox *mbox)
 {
 	struct omap_mbox_queue *mq = mbox->rxq;
-	mbox_msg_t msg;
+	struct omap_mbox_ring *ring = &mq->ring;
+	unsigned int head = ring->head;
+	ktime_t stamp = ktime_get();
+
+	while (!mbox_fifo_empty(mbox)) {
+		if (unlikely(!CIRC_SPACE(head, ACCESS_ONCE(ring->tail),
+							ring->size))) {
+			spin_lock(&mq->lock);
+			omap_mbox_disable_irq(mbox, IRQ_RX);
+			mq->full = true;
+			mbox_stats_inc(mbox, &mbox->stats.rx_full);
+			spin_unlock(&mq->lock);
+			return;
+		}
+
+		ring->slot[head].msg = mbox_fifo_read(mbox);
+		ring->slot[head].stamp = stamp;
+
+		/* publish the slot before moving the head past it */
+		smp_wmb();
+		head = (head + 1) & (ring->size - 1);
+		ring->head = head;
+
+		if (mbox->ops->type == OMAP_MBOX_TYPE1)
+			break;
+	}
+
+	/* no more messages in the fifo. clear IRQ source. */
+	ack_mbox_irq(mbox, IRQ_RX);
+}
+
+static irqreturn_t mbox_rx_thread(int irq, void *p)
+{
+	struct omap_mbox *mbox = p;
+	struct omap_mbox_queue *mq = mbox->rxq;
+	struct omap_mbox_ring *ring = &mq->ring;
+	struct omap_mbox_rx_slot slot;
+	unsigned int tail = ring->tail;
+
+	while (CIRC_CNT(ACCESS_ONCE(ring->head), tail, ring->size)) {
+		/* read the slot only after observing the head */
+		smp_rmb();
+		slot = ring->slot[tail];
+
+		/* finish reading the slot before handing it back */
+		smp_mb();
+		tail = (tail + 1) & (ring->size - 1);
+		ring->tail = tail;
+
+		mbox_rx_account(mbox, slot.stamp);
+		blocking_notifier_call_chain(&mbox->notifier,
+					sizeof(slot.msg), (void *)slot.msg);
+	}
+
+	spin_lock_irq(&mq->lock);
+	if (mq->full) {
+		mq->full = false;
+		omap_mbox_enable_irq(mbox, IRQ_RX);
+	}
+	spin_unlock_irq(&mq->lock);
+
+	return IRQ_HANDLED;
+}
+
+static int mbox_rx_ring_alloc(struct omap_mbox_queue *mq)
+{
+	struct omap_mbox_ring *ring = &mq->ring;
+
+	ring->size = roundup_pow_of_two(mbox_kfifo_size / sizeof(mbox_msg_t));
+	ring->slot = kcalloc(ring->size, sizeof(*ring->slot), GFP_KERNEL);
+	if (!ring->slot)
+		return -ENOMEM;
+
+	ring->head = ring->tail = 0;
+	return 0;
+}
+
+static void mbox_rx_ring_free(struct omap_mbox_queue *mq)
+{
+	kfree(mq->ring.slot);
+	mq->ring.slot = NULL;
+}
+#else
+static void __mbox_rx_interrupt(struct omap_mbox *mbox)
+{
+	struct omap_mbox_queue *mq = mbox->rxq;
+	struct omap_mbox_rx_slot slot;
 	int len;
 
+	slot.stamp = ktime_get();
+
 	while (!mbox_fifo_empty(mbox)) {
-		if (unlikely(kfifo_avail(&mq->fifo) < sizeof(msg))) {
+		if (unlikely(kfifo_avail(&mq->fifo) < sizeof(slot))) {
 			omap_mbox_disable_irq(mbox, IRQ_RX);
 			mq->full = true;
+			mbox_stats_inc(mbox, &mbox->stats.rx_full);
 			goto nomem;
 		}
 
-		msg = mbox_fifo_read(mbox);
+		slot.msg = mbox_fifo_read(mbox);
 
-		len = kfifo_in(&mq->fifo, (unsigned char *)&msg, sizeof(msg));
-		WARN_ON(len != sizeof(msg));
+		len = kfifo_in(&mq->fifo, (unsigned char *)&slot,
+								sizeof(slot));
+		WARN_ON(len != sizeof(slot));
 
 		if (mbox->ops->type == OMAP_MBOX_TYPE1)
 			break;
@@ -201,6 +343,16 @@ nomem:
 	schedule_work(&mbox->rxq->work);
 }
 
+#define mbox_rx_thread		NULL
+
+static inline int mbox_rx_ring_alloc(struct omap_mbox_queue *mq)
+{
+	return 0;
+}
+
+static inline void mbox_rx_ring_free(struct omap_mbox_queue *mq) { }
+#endif
+
 static irqreturn_t mbox_interrupt(int irq, void *p)
 {
 	struct omap_mbox *mbox = p;
@@ -208,13 +360,18 @@ static irqreturn_t mbox_interrupt(int irq, void *p)
 	if (is_mbox_irq(mbox, IRQ_TX))
 		__mbox_tx_interrupt(mbox);
 
-	if (is_mbox_irq(mbox, IRQ_RX))
+	if (is_mbox_irq(mbox, IRQ_RX)) {
 		__mbox_rx_interrupt(mbox);
+#ifdef CONFIG_OMAP_MBOX_FASTPATH
+		return IRQ_WAKE_THREAD;
+#endif
+	}
 
 	return IRQ_HANDLED;
 }
 
 static struct omap_mbox_queue *mbox_queue_alloc(struct omap_mbox *mbox,
+					unsigned int size,
 					void (*work) (struct work_struct *),
 					void (*tasklet)(unsigned long))
 {
@@ -226,7 +383,7 @@ static struct omap_mbox_queue *mbox_queue_alloc(struct omap_mbox *mbox,
 
 	spin_lock_init(&mq->lock);
 
-	if (kfifo_alloc(&mq->fifo, mbox_kfifo_size, GFP_KERNEL))
+	if (size && kfifo_alloc(&mq->fifo, size, GFP_KERNEL))
 		goto error;
 
 	if (work)
@@ -249,6 +406,7 @@ static void mbox_queue_free(struct omap_mbox_queue *q)
 static int omap_mbox_startup(struct omap_mbox *mbox)
 {
 	int ret = 0;
+	unsigned int rx_size;
 	struct omap_mbox_queue *mq;
 
 	mutex_lock(&mbox_configured_lock);
@@ -266,22 +424,36 @@ static int omap_mbox_startup(struct omap_mbox *mbox)
 	}
 
 	if (!mbox->use_count++) {
-		mq = mbox_queue_alloc(mbox, NULL, mbox_tx_tasklet);
+		mq = mbox_queue_alloc(mbox, mbox_kfifo_size, NULL,
+							mbox_tx_tasklet);
 		if (!mq) {
 			ret = -ENOMEM;
 			goto fail_alloc_txq;
 		}
 		mbox->txq = mq;
 
-		mq = mbox_queue_alloc(mbox, mbox_rx_work, NULL);
+#ifdef CONFIG_OMAP_MBOX_FASTPATH
+		/* rx goes through the ring, the rx kfifo would stay unused */
+		rx_size = 0;
+#else
+		/* rx entries carry an arrival timestamp next to the msg */
+		rx_size = mbox_kfifo_size / sizeof(mbox_msg_t) *
+					sizeof(struct omap_mbox_rx_slot);
+#endif
+		mq = mbox_queue_alloc(mbox, rx_size, mbox_rx_work, NULL);
 		if (!mq) {
 			ret = -ENOMEM;
 			goto fail_alloc_rxq;
 		}
 		mbox->rxq = mq;
 		mq->mbox = mbox;
-		ret = request_irq(mbox->irq, mbox_interrupt, IRQF_SHARED,
-							mbox->name, mbox);
+
+		ret = mbox_rx_ring_alloc(mq);
+		if (unlikely(ret))
+			goto fail_alloc_ring;
+
+		ret = request_threaded_irq(mbox->irq, mbox_interrupt,
+				mbox_rx_thread, IRQF_SHARED, mbox->name, mbox);
 		if (unlikely(ret)) {
 			pr_err("failed to register mailbox interrupt:%d\n",
 									ret);
@@ -293,6 +465,8 @@ static int omap_mbox_startup(struct omap_mbox *mbox)
 	return 0;
 
 fail_request_irq:
+	mbox_rx_ring_free(mbox->rxq);
+fail_alloc_ring:
 	mbox_queue_free(mbox->rxq);
 fail_alloc_rxq:
 	mbox_queue_free(mbox->txq);
@@ -317,6 +491,7 @@ static void omap_mbox_fini(struct omap_mbox *mbox)
 	if (!--mbox->use_count) {
 		free_irq(mbox->irq, mbox);
 		tasklet_kill(&mbox->txq->tasklet);
+		mbox_rx_ring_free(mbox->rxq);
 		mbox_queue_free(mbox->txq);
 		mbox_queue_free(mbox->rxq);
 	}
@@ -372,6 +547,94 @@ EXPORT_SYMBOL(omap_mbox_put);
 
 static struct class omap_mbox_class = { .name = "mbox", };
 
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *mbox_dbg_dir;
+
+static int mbox_stats_show(struct seq_file *s, void *unused)
+{
+	struct omap_mbox *mbox = s->private;
+	struct omap_mbox_stats snap, *st = &snap;
+	unsigned long flags;
+	u64 avg;
+	int i;
+
+	spin_lock_irqsave(&mbox->stats_lock, flags);
+	snap = mbox->stats;
+	spin_unlock_irqrestore(&mbox->stats_lock, flags);
+
+	avg = st->lat_total;
+	if (st->rx_count)
+		do_div(avg, st->rx_count);
+
+#ifdef CONFIG_OMAP_MBOX_FASTPATH
+	seq_puts(s, "mode:       irq-thread\n");
+#else
+	seq_puts(s, "mode:       workqueue\n");
+#endif
+	seq_printf(s, "rx:         %u\n", st->rx_count);
+	seq_printf(s, "rx full:    %u\n", st->rx_full);
+	seq_printf(s, "tx:         %u\n", st->tx_count);
+	seq_printf(s, "tx queued:  %u\n", st->tx_queued);
+	seq_printf(s, "lat min/avg/max (ns): %llu/%llu/%llu\n",
+				st->lat_min, avg, st->lat_max);
+	seq_puts(s, "lat histogram (us):\n");
+	for (i = 0; i < OMAP_MBOX_LAT_BUCKETS - 1; i++)
+		seq_printf(s, "  < %6u: %u\n", 4 << (2 * i), st->lat_hist[i]);
+	seq_printf(s, "  >=%6u: %u\n", 4 << (2 * (i - 1)), st->lat_hist[i]);
+
+	return 0;
+}
+
+static int mbox_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mbox_stats_show, inode->i_private);
+}
+
+static ssize_t mbox_stats_write(struct file *file, const char __user *buf,
+						size_t count, loff_t *ppos)
+{
+	struct omap_mbox *mbox =
+		((struct seq_file *)file->private_data)->private;
+	unsigned long flags;
+
+	/* any write resets the counters */
+	spin_lock_irqsave(&mbox->stats_lock, flags);
+	memset(&mbox->stats, 0, sizeof(mbox->stats));
+	spin_unlock_irqrestore(&mbox->stats_lock, flags);
+	return count;
+}
+
+static const struct file_operations mbox_stats_fops = {
+	.open		= mbox_stats_open,
+	.read		= seq_read,
+	.write		= mbox_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void mbox_debugfs_add(struct omap_mbox *mbox)
+{
+	if (!mbox_dbg_dir)
+		return;
+
+	mbox->dbg_dir = debugfs_create_dir(mbox->name, mbox_dbg_dir);
+	if (!mbox->dbg_dir)
+		return;
+
+	debugfs_create_file("stats", S_IRUGO | S_IWUSR, mbox->dbg_dir, mbox,
+							&mbox_stats_fops);
+}
+
+static void mbox_debugfs_remove(struct omap_mbox *mbox)
+{
+	debugfs_remove_recursive(mbox->dbg_dir);
+	mbox->dbg_dir = NULL;
+}
+#else
+static inline void mbox_debugfs_add(struct omap_mbox *mbox) { }
+static inline void mbox_debugfs_remove(struct omap_mbox *mbox) { }
+#endif
+
 int omap_mbox_register(struct device *parent, struct omap_mbox **list)
 {
 	int ret;
@@ -391,6 +654,8 @@ int omap_mbox_register(struct device *parent, struct omap_mbox **list)
 		}
 
 		BLOCKING_INIT_NOTIFIER_HEAD(&mbox->notifier);
+		spin_lock_init(&mbox->stats_lock);
+		mbox_debugfs_add(mbox);
 	}
 	return 0;
 
@@ -408,8 +673,10 @@ int omap_mbox_unregister(void)
 	if (!mboxes)
 		return -EINVAL;
 
-	for (i = 0; mboxes[i]; i++)
+	for (i = 0; mboxes[i]; i++) {
+		mbox_debugfs_remove(mboxes[i]);
 		device_unregister(mboxes[i]->dev);
+	}
 
 	mboxes = NULL;
 	return 0;
@@ -431,12 +698,19 @@ static int __init omap_mbox_init(void)
 
 	pm_qos_add_request(&mbox_qos_request, PM_QOS_CPU_DMA_LATENCY,
 						PM_QOS_DEFAULT_VALUE);
+
+#ifdef CONFIG_DEBUG_FS
+	mbox_dbg_dir = debugfs_create_dir("mailbox", NULL);
+#endif
 	return 0;
 }
 subsys_initcall(omap_mbox_init);
 
 static void __exit omap_mbox_exit(void)
 {
+#ifdef CONFIG_DEBUG_FS
+	debugfs_remove_recursive(mbox_dbg_dir);
+#endif
 	class_unregister(&omap_mbox_class);
 	pm_qos_remove_request(&mbox_qos_request);
 }
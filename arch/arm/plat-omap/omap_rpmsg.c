@@ -198,6 +198,10 @@ static int omap_rpmsg_mbox_callback(struct notifier_block *this,
 	case RP_MBOX_ECHO_REPLY:
 		pr_info("received echo reply from %s !\n", rpdev->rproc_name);
 		break;
+	case RP_MBOX_TRACE_UPDATE:
+		if (rpdev->rproc)
+			rproc_trace_notify(rpdev->rproc);
+		break;
 	case RP_MSG_BOOTINIT_DONE:
 		if (rpdev->bootcstr_set) {
 			int val =
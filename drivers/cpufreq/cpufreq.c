@@ -1200,6 +1200,47 @@ unsigned int cpufreq_quick_get(unsigned int cpu)
 EXPORT_SYMBOL(cpufreq_quick_get);
 
 
+static DEFINE_PER_CPU(unsigned long, cpufreq_cur_cap) = CPUFREQ_CAPACITY_SCALE;
+static DEFINE_PER_CPU(unsigned long, cpufreq_max_cap) = CPUFREQ_CAPACITY_SCALE;
+
+/**
+ * cpufreq_set_capacity - publish the frequency invariant capacity of a CPU
+ * @cpu: CPU number
+ * @cur: capacity at the frequency now applied, in CPUFREQ_CAPACITY_SCALE
+ * @max: capacity at the highest frequency currently allowed
+ *
+ * Called by the cpufreq driver once a transition or a new limit is in
+ * effect. Readers take no lock, a stale value is only one transition old.
+ */
+void cpufreq_set_capacity(unsigned int cpu, unsigned long cur,
+			  unsigned long max)
+{
+	per_cpu(cpufreq_cur_cap, cpu) = min(cur, CPUFREQ_CAPACITY_SCALE);
+	per_cpu(cpufreq_max_cap, cpu) = min(max, CPUFREQ_CAPACITY_SCALE);
+}
+EXPORT_SYMBOL_GPL(cpufreq_set_capacity);
+
+/**
+ * cpufreq_cur_capacity - capacity of a CPU at its current frequency
+ * @cpu: CPU number
+ */
+unsigned long cpufreq_cur_capacity(unsigned int cpu)
+{
+	return per_cpu(cpufreq_cur_cap, cpu);
+}
+EXPORT_SYMBOL_GPL(cpufreq_cur_capacity);
+
+/**
+ * cpufreq_max_capacity - capacity of a CPU at its highest allowed frequency
+ * @cpu: CPU number
+ */
+unsigned long cpufreq_max_capacity(unsigned int cpu)
+{
+	return per_cpu(cpufreq_max_cap, cpu);
+}
+EXPORT_SYMBOL_GPL(cpufreq_max_capacity);
+
+
 static unsigned int __cpufreq_get(unsigned int cpu)
 {
 	struct cpufreq_policy *policy = per_cpu(cpufreq_cpu_data, cpu);
@@ -0,0 +1,901 @@
+/*
+ * CPUFreq energy governor
+ *
+ * Picks the CPU frequency and the online state of CPU1 together, by
+ * estimating the average power of every (frequency, online CPUs) pair
+ * for the work seen over the last sampling periods and keeping the
+ * cheapest one that still leaves enough headroom.
+ *
+ * Based on the hotplug governor
+ * Copyright (C) 2010 Texas Instruments, Inc.
+ *   Mike Turquette <mturquette@ti.com>
+ *   Santosh Shilimkar <santosh.shilimkar@ti.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/cpufreq.h>
+#include <linux/cpuidle.h>
+#include <linux/cpu.h>
+#include <linux/jiffies.h>
+#include <linux/mutex.h>
+#include <linux/tick.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+#include <linux/err.h>
+#include <linux/slab.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+
+/* default sampling period (uSec) */
+#define DEFAULT_SAMPLING_PERIOD			(50000)
+
+/* number of sampling periods the demand is averaged over */
+#define DEFAULT_HISTORY_PERIODS			(8)
+#define MAX_HISTORY_PERIODS			(32)
+
+/* highest busy percentage a candidate OPP may run at */
+#define DEFAULT_TARGET_LOAD			(85)
+
+/* consecutive periods a candidate must win before CPU1 is plugged in/out */
+#define DEFAULT_HOTPLUG_IN_PERIODS		(2)
+#define DEFAULT_HOTPLUG_OUT_PERIODS		(10)
+
+/* energy (uJ) and latency (uS) of one CPU1 plug-in/plug-out cycle */
+#define DEFAULT_HOTPLUG_ENERGY			(2000)
+#define DEFAULT_HOTPLUG_LATENCY			(2000)
+
+/*
+ * Default per-CPU power model, meant to be replaced from field data
+ * through debugfs: a static part plus a dynamic part growing with the
+ * cube of the frequency (the voltage scales roughly with the frequency
+ * over the OPP range), and a fixed power per cpuidle state.
+ */
+#define DEFAULT_STATIC_MW			(40)
+#define DEFAULT_DYNAMIC_MW			(560)
+static const unsigned int default_idle_mw[CPUIDLE_STATE_MAX] = {
+	30, 10, 3, 1, 1, 1, 1, 1,
+};
+
+static void do_energy_timer(struct work_struct *work);
+static int cpufreq_governor_energy(struct cpufreq_policy *policy,
+		unsigned int event);
+
+#ifndef CONFIG_CPU_FREQ_DEFAULT_GOV_ENERGY
+static
+#endif
+struct cpufreq_governor cpufreq_gov_energy = {
+	.name			= "energy",
+	.governor		= cpufreq_governor_energy,
+	.owner			= THIS_MODULE,
+};
+
+struct energy_cpu_info {
+	cputime64_t prev_cpu_idle;
+	cputime64_t prev_cpu_wall;
+	unsigned long long prev_state_time[CPUIDLE_STATE_MAX];
+	bool valid;
+	/* demand, as the frequency (kHz) that would run it at 100% busy */
+	unsigned int demand[MAX_HISTORY_PERIODS];
+	unsigned int demand_idx;
+	unsigned int last_demand;
+	unsigned int avg_demand;
+	/* permille of idle time spent in each cpuidle state */
+	unsigned int idle_share[CPUIDLE_STATE_MAX];
+};
+static DEFINE_PER_CPU(struct energy_cpu_info, energy_cpu_info);
+
+/**
+ * struct energy_opp - per-OPP power model and last evaluation
+ * @freq:	frequency (kHz)
+ * @active_mw:	power of one CPU running at @freq
+ * @busy:	last predicted busy permille, per number of online CPUs
+ * @power_uw:	last predicted average power, per number of online CPUs
+ * @feasible:	whether @freq kept the busy time under target_load
+ */
+struct energy_opp {
+	unsigned int freq;
+	unsigned int active_mw;
+	unsigned int busy[2];
+	unsigned int power_uw[2];
+	bool feasible[2];
+};
+
+static struct {
+	struct cpufreq_policy *policy;
+	struct delayed_work work;
+	struct energy_opp *opp;
+	unsigned int nr_opp;
+	unsigned int idle_mw[CPUIDLE_STATE_MAX];
+	/* average runnable tasks, x100 */
+	unsigned int nr_running_avg;
+	/* CPU1 hotplug bookkeeping */
+	unsigned int in_votes;
+	unsigned int out_votes;
+	unsigned int out_savings_uj;
+	unsigned int plug_ins;
+	unsigned int plug_outs;
+	/* last decision */
+	unsigned int best_freq[2];
+	unsigned int want_cpus;
+	bool enabled;
+} energy;
+
+/*
+ * energy_mutex serializes the sampling work with the governor callbacks,
+ * the sysfs tunables and the debugfs model.
+ */
+static DEFINE_MUTEX(energy_mutex);
+
+static struct workqueue_struct *kenergy_wq;
+
+static struct energy_tuners {
+	unsigned int sampling_rate;
+	unsigned int history_periods;
+	unsigned int target_load;
+	unsigned int hotplug_in_periods;
+	unsigned int hotplug_out_periods;
+	unsigned int hotplug_energy;
+	unsigned int hotplug_latency;
+	unsigned int io_is_busy;
+} energy_tuners_ins = {
+	.sampling_rate =		DEFAULT_SAMPLING_PERIOD,
+	.history_periods =		DEFAULT_HISTORY_PERIODS,
+	.target_load =			DEFAULT_TARGET_LOAD,
+	.hotplug_in_periods =		DEFAULT_HOTPLUG_IN_PERIODS,
+	.hotplug_out_periods =		DEFAULT_HOTPLUG_OUT_PERIODS,
+	.hotplug_energy =		DEFAULT_HOTPLUG_ENERGY,
+	.hotplug_latency =		DEFAULT_HOTPLUG_LATENCY,
+	.io_is_busy =			0,
+};
+
+static inline cputime64_t get_cpu_idle_time(unsigned int cpu, cputime64_t *wall)
+{
+	u64 idle_time;
+	u64 iowait_time;
+
+	/* cpufreq-energy always assumes CONFIG_NO_HZ */
+	idle_time = get_cpu_idle_time_us(cpu, wall);
+
+	/* add time spent doing I/O to idle time */
+	if (energy_tuners_ins.io_is_busy) {
+		iowait_time = get_cpu_iowait_time_us(cpu, wall);
+		if (iowait_time != -1ULL && idle_time >= iowait_time)
+			idle_time -= iowait_time;
+	}
+
+	return idle_time;
+}
+
+/************************** sysfs interface ************************/
+
+#define show_one(file_name, object)					\
+static ssize_t show_##file_name						\
+(struct kobject *kobj, struct attribute *attr, char *buf)		\
+{									\
+	return sprintf(buf, "%u\n", energy_tuners_ins.object);		\
+}
+
+#define store_one(file_name, object, min, max)				\
+static ssize_t store_##file_name					\
+(struct kobject *a, struct attribute *b, const char *buf, size_t count)	\
+{									\
+	unsigned int input;						\
+	int ret;							\
+	ret = sscanf(buf, "%u", &input);				\
+	if (ret != 1 || input < (min) || input > (max))			\
+		return -EINVAL;						\
+									\
+	mutex_lock(&energy_mutex);					\
+	energy_tuners_ins.object = input;				\
+	mutex_unlock(&energy_mutex);					\
+									\
+	return count;							\
+}
+
+show_one(sampling_rate, sampling_rate);
+show_one(history_periods, history_periods);
+show_one(target_load, target_load);
+show_one(hotplug_in_periods, hotplug_in_periods);
+show_one(hotplug_out_periods, hotplug_out_periods);
+show_one(hotplug_energy, hotplug_energy);
+show_one(hotplug_latency, hotplug_latency);
+show_one(io_is_busy, io_is_busy);
+
+store_one(sampling_rate, sampling_rate, 10000, UINT_MAX);
+store_one(history_periods, history_periods, 1, MAX_HISTORY_PERIODS);
+store_one(target_load, target_load, 10, 100);
+store_one(hotplug_in_periods, hotplug_in_periods, 1, UINT_MAX);
+store_one(hotplug_out_periods, hotplug_out_periods, 1, UINT_MAX);
+store_one(hotplug_energy, hotplug_energy, 0, UINT_MAX);
+store_one(hotplug_latency, hotplug_latency, 0, UINT_MAX);
+store_one(io_is_busy, io_is_busy, 0, 1);
+
+define_one_global_rw(sampling_rate);
+define_one_global_rw(history_periods);
+define_one_global_rw(target_load);
+define_one_global_rw(hotplug_in_periods);
+define_one_global_rw(hotplug_out_periods);
+define_one_global_rw(hotplug_energy);
+define_one_global_rw(hotplug_latency);
+define_one_global_rw(io_is_busy);
+
+static struct attribute *energy_attributes[] = {
+	&sampling_rate.attr,
+	&history_periods.attr,
+	&target_load.attr,
+	&hotplug_in_periods.attr,
+	&hotplug_out_periods.attr,
+	&hotplug_energy.attr,
+	&hotplug_latency.attr,
+	&io_is_busy.attr,
+	NULL
+};
+
+static struct attribute_group energy_attr_group = {
+	.attrs = energy_attributes,
+	.name = "energy",
+};
+
+/************************** sysfs end ************************/
+
+/************************** power model ************************/
+
+static unsigned int energy_default_active_mw(unsigned int freq,
+		unsigned int max_freq)
+{
+	u64 r = div_u64((u64)freq * 1000, max_freq);
+
+	return DEFAULT_STATIC_MW +
+		div_u64(DEFAULT_DYNAMIC_MW * r * r * r, 1000000000);
+}
+
+static int energy_opp_init(struct cpufreq_policy *policy)
+{
+	struct cpufreq_frequency_table *table;
+	unsigned int i, n = 0, max_freq = 0;
+
+	if (energy.opp)
+		return 0;
+
+	table = cpufreq_frequency_get_table(policy->cpu);
+	if (!table)
+		return -EINVAL;
+
+	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
+		if (table[i].frequency == CPUFREQ_ENTRY_INVALID)
+			continue;
+		max_freq = max(max_freq, table[i].frequency);
+		n++;
+	}
+	if (!n)
+		return -EINVAL;
+
+	energy.opp = kcalloc(n, sizeof(*energy.opp), GFP_KERNEL);
+	if (!energy.opp)
+		return -ENOMEM;
+
+	for (i = 0, n = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
+		if (table[i].frequency == CPUFREQ_ENTRY_INVALID)
+			continue;
+		energy.opp[n].freq = table[i].frequency;
+		energy.opp[n].active_mw =
+			energy_default_active_mw(table[i].frequency, max_freq);
+		n++;
+	}
+	energy.nr_opp = n;
+
+	return 0;
+}
+
+/* average idle power of @cpu, in uW, from its cpuidle residency */
+static unsigned int energy_idle_uw(struct energy_cpu_info *info)
+{
+	unsigned int i, uw = 0;
+
+	for (i = 0; i < CPUIDLE_STATE_MAX; i++)
+		uw += info->idle_share[i] * energy.idle_mw[i];
+
+	return uw;
+}
+
+/* average power (uW) of one CPU doing @demand at @opp */
+static unsigned int energy_cpu_uw(struct energy_opp *opp,
+		unsigned int demand, unsigned int idle_uw,
+		unsigned int *busy)
+{
+	unsigned int b;
+
+	b = min_t(unsigned int, div_u64((u64)demand * 1000, opp->freq), 1000);
+	if (busy)
+		*busy = b;
+
+	return b * opp->active_mw + div_u64((u64)(1000 - b) * idle_uw, 1000);
+}
+
+/************************** power model end ************************/
+
+static void energy_sample_cpu(unsigned int cpu, unsigned int cur_freq)
+{
+	struct energy_cpu_info *info = &per_cpu(energy_cpu_info, cpu);
+	unsigned int idle_time, wall_time, demand, periods, i, sum;
+	cputime64_t cur_wall_time, cur_idle_time;
+#ifdef CONFIG_CPU_IDLE
+	struct cpuidle_device *dev = per_cpu(cpuidle_devices, cpu);
+	unsigned long long delta[CPUIDLE_STATE_MAX], total = 0;
+#endif
+
+	cur_idle_time = get_cpu_idle_time(cpu, &cur_wall_time);
+	wall_time = (unsigned int) cputime64_sub(cur_wall_time,
+			info->prev_cpu_wall);
+	idle_time = (unsigned int) cputime64_sub(cur_idle_time,
+			info->prev_cpu_idle);
+	info->prev_cpu_wall = cur_wall_time;
+	info->prev_cpu_idle = cur_idle_time;
+
+#ifdef CONFIG_CPU_IDLE
+	if (dev && dev->enabled) {
+		for (i = 0; i < dev->state_count; i++) {
+			unsigned long long t = dev->states[i].time;
+
+			delta[i] = t - info->prev_state_time[i];
+			info->prev_state_time[i] = t;
+			total += delta[i];
+		}
+	}
+#endif
+
+	/* first sample after (re)onlining only sets the baseline */
+	if (!info->valid) {
+		info->valid = true;
+		return;
+	}
+
+	if (unlikely(!wall_time || wall_time < idle_time))
+		return;
+
+	demand = div_u64((u64)(wall_time - idle_time) * cur_freq, wall_time);
+	info->last_demand = demand;
+	info->demand[info->demand_idx] = demand;
+	periods = energy_tuners_ins.history_periods;
+	if (++info->demand_idx >= periods)
+		info->demand_idx = 0;
+
+	for (i = 0, sum = 0; i < periods; i++)
+		sum += info->demand[i];
+	info->avg_demand = sum / periods;
+
+#ifdef CONFIG_CPU_IDLE
+	if (total) {
+		for (i = 0; i < dev->state_count; i++) {
+			unsigned int share = div64_u64(delta[i] * 1000, total);
+
+			info->idle_share[i] = (info->idle_share[i] * 3 +
+					       share) / 4;
+		}
+		return;
+	}
+#endif
+	if (idle_time) {
+		/* idle without cpuidle accounting: charge the shallowest */
+		memset(info->idle_share, 0, sizeof(info->idle_share));
+		info->idle_share[0] = 1000;
+	}
+}
+
+/* predicted demand: react to bursts at once, decay with the history */
+static inline unsigned int energy_predict(struct energy_cpu_info *info)
+{
+	return max(info->last_demand, info->avg_demand);
+}
+
+/**
+ * energy_evaluate() - price every OPP for one and for two online CPUs
+ * @policy:	policy being governed
+ *
+ * Fills energy.opp[] and energy.best_freq[] and returns the number of
+ * online CPUs of the cheapest configuration.
+ */
+static unsigned int energy_evaluate(struct cpufreq_policy *policy)
+{
+	struct energy_cpu_info *info0 = &per_cpu(energy_cpu_info, 0);
+	struct energy_cpu_info *info1 = &per_cpu(energy_cpu_info, 1);
+	unsigned int total = 0, peak = 0, d[2], idle_uw[2];
+	unsigned int best_uw[2] = { UINT_MAX, UINT_MAX };
+	unsigned int parallel, i, n, j;
+	bool online1 = cpu_online(1);
+
+	for_each_online_cpu(j) {
+		unsigned int p = energy_predict(&per_cpu(energy_cpu_info, j));
+
+		total += p;
+		peak = max(peak, p);
+	}
+
+	/*
+	 * With CPU1 online the per-CPU demand is measured; with it offline
+	 * the split is estimated from the number of runnable tasks.
+	 */
+	parallel = clamp(energy.nr_running_avg, 100U, 200U);
+	d[0] = total;
+	d[1] = online1 ? peak : total * 100 / parallel;
+
+	idle_uw[0] = energy_idle_uw(info0);
+	idle_uw[1] = online1 ? energy_idle_uw(info1) : idle_uw[0];
+
+	energy.best_freq[0] = energy.best_freq[1] = 0;
+
+	for (i = 0; i < energy.nr_opp; i++) {
+		struct energy_opp *opp = &energy.opp[i];
+
+		for (n = 0; n < 2; n++) {
+			unsigned int uw, busy;
+
+			opp->feasible[n] = false;
+			opp->power_uw[n] = 0;
+			if (opp->freq < policy->min || opp->freq > policy->max)
+				continue;
+			if (n && !cpu_possible(1))
+				continue;
+
+			uw = energy_cpu_uw(opp, d[n], idle_uw[0], &busy);
+			if (n)
+				uw += energy_cpu_uw(opp, total > d[1] ?
+						    total - d[1] : 0,
+						    idle_uw[1], NULL);
+			opp->busy[n] = busy;
+			opp->power_uw[n] = uw;
+			opp->feasible[n] = busy <=
+				energy_tuners_ins.target_load * 10;
+
+			if (opp->feasible[n] && uw < best_uw[n]) {
+				best_uw[n] = uw;
+				energy.best_freq[n] = opp->freq;
+			}
+		}
+	}
+
+	/* nothing sustains the load: run flat out */
+	for (n = 0; n < 2; n++)
+		if (!energy.best_freq[n])
+			energy.best_freq[n] = policy->max;
+
+	if (!cpu_possible(1) || best_uw[0] <= best_uw[1]) {
+		/* account for what keeping CPU1 online costs meanwhile */
+		if (online1 && best_uw[1] != UINT_MAX &&
+		    best_uw[0] != UINT_MAX)
+			energy.out_savings_uj += div_u64((u64)(best_uw[1] -
+					best_uw[0]) *
+					energy_tuners_ins.sampling_rate,
+					1000000);
+		return (best_uw[0] == UINT_MAX && cpu_possible(1)) ? 2 : 1;
+	}
+
+	return 2;
+}
+
+/* energy to bring CPU1 up and down again, in uJ */
+static unsigned int energy_plug_cost(struct cpufreq_policy *policy)
+{
+	unsigned int i, max_mw = 0;
+
+	for (i = 0; i < energy.nr_opp; i++)
+		max_mw = max(max_mw, energy.opp[i].active_mw);
+
+	/* CPU0 is busy for the hotplug latency on top of the fixed cost */
+	return energy_tuners_ins.hotplug_energy +
+		div_u64((u64)max_mw * energy_tuners_ins.hotplug_latency, 1000);
+}
+
+static void energy_check_cpu(struct cpufreq_policy *policy)
+{
+	unsigned int j, want, online;
+
+	for_each_possible_cpu(j) {
+		if (!cpu_online(j)) {
+			per_cpu(energy_cpu_info, j).valid = false;
+			continue;
+		}
+		energy_sample_cpu(j, policy->cur);
+	}
+
+	energy.nr_running_avg = (energy.nr_running_avg * 3 +
+				 nr_running() * 100) / 4;
+
+	want = energy_evaluate(policy);
+	energy.want_cpus = want;
+	online = cpu_online(1) ? 2 : 1;
+
+	if (want > online) {
+		energy.out_votes = 0;
+		energy.out_savings_uj = 0;
+		if (++energy.in_votes >= energy_tuners_ins.hotplug_in_periods) {
+			energy.in_votes = 0;
+			/*
+			 * hotplug with cpufreq is nasty: cpufreq callbacks
+			 * may need energy_mutex, so drop it across cpu_up.
+			 */
+			mutex_unlock(&energy_mutex);
+			if (!cpu_up(1))
+				energy.plug_ins++;
+			mutex_lock(&energy_mutex);
+			online = cpu_online(1) ? 2 : 1;
+		}
+	} else if (want < online) {
+		energy.in_votes = 0;
+		if (++energy.out_votes >=
+				energy_tuners_ins.hotplug_out_periods &&
+		    energy.out_savings_uj >= energy_plug_cost(policy)) {
+			energy.out_votes = 0;
+			energy.out_savings_uj = 0;
+			mutex_unlock(&energy_mutex);
+			if (!cpu_down(1))
+				energy.plug_outs++;
+			mutex_lock(&energy_mutex);
+			online = cpu_online(1) ? 2 : 1;
+		}
+	} else {
+		energy.in_votes = 0;
+		energy.out_votes = 0;
+		energy.out_savings_uj = 0;
+	}
+
+	if (energy.best_freq[online - 1] != policy->cur)
+		__cpufreq_driver_target(policy, energy.best_freq[online - 1],
+					CPUFREQ_RELATION_L);
+}
+
+static void do_energy_timer(struct work_struct *work)
+{
+	int delay = usecs_to_jiffies(energy_tuners_ins.sampling_rate);
+
+	mutex_lock(&energy_mutex);
+	if (!energy.enabled) {
+		mutex_unlock(&energy_mutex);
+		return;
+	}
+	energy_check_cpu(energy.policy);
+	if (energy.enabled)
+		queue_delayed_work_on(energy.policy->cpu, kenergy_wq,
+				      &energy.work, delay);
+	mutex_unlock(&energy_mutex);
+}
+
+static void energy_online_cpu1(struct work_struct *work)
+{
+	cpu_up(1);
+}
+static DECLARE_WORK(energy_online_work, energy_online_cpu1);
+
+/************************** debugfs model ************************/
+
+#ifdef CONFIG_DEBUG_FS
+static int energy_model_show(struct seq_file *s, void *unused)
+{
+	unsigned int i, j;
+
+	mutex_lock(&energy_mutex);
+
+	seq_printf(s, "nr_running_avg: %u.%02u\n",
+		   energy.nr_running_avg / 100, energy.nr_running_avg % 100);
+	for_each_possible_cpu(j) {
+		struct energy_cpu_info *info = &per_cpu(energy_cpu_info, j);
+
+		seq_printf(s, "cpu%u: demand %u avg %u kHz, idle %u uW, "
+			   "residency", j, info->last_demand,
+			   info->avg_demand, energy_idle_uw(info));
+		for (i = 0; i < CPUIDLE_STATE_MAX; i++)
+			seq_printf(s, " %u", info->idle_share[i]);
+		seq_printf(s, "\n");
+	}
+
+	seq_printf(s, "\n%10s %10s %8s %10s %8s %10s\n", "freq", "active_mw",
+		   "busy1", "power1_uw", "busy2", "power2_uw");
+	for (i = 0; i < energy.nr_opp; i++) {
+		struct energy_opp *opp = &energy.opp[i];
+
+		seq_printf(s, "%10u %10u %7u%c %10u %7u%c %10u\n",
+			   opp->freq, opp->active_mw,
+			   opp->busy[0] / 10, opp->feasible[0] ? ' ' : '!',
+			   opp->power_uw[0],
+			   opp->busy[1] / 10, opp->feasible[1] ? ' ' : '!',
+			   opp->power_uw[1]);
+	}
+
+	seq_printf(s, "\nwant %u cpu(s), best %u/%u kHz, in_votes %u, "
+		   "out_votes %u, savings %u/%u uJ, plug_ins %u, "
+		   "plug_outs %u\n", energy.want_cpus, energy.best_freq[0],
+		   energy.best_freq[1], energy.in_votes, energy.out_votes,
+		   energy.out_savings_uj,
+		   energy.policy ? energy_plug_cost(energy.policy) : 0,
+		   energy.plug_ins, energy.plug_outs);
+
+	mutex_unlock(&energy_mutex);
+	return 0;
+}
+
+static int energy_model_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, energy_model_show, inode->i_private);
+}
+
+static const struct file_operations energy_model_fops = {
+	.open = energy_model_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int energy_opp_power_show(struct seq_file *s, void *unused)
+{
+	unsigned int i;
+
+	mutex_lock(&energy_mutex);
+	for (i = 0; i < energy.nr_opp; i++)
+		seq_printf(s, "%u %u\n", energy.opp[i].freq,
+			   energy.opp[i].active_mw);
+	mutex_unlock(&energy_mutex);
+
+	return 0;
+}
+
+static int energy_opp_power_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, energy_opp_power_show, inode->i_private);
+}
+
+/* "<freq> <mW>" sets the active power of one OPP */
+static ssize_t energy_opp_power_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	char buf[32];
+	unsigned int freq, mw, i;
+	ssize_t ret = -EINVAL;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	if (sscanf(buf, "%u %u", &freq, &mw) != 2)
+		return -EINVAL;
+
+	mutex_lock(&energy_mutex);
+	for (i = 0; i < energy.nr_opp; i++) {
+		if (energy.opp[i].freq == freq) {
+			energy.opp[i].active_mw = mw;
+			ret = count;
+			break;
+		}
+	}
+	mutex_unlock(&energy_mutex);
+
+	return ret;
+}
+
+static const struct file_operations energy_opp_power_fops = {
+	.open = energy_opp_power_open,
+	.read = seq_read,
+	.write = energy_opp_power_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int energy_idle_power_show(struct seq_file *s, void *unused)
+{
+	unsigned int i;
+
+	mutex_lock(&energy_mutex);
+	for (i = 0; i < CPUIDLE_STATE_MAX; i++)
+		seq_printf(s, "%u %u\n", i, energy.idle_mw[i]);
+	mutex_unlock(&energy_mutex);
+
+	return 0;
+}
+
+static int energy_idle_power_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, energy_idle_power_show, inode->i_private);
+}
+
+/* "<cpuidle state> <mW>" sets the power of one idle state */
+static ssize_t energy_idle_power_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	char buf[32];
+	unsigned int state, mw;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	if (sscanf(buf, "%u %u", &state, &mw) != 2 ||
+	    state >= CPUIDLE_STATE_MAX)
+		return -EINVAL;
+
+	mutex_lock(&energy_mutex);
+	energy.idle_mw[state] = mw;
+	mutex_unlock(&energy_mutex);
+
+	return count;
+}
+
+static const struct file_operations energy_idle_power_fops = {
+	.open = energy_idle_power_open,
+	.read = seq_read,
+	.write = energy_idle_power_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static struct dentry *energy_debugfs_dir;
+
+static void __init energy_debugfs_init(void)
+{
+	energy_debugfs_dir = debugfs_create_dir("cpufreq_energy", NULL);
+	if (IS_ERR_OR_NULL(energy_debugfs_dir))
+		return;
+
+	debugfs_create_file("model", S_IRUGO, energy_debugfs_dir, NULL,
+			    &energy_model_fops);
+	debugfs_create_file("opp_power", S_IRUGO | S_IWUSR,
+			    energy_debugfs_dir, NULL, &energy_opp_power_fops);
+	debugfs_create_file("idle_power", S_IRUGO | S_IWUSR,
+			    energy_debugfs_dir, NULL, &energy_idle_power_fops);
+}
+
+static void energy_debugfs_exit(void)
+{
+	debugfs_remove_recursive(energy_debugfs_dir);
+}
+#else
+static inline void energy_debugfs_init(void) { }
+static inline void energy_debugfs_exit(void) { }
+#endif
+
+/************************** debugfs model end ************************/
+
+static int cpufreq_governor_energy(struct cpufreq_policy *policy,
+				   unsigned int event)
+{
+	unsigned int j;
+	int delay, rc;
+
+	switch (event) {
+	case CPUFREQ_GOV_START:
+		if ((!cpu_online(policy->cpu)) || (!policy->cur))
+			return -EINVAL;
+
+		mutex_lock(&energy_mutex);
+		if (energy.enabled) {
+			mutex_unlock(&energy_mutex);
+			return 0;
+		}
+
+		rc = energy_opp_init(policy);
+		if (rc) {
+			mutex_unlock(&energy_mutex);
+			return rc;
+		}
+
+		for_each_possible_cpu(j) {
+			struct energy_cpu_info *info =
+				&per_cpu(energy_cpu_info, j);
+
+			memset(info, 0, sizeof(*info));
+			info->idle_share[0] = 1000;
+		}
+		energy.policy = policy;
+		energy.nr_running_avg = 100;
+		energy.in_votes = energy.out_votes = 0;
+		energy.out_savings_uj = 0;
+
+		rc = sysfs_create_group(cpufreq_global_kobject,
+					&energy_attr_group);
+		if (rc) {
+			mutex_unlock(&energy_mutex);
+			return rc;
+		}
+
+		energy.enabled = true;
+		mutex_unlock(&energy_mutex);
+
+		/* We want sampling nearly on the same jiffy every period */
+		delay = usecs_to_jiffies(energy_tuners_ins.sampling_rate);
+		delay -= jiffies % delay;
+		INIT_DELAYED_WORK_DEFERRABLE(&energy.work, do_energy_timer);
+		queue_delayed_work_on(policy->cpu, kenergy_wq, &energy.work,
+				      delay);
+		break;
+
+	case CPUFREQ_GOV_STOP:
+		mutex_lock(&energy_mutex);
+		energy.enabled = false;
+		mutex_unlock(&energy_mutex);
+		cancel_delayed_work_sync(&energy.work);
+
+		sysfs_remove_group(cpufreq_global_kobject, &energy_attr_group);
+
+		/*
+		 * Do not leave CPU1 offline behind us.  cpu_up() needs the
+		 * cpufreq locks held by our caller, so do it from a work.
+		 */
+		if (cpu_possible(1) && !cpu_online(1))
+			schedule_work(&energy_online_work);
+		break;
+
+	case CPUFREQ_GOV_LIMITS:
+		mutex_lock(&energy_mutex);
+		if (policy->max < policy->cur)
+			__cpufreq_driver_target(policy,
+				policy->max, CPUFREQ_RELATION_H);
+		else if (policy->min > policy->cur)
+			__cpufreq_driver_target(policy,
+				policy->min, CPUFREQ_RELATION_L);
+		mutex_unlock(&energy_mutex);
+		break;
+	}
+	return 0;
+}
+
+static int __init cpufreq_gov_energy_init(void)
+{
+	cputime64_t wall;
+	u64 idle_time;
+	int i, err;
+	int cpu = get_cpu();
+
+	idle_time = get_cpu_idle_time_us(cpu, &wall);
+	put_cpu();
+	if (idle_time == -1ULL) {
+		pr_err("cpufreq-energy: %s: assumes CONFIG_NO_HZ\n",
+				__func__);
+		return -EINVAL;
+	}
+
+	for (i = 0; i < CPUIDLE_STATE_MAX; i++)
+		energy.idle_mw[i] = default_idle_mw[i];
+
+	kenergy_wq = create_workqueue("kenergy");
+	if (!kenergy_wq) {
+		pr_err("Creation of kenergy failed\n");
+		return -EFAULT;
+	}
+
+	err = cpufreq_register_governor(&cpufreq_gov_energy);
+	if (err) {
+		destroy_workqueue(kenergy_wq);
+		return err;
+	}
+
+	energy_debugfs_init();
+	return 0;
+}
+
+static void __exit cpufreq_gov_energy_exit(void)
+{
+	energy_debugfs_exit();
+	cpufreq_unregister_governor(&cpufreq_gov_energy);
+	destroy_workqueue(kenergy_wq);
+	kfree(energy.opp);
+}
+
+MODULE_DESCRIPTION("'cpufreq_energy' - cpufreq governor choosing frequency and CPU1 hotplug from an energy model");
+MODULE_LICENSE("GPL");
+
+#ifdef CONFIG_CPU_FREQ_DEFAULT_GOV_ENERGY
+fs_initcall(cpufreq_gov_energy_init);
+#else
+module_init(cpufreq_gov_energy_init);
+#endif
+module_exit(cpufreq_gov_energy_exit);
@@ -99,6 +99,7 @@ static struct dbs_tuners {
 	unsigned int *hotplug_load_history;
 	unsigned int ignore_nice;
 	unsigned int io_is_busy;
+	unsigned int freq_invariant;
 } dbs_tuners_ins = {
 	.sampling_rate =		DEFAULT_SAMPLING_PERIOD,
 	.up_threshold =			DEFAULT_UP_FREQ_MIN_LOAD,
@@ -109,6 +110,7 @@ static struct dbs_tuners {
 	.hotplug_load_index =		0,
 	.ignore_nice =			0,
 	.io_is_busy =			0,
+	.freq_invariant =		1,
 };
 
 /*
@@ -156,6 +158,7 @@ show_one(hotplug_in_sampling_periods, hotplug_in_sampling_periods);
 show_one(hotplug_out_sampling_periods, hotplug_out_sampling_periods);
 show_one(ignore_nice_load, ignore_nice);
 show_one(io_is_busy, io_is_busy);
+show_one(freq_invariant, freq_invariant);
 
 static ssize_t store_sampling_rate(struct kobject *a, struct attribute *b,
 				   const char *buf, size_t count)
@@ -378,6 +381,23 @@ static ssize_t store_io_is_busy(struct kobject *a, struct attribute *b,
 	return count;
 }
 
+static ssize_t store_freq_invariant(struct kobject *a, struct attribute *b,
+				    const char *buf, size_t count)
+{
+	unsigned int input;
+	int ret;
+
+	ret = sscanf(buf, "%u", &input);
+	if (ret != 1)
+		return -EINVAL;
+
+	mutex_lock(&dbs_mutex);
+	dbs_tuners_ins.freq_invariant = !!input;
+	mutex_unlock(&dbs_mutex);
+
+	return count;
+}
+
 define_one_global_rw(sampling_rate);
 define_one_global_rw(up_threshold);
 define_one_global_rw(down_differential);
@@ -386,6 +406,7 @@ define_one_global_rw(hotplug_in_sampling_periods);
 define_one_global_rw(hotplug_out_sampling_periods);
 define_one_global_rw(ignore_nice_load);
 define_one_global_rw(io_is_busy);
+define_one_global_rw(freq_invariant);
 
 static struct attribute *dbs_attributes[] = {
 	&sampling_rate.attr,
@@ -396,6 +417,7 @@ static struct attribute *dbs_attributes[] = {
 	&hotplug_out_sampling_periods.attr,
 	&ignore_nice_load.attr,
 	&io_is_busy.attr,
+	&freq_invariant.attr,
 	NULL
 };
 
@@ -416,6 +438,8 @@ static void dbs_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
 	unsigned int max_load_freq = 0;
 	/* average load across all enabled CPUs */
 	unsigned int avg_load = 0;
+	/* average load scaled to the highest allowed frequency */
+	unsigned int hotplug_load;
 	/* average load across multiple sampling periods for hotplug events */
 	unsigned int hotplug_in_avg_load = 0;
 	unsigned int hotplug_out_avg_load = 0;
@@ -472,6 +496,19 @@ static void dbs_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
 	/* calculate the average load across all related CPUs */
 	avg_load = total_load / num_online_cpus();
 
+	/*
+	 * hotplug decisions use the load the CPUs would see at the highest
+	 * frequency currently allowed, so that work measured at a low OPP
+	 * raises the frequency first instead of bringing in another CPU
+	 */
+	hotplug_load = avg_load;
+	if (dbs_tuners_ins.freq_invariant) {
+		unsigned long max_cap = cpufreq_max_capacity(policy->cpu);
+
+		if (max_cap)
+			hotplug_load = min_t(unsigned long, 100, avg_load *
+				cpufreq_cur_capacity(policy->cpu) / max_cap);
+	}
 
 	/*
 	 * hotplug load accounting
@@ -482,9 +519,9 @@ static void dbs_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
 	periods = max(dbs_tuners_ins.hotplug_in_sampling_periods,
 			dbs_tuners_ins.hotplug_out_sampling_periods);
 
-	/* store avg_load in the circular buffer */
+	/* store hotplug_load in the circular buffer */
 	dbs_tuners_ins.hotplug_load_history[dbs_tuners_ins.hotplug_load_index]
-		= avg_load;
+		= hotplug_load;
 
 	/* compute average load across in & out sampling periods */
 	for (i = 0, j = dbs_tuners_ins.hotplug_load_index;
@@ -510,8 +547,8 @@ static void dbs_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
 	if (++dbs_tuners_ins.hotplug_load_index == periods)
 		dbs_tuners_ins.hotplug_load_index = 0;
 
-	/* check if auxiliary CPU is needed based on avg_load */
-	if (avg_load > dbs_tuners_ins.up_threshold) {
+	/* check if auxiliary CPU is needed based on hotplug_load */
+	if (hotplug_load > dbs_tuners_ins.up_threshold) {
 		/* should we enable auxillary CPUs? */
 		if (num_online_cpus() < 2 && hotplug_in_avg_load >
 				dbs_tuners_ins.up_threshold) {
@@ -29,6 +29,7 @@
 #include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/input.h>
+#include <linux/math64.h>
 #include <asm/cputime.h>
 
 #define CREATE_TRACE_POINTS
@@ -107,6 +108,16 @@ static u64 hispeed_freq;
 /* Go to hi speed when CPU load at or above this value. */
 #define DEFAULT_GO_HISPEED_LOAD 95
 static unsigned long go_hispeed_load;
+/*
+ * Below hispeed, pick the lowest frequency that runs the measured work at
+ * or below target_load, using the capacity of the OPP the load was
+ * measured at.  target_load is kept under go_hispeed_load so the chosen
+ * OPP does not immediately read as a hispeed burst.
+ */
+static unsigned long freq_invariant = 1;
+#define DEFAULT_TARGET_LOAD 90
+static unsigned long target_load = DEFAULT_TARGET_LOAD;
+
 /*
  * The minimum amount of time to spend at a frequency before we can ramp down.
  */
@@ -187,6 +198,7 @@ static void cpufreq_interactive_timer(unsigned long data)
 	u64 now_idle;
 	unsigned int new_freq, new_tune_value;
 	unsigned int index, i, j;
+	unsigned int relation = CPUFREQ_RELATION_H;
 	unsigned long flags;
 
 	smp_rmb();
@@ -323,6 +335,12 @@ static void cpufreq_interactive_timer(unsigned long data)
 				goto rearm;
 			}
 		}
+	} else if (freq_invariant) {
+		new_freq = div_u64((u64)pcpu->policy->cpuinfo.max_freq *
+				   cpu_load * cpufreq_cur_capacity(data),
+				   clamp(target_load, 1UL, go_hispeed_load) *
+				   CPUFREQ_CAPACITY_SCALE);
+		relation = CPUFREQ_RELATION_L;
 	} else {
 		new_freq = pcpu->policy->max * cpu_load / 100;
 	}
@@ -331,7 +349,7 @@ static void cpufreq_interactive_timer(unsigned long data)
 		pcpu->hispeed_validate_time = pcpu->timer_run_time;
 
 	if (cpufreq_frequency_table_target(pcpu->policy, pcpu->freq_table,
-					   new_freq, CPUFREQ_RELATION_H,
+					   new_freq, relation,
 					   &index)) {
 		pr_warn_once("timer %d: cpufreq_frequency_table_target error\n",
 			     (int) data);
@@ -830,6 +848,52 @@ static ssize_t store_go_hispeed_load(struct kobject *kobj,
 static struct global_attr go_hispeed_load_attr = __ATTR(go_hispeed_load, 0644,
 		show_go_hispeed_load, store_go_hispeed_load);
 
+static ssize_t show_freq_invariant(struct kobject *kobj,
+				   struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", freq_invariant);
+}
+
+static ssize_t store_freq_invariant(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	freq_invariant = !!val;
+	return count;
+}
+
+static struct global_attr freq_invariant_attr = __ATTR(freq_invariant, 0644,
+		show_freq_invariant, store_freq_invariant);
+
+static ssize_t show_target_load(struct kobject *kobj,
+				struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", target_load);
+}
+
+static ssize_t store_target_load(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	if (!val || val > 100)
+		return -EINVAL;
+	target_load = val;
+	return count;
+}
+
+static struct global_attr target_load_attr = __ATTR(target_load, 0644,
+		show_target_load, store_target_load);
+
 static ssize_t show_min_sample_time(struct kobject *kobj,
 				struct attribute *attr, char *buf)
 {
@@ -1103,6 +1167,8 @@ static struct global_attr low_power_rate_attr = __ATTR(low_power_rate,
 static struct attribute *interactive_attributes[] = {
 	&hispeed_freq_attr.attr,
 	&go_hispeed_load_attr.attr,
+	&freq_invariant_attr.attr,
+	&target_load_attr.attr,
 	&above_hispeed_delay.attr,
 	&min_sample_time_attr.attr,
 	&timer_rate_attr.attr,
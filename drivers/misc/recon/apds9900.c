@@ -21,6 +21,7 @@
 #include "i2c_transfer.h"
 #include "risensors_def.h"
 #include "apds9900.h"
+#include "jet_async_probe.h"
 
 #define APDS_IOCTL_BASE 'a'
 #define APDS_READ_BYTE  _IOWR(APDS_IOCTL_BASE, 0,int)
@@ -843,7 +844,7 @@ static struct i2c_driver apds_driver =
 
 static int __init apds_init(void)
 {
-	int res=i2c_add_driver(&apds_driver);
+	int res=jet_i2c_add_driver(&apds_driver);
 	pr_info("%s: Probe name %s\n", __func__, DRIVER_NAME);
 	if(res)
 		printk(KERN_ERR "%s failed\n", __func__);
@@ -0,0 +1,34 @@
+#ifndef __JET_ASYNC_PROBE_H__
+#define __JET_ASYNC_PROBE_H__
+#include <linux/async.h>
+#include <linux/i2c.h>
+
+/*
+ * Most of the Recon parts need a power-up delay or a few retries before
+ * they answer on I2C, and they do not depend on each other. With
+ * CONFIG_JET_ASYNC_PROBE the driver is registered from the async domain so
+ * these probes overlap with each other and with the remaining initcalls.
+ * init_post() and sys_init_module() wait for the async domain, so every
+ * device is bound before userspace or the module loader carries on.
+ */
+static inline void jet_i2c_add_driver_async(void *data, async_cookie_t cookie)
+{
+	struct i2c_driver *driver = data;
+	int res = i2c_add_driver(driver);
+
+	if (res)
+		printk(KERN_ERR "%s: %s failed %d\n", __func__,
+		       driver->driver.name, res);
+}
+
+static inline int jet_i2c_add_driver(struct i2c_driver *driver)
+{
+#ifdef CONFIG_JET_ASYNC_PROBE
+	async_schedule(jet_i2c_add_driver_async, driver);
+	return 0;
+#else
+	return i2c_add_driver(driver);
+#endif
+}
+
+#endif
@@ -50,6 +50,9 @@ typedef struct _risensdata
 /* global instance of MUX device */
 risensdata*  gMUX = 0;
 
+/* serializes sensor registrations; drivers may probe in parallel at boot */
+static DEFINE_MUTEX(gRegisterLock);
+
 
 /************** Sensor Node Work Function (For nodes on Default queue) **********************/ 
 static void node_work_function (struct work_struct* pws)
@@ -595,8 +598,8 @@ static void __exit proxmux_exit(void)
 }
 
 
-/* Registration export: Irq mode */
-RI_SENSOR_STATUS risensor_register_irq 
+/* Registration: Irq mode, called with gRegisterLock held */
+static RI_SENSOR_STATUS _risensor_register_irq
 (
     RI_SENSOR_HANDLE handle,        // sensor id
     const char*      name,          // sensor name
@@ -690,8 +693,8 @@ err_alloc_node:
 
 
 
-/* Registration export: Poll mode */
-RI_SENSOR_STATUS risensor_register
+/* Registration: Poll mode, called with gRegisterLock held */
+static RI_SENSOR_STATUS _risensor_register
 (
     RI_SENSOR_HANDLE handle,        // sensor id
     const char*      name,          // sensor name
@@ -798,6 +801,48 @@ err_alloc_node:
 
 }
 
+/* Registration export: Irq mode */
+RI_SENSOR_STATUS risensor_register_irq
+(
+    RI_SENSOR_HANDLE handle,
+    const char*      name,
+    void*            context,
+    unsigned int     datasize,
+    PFNSENS_ACTIVATE cbkActivate
+)
+{
+    RI_SENSOR_STATUS status;
+
+    mutex_lock(&gRegisterLock);
+    status = _risensor_register_irq(handle, name, context, datasize, cbkActivate);
+    mutex_unlock(&gRegisterLock);
+
+    return status;
+}
+
+/* Registration export: Poll mode */
+RI_SENSOR_STATUS risensor_register
+(
+    RI_SENSOR_HANDLE handle,
+    const char*      name,
+    void*            context,
+    RI_SENSOR_MODE   modemask,
+    RI_SENSOR_MODE   currentmode,
+    unsigned int     datasize,
+    PFNSENS_ACTIVATE cbkActivate,
+    PFNSENS_READ     cbkRead
+)
+{
+    RI_SENSOR_STATUS status;
+
+    mutex_lock(&gRegisterLock);
+    status = _risensor_register(handle, name, context, modemask, currentmode,
+                                datasize, cbkActivate, cbkRead);
+    mutex_unlock(&gRegisterLock);
+
+    return status;
+}
+
 
 /* Reverse callback for Interrupt sensors */
 RI_SENSOR_STATUS risensor_irq_data (RI_SENSOR_HANDLE handle, unsigned char* databuffer, RI_DATA_SIZE buffersize)
@@ -20,6 +20,7 @@
 #include "jet_sensors.h"
 #include "jet_lsm9ds0.h"
 #include "jet_lps25h.h"
+#include "jet_async_probe.h"
 
 #define DRIVER_NAME             "jet_sensors"
 // sensor names
@@ -667,7 +668,7 @@ static struct i2c_driver jet_sensors_driver =
 
 static int __init jet_sensors_init(void)
 {
-	int res=i2c_add_driver(&jet_sensors_driver);
+	int res=jet_i2c_add_driver(&jet_sensors_driver);
 	pr_info("%s: Probe name %s\n", __func__, DRIVER_NAME);
 	if(res)
 		printk(KERN_ERR "%s failed\n", __func__);
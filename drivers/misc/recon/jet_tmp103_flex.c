@@ -2,6 +2,7 @@
 #include <linux/fs.h>
 #include <linux/slab.h>
 #include "jet_tmp103_flex.h"
+#include "jet_async_probe.h"
 
 #define DRIVER_NAME				"tmpflex_103"
 #define I2C_CHIP_ADDRESS		0x70
@@ -12,6 +13,9 @@
 #define	TMP103_CONF_OS		0x01  //one shot
 #define	TMP103_CONF_MODE_MASK		0x03
 
+/* conversions older than this are not reported to the thermal framework */
+#define TMP103_THERMAL_MAX_AGE		(10 * HZ)
+
 #if defined SENSOR_DEBUG_VERBOSE
 struct tmp103_data *jet_temp_ptr;
 #endif
@@ -57,6 +61,12 @@ int tmp103_get_data(struct tmp103_data *jet_temp, u8 *sensor_data_ptr, unsigned
 	//Swap byte
 	*sensor_data_ptr=0;//Pad one byte
 	*(sensor_data_ptr+1)=buffer[0];
+#ifdef CONFIG_THERMAL_FRAMEWORK
+	/* the conversions are paced by the sensor mux, keep the last one */
+	jet_temp->temp = (s8)buffer[0] * 1000;
+	jet_temp->temp_stamp = jiffies;
+	jet_temp->temp_valid = true;
+#endif
 	//Conversion: (*(short*)sensor_data_ptr)/256 to get degree celsius
 
 	//Start single conversion. Need 30ms to get sensor conversion done
@@ -98,6 +108,26 @@ int jet_tmp103_get_data
 }
 #endif
 
+#ifdef CONFIG_THERMAL_FRAMEWORK
+static int tmp103_report_temp(struct thermal_dev *tdev)
+{
+	struct tmp103_data *tmp103 = container_of(tdev, struct tmp103_data,
+						  therm_fw);
+
+	if (!tmp103->temp_valid ||
+	    time_after(jiffies, tmp103->temp_stamp + TMP103_THERMAL_MAX_AGE))
+		return -ENODATA;
+
+	tdev->current_temp = tmp103->temp;
+
+	return tdev->current_temp;
+}
+
+static struct thermal_dev_ops tmp103_thermal_ops = {
+	.report_temp = tmp103_report_temp,
+};
+#endif
+
 static int tmp103_probe(struct i2c_client *client,
 						   const struct i2c_device_id *id)
 {
@@ -136,6 +166,13 @@ static int tmp103_probe(struct i2c_client *client,
 		printk(KERN_ERR "couldn't init temperature\n");
 		return -ENOSYS;
 	}
+#endif
+#ifdef CONFIG_THERMAL_FRAMEWORK
+	tmp103->therm_fw.name = DRIVER_NAME;
+	tmp103->therm_fw.domain_name = "flex";
+	tmp103->therm_fw.dev = &client->dev;
+	tmp103->therm_fw.dev_ops = &tmp103_thermal_ops;
+	thermal_sensor_dev_register(&tmp103->therm_fw);
 #endif
 	return 0;
 }
@@ -144,6 +181,9 @@ static int __devexit tmp103_remove(struct i2c_client *client)
 {
 	struct tmp103_data *tmp103 = i2c_get_clientdata(client);
 	printk("%s\n", __func__);
+#ifdef CONFIG_THERMAL_FRAMEWORK
+	thermal_sensor_dev_unregister(&tmp103->therm_fw);
+#endif
 	kfree(tmp103);
 	return 0;
 }
@@ -171,7 +211,7 @@ static struct i2c_driver tmp103_driver =
 
 static int __init tmp103_init(void)
 {
-	int res=i2c_add_driver(&tmp103_driver);
+	int res=jet_i2c_add_driver(&tmp103_driver);
 	if(res)
 		printk(KERN_ERR "%s failed\n", __func__);
 	return res;
@@ -1,11 +1,18 @@
 #ifndef __JET_tmp103_FLEX_H__
 #define __JET_tmp103_FLEX_H__
+#include <linux/thermal_framework.h>
 #include "jet_sensors.h"
 
 #define TMP_ONEEVENT_SIZE 2
 struct tmp103_data
 {
 	struct i2c_client *client;
+#ifdef CONFIG_THERMAL_FRAMEWORK
+	struct thermal_dev therm_fw;
+	int temp;			/* last conversion, milli-celsius */
+	unsigned long temp_stamp;	/* jiffies of the last conversion */
+	bool temp_valid;
+#endif
 };
 
 #if defined SENSOR_DEBUG_VERBOSE
@@ -16,6 +16,7 @@
 #include <linux/miscdevice.h>
 
 #include "i2c_transfer.h"
+#include "jet_async_probe.h"
 
 //#define MFI_DEBUG
 
@@ -216,7 +217,7 @@ static struct i2c_driver mfi_driver =
 
 static int __init mfi_init(void)
 {
-	int res=i2c_add_driver(&mfi_driver);
+	int res=jet_i2c_add_driver(&mfi_driver);
 	pr_info("%s: Probe name %s\n", __func__, DRIVER_NAME);
 	if(res)
 		printk(KERN_ERR "%s failed\n", __func__);
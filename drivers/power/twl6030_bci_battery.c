@@ -30,6 +30,7 @@
 #endif
 #include <linux/wakelock.h>
 #include <linux/usb/otg.h>
+#include <linux/thermal_framework.h>
 #ifdef CONFIG_MACH_OMAP4_JET
 #include <plat/usb.h>
 #ifndef CONFIG_FUEL_GAUGE
@@ -355,6 +356,14 @@ struct twl6030_bci_device_info {
 	int			current_max_scale;
 
 	unsigned int		min_vbus_val;
+#ifdef CONFIG_THERMAL_FRAMEWORK
+	struct thermal_dev	battery_sensor;
+	struct thermal_dev	charger_cooling;
+	/* 0..1000 share of the charge current range shed for skin cooling */
+	int			charger_throttle;
+	/* level last requested by the thermal layer, applied by monitor */
+	int			charger_throttle_req;
+#endif
 };
 #if !defined(CONFIG_FUEL_GAUGE) && !defined(CONFIG_MACH_OMAP4_JET)
 /* Battery capacity estimation table */
@@ -481,6 +490,15 @@ static void twl6030_config_vichrg_reg(struct twl6030_bci_device_info *di,
 {
 	int ret;
 
+#ifdef CONFIG_THERMAL_FRAMEWORK
+	/* Shed the requested share of the range above the 300mA minimum */
+	if (di->charger_throttle && currentmA > 300 && currentmA <= 1500) {
+		currentmA -= (currentmA - 300) * di->charger_throttle / 1000;
+		if (currentmA > 450 && currentmA < 500)
+			currentmA = 450;
+	}
+#endif
+
 	if ((currentmA >= 300) && (currentmA <= 450))
 		currentmA = (currentmA - 300) / 50;
 	else if ((currentmA >= 500) && (currentmA <= 1500))
@@ -496,6 +514,25 @@ static void twl6030_config_vichrg_reg(struct twl6030_bci_device_info *di,
 		pr_err("%s: Error access to TWL6030 (%d)\n", __func__, ret);
 }
 
+#ifdef CONFIG_THERMAL_FRAMEWORK
+/* Called from the monitor work, which owns the charger programming */
+static void twl6030_apply_charger_throttle(struct twl6030_bci_device_info *di)
+{
+	int level = ACCESS_ONCE(di->charger_throttle_req);
+
+	if (level == di->charger_throttle)
+		return;
+
+	di->charger_throttle = level;
+	twl6030_config_vichrg_reg(di, di->charger_outcurrentmA);
+}
+#else
+static inline void
+twl6030_apply_charger_throttle(struct twl6030_bci_device_info *di)
+{
+}
+#endif
+
 static void twl6030_config_cinlimit_reg(struct twl6030_bci_device_info *di,
 							unsigned int currentmA)
 {
@@ -2086,6 +2123,8 @@ static void twl6030_bci_battery_work(struct work_struct *work)
 	if (di->charge_status == POWER_SUPPLY_STATUS_CHARGING)
 		twl6030_set_watchdog(di, di->watchdog_duration);
 
+	twl6030_apply_charger_throttle(di);
+
 	req.method = TWL6030_GPADC_SW2;
 	req.channels = (1 << 1) | (1 << di->gpadc_vbat_chnl) | (1 << 8);
 
@@ -3066,6 +3105,70 @@ err:
 	pr_err("%s: Error access to TWL6030 (%d)\n", __func__, ret);
 }
 #endif
+#ifdef CONFIG_THERMAL_FRAMEWORK
+static int twl6030_battery_report_temp(struct thermal_dev *tdev)
+{
+	struct twl6030_bci_device_info *di = container_of(tdev,
+			struct twl6030_bci_device_info, battery_sensor);
+
+	/* temp_C is in tenths of degree */
+	tdev->current_temp = di->temp_C * 100;
+
+	return tdev->current_temp;
+}
+
+static int twl6030_charger_cool_device(struct thermal_dev *tdev, int level)
+{
+	struct twl6030_bci_device_info *di = container_of(tdev,
+			struct twl6030_bci_device_info, charger_cooling);
+
+	level = clamp(level, 0, 1000);
+	if (level == di->charger_throttle_req)
+		return 0;
+
+	/* VICHRG is reprogrammed by the monitor work, not from here */
+	di->charger_throttle_req = level;
+	cancel_delayed_work(&di->twl6030_bci_monitor_work);
+	schedule_delayed_work(&di->twl6030_bci_monitor_work, 0);
+
+	return 0;
+}
+
+static struct thermal_dev_ops twl6030_battery_sensor_ops = {
+	.report_temp = twl6030_battery_report_temp,
+};
+
+static struct thermal_dev_ops twl6030_charger_cooling_ops = {
+	.cool_device = twl6030_charger_cool_device,
+};
+
+static void twl6030_bci_thermal_register(struct twl6030_bci_device_info *di)
+{
+	di->battery_sensor.name = "twl6030_battery_sensor";
+	di->battery_sensor.domain_name = "battery";
+	di->battery_sensor.dev = di->dev;
+	di->battery_sensor.dev_ops = &twl6030_battery_sensor_ops;
+	thermal_sensor_dev_register(&di->battery_sensor);
+
+	di->charger_cooling.name = "charger_cooling";
+	di->charger_cooling.domain_name = "skin";
+	di->charger_cooling.dev = di->dev;
+	di->charger_cooling.dev_ops = &twl6030_charger_cooling_ops;
+	thermal_cooling_dev_register(&di->charger_cooling);
+}
+
+static void twl6030_bci_thermal_unregister(struct twl6030_bci_device_info *di)
+{
+	thermal_cooling_dev_unregister(&di->charger_cooling);
+	thermal_sensor_dev_unregister(&di->battery_sensor);
+}
+#else
+static inline void
+twl6030_bci_thermal_register(struct twl6030_bci_device_info *di) { }
+static inline void
+twl6030_bci_thermal_unregister(struct twl6030_bci_device_info *di) { }
+#endif
+
 static int __devinit twl6030_bci_battery_probe(struct platform_device *pdev)
 {
 	struct twl4030_bci_platform_data *pdata = pdev->dev.platform_data;
@@ -3483,6 +3586,7 @@ static int __devinit twl6030_bci_battery_probe(struct platform_device *pdev)
 	ret = sysfs_create_group(&pdev->dev.kobj, &twl6030_bci_attr_group);
 	if (ret)
 		dev_err(&pdev->dev, "could not create sysfs files\n");
+	twl6030_bci_thermal_register(di);
 #ifdef CONFIG_MACH_OMAP4_JET
 	schedule_delayed_work(&di->twl6030_bci_monitor_work, msecs_to_jiffies(5000));//delay 5 second
 	schedule_delayed_work(&di->twl6030_current_avg_work, msecs_to_jiffies(5000));
@@ -3534,6 +3638,7 @@ static int __devexit twl6030_bci_battery_remove(struct platform_device *pdev)
 	free_irq(irq, di);
 
 	otg_unregister_notifier(di->otg, &di->nb);
+	twl6030_bci_thermal_unregister(di);
 	sysfs_remove_group(&pdev->dev.kobj, &twl6030_bci_attr_group);
 	cancel_delayed_work(&di->twl6030_bci_monitor_work);
 	cancel_delayed_work(&di->twl6030_current_avg_work);
@@ -39,6 +39,11 @@
 #include <linux/uaccess.h>
 #include <linux/elf.h>
 #include <linux/elfcore.h>
+#include <linux/vmalloc.h>
+#include <linux/suspend.h>
+#include <linux/seq_file.h>
+#include <linux/poll.h>
+#include <linux/crc32.h>
 #include <plat/remoteproc.h>
 
 /* list of available remote processors on this board */
@@ -48,6 +53,14 @@ static DEFINE_SPINLOCK(rprocs_lock);
 /* debugfs parent dir */
 static struct dentry *rproc_dbg;
 
+/*
+ * fallback polling period of the trace buffers while a streaming reader is
+ * open, for firmware which does not send RP_MBOX_TRACE_UPDATE. 0 disables.
+ */
+static unsigned int trace_poll_ms = 1000;
+module_param(trace_poll_ms, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(trace_poll_ms, "trace buffer poll period for streaming readers");
+
 static ssize_t rproc_format_trace_buf(char __user *userbuf, size_t count,
 				    loff_t *ppos, const void *src, int size)
 {
@@ -507,6 +520,46 @@ static const struct file_operations rproc_version_ops = {
 	.llseek	= generic_file_llseek,
 };
 
+static inline u32 rproc_boot_us(struct rproc *rproc, ktime_t *since)
+{
+	ktime_t now = ktime_get();
+	u32 us = ktime_to_us(ktime_sub(now, *since));
+
+	*since = now;
+	return us;
+}
+
+static int rproc_boot_stats_show(struct seq_file *s, void *unused)
+{
+	struct rproc *rproc = s->private;
+	struct rproc_boot_stats *st = &rproc->boot_stats;
+
+	seq_printf(s, "cold boots:   %u\n", st->cold_boots);
+	seq_printf(s, "cached boots: %u\n", st->cached_boots);
+	seq_printf(s, "last boot:\n");
+	seq_printf(s, "  firmware:   %u us\n", st->fw_us);
+	seq_printf(s, "  load:       %u us\n", st->load_us);
+	seq_printf(s, "  start:      %u us\n", st->start_us);
+	seq_printf(s, "  total:      %u us\n", st->total_us);
+	seq_printf(s, "  copied:     %u bytes\n", st->copied);
+	seq_printf(s, "  skipped:    %u bytes\n", st->skipped);
+	seq_printf(s, "corrupted text: %u\n", st->corrupted);
+
+	return 0;
+}
+
+static int rproc_boot_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, rproc_boot_stats_show, inode->i_private);
+}
+
+static const struct file_operations rproc_boot_stats_ops = {
+	.open = rproc_boot_stats_open,
+	.read = seq_read,
+	.llseek	= seq_lseek,
+	.release = single_release,
+};
+
 DEBUGFS_READONLY_FILE(trace0, rproc->trace_buf0, rproc->trace_len0);
 DEBUGFS_READONLY_FILE(trace1, rproc->trace_buf1, rproc->trace_len1);
 DEBUGFS_READONLY_FILE(trace0_last, rproc->last_trace_buf0,
@@ -520,6 +573,272 @@ DEBUGFS_READONLY_FILE(cdump1, rproc->cdump_buf1, rproc->cdump_len1);
 	debugfs_create_file(#name, 0444, rproc->dbg_dir,		\
 			rproc, &name## _rproc_ops)
 
+/*
+ * Streaming trace readers. Each open file keeps its own position in the
+ * remote's circular trace buffer and only ever returns bytes written after
+ * it, so a log collector can block in read() or poll() instead of rereading
+ * the whole buffer. The remote cannot tell us when it laps a slow reader, so
+ * such a reader silently loses the overwritten data.
+ */
+struct rproc_trace_reader {
+	struct rproc *rproc;
+	int id;
+	int pos;
+	int gen;
+	int seq;
+	char *bounce;
+};
+
+/* copy_to_user must not run under rproc->lock, stage through a page */
+#define RPROC_TRACE_BOUNCE	PAGE_SIZE
+
+/* must be called with rproc->lock held */
+static int rproc_trace_get(struct rproc *rproc, int id, char **buf, int *size)
+{
+	*buf = id ? rproc->trace_buf1 : rproc->trace_buf0;
+	*size = id ? rproc->trace_len1 : rproc->trace_len0;
+
+	if (!*buf || *size < 2 * sizeof(u32))
+		return -ENODEV;
+
+	/* the write index is the penultimate word of the buffer */
+	*size -= sizeof(u32) * 2;
+	return 0;
+}
+
+static int rproc_trace_widx(char *buf, int size)
+{
+	int w_pos = *(int *)(buf + size);
+
+	return (w_pos < 0 || w_pos >= size) ? 0 : w_pos;
+}
+
+/*
+ * Bring the reader in sync with the buffer and return the write index,
+ * or -ENODEV if there is no buffer. Must be called with rproc->lock held.
+ */
+static int rproc_trace_sync(struct rproc_trace_reader *r, char **buf,
+								int *size)
+{
+	struct rproc *rproc = r->rproc;
+	int gen = atomic_read(&rproc->trace_gen);
+
+	if (rproc_trace_get(rproc, r->id, buf, size))
+		return -ENODEV;
+
+	/* the remote was restarted, its buffer starts over */
+	if (r->gen != gen) {
+		r->gen = gen;
+		r->pos = 0;
+	}
+	if (r->pos >= *size)
+		r->pos = 0;
+
+	return rproc_trace_widx(*buf, *size);
+}
+
+/*
+ * Stage the next chunk of unread trace into r->bounce. Must be called
+ * with rproc->lock held; returns the number of bytes staged.
+ */
+static int rproc_trace_copy(struct rproc_trace_reader *r, size_t count)
+{
+	struct rproc *rproc = r->rproc;
+	int seq = atomic_read(&rproc->trace_seq);
+	char *buf;
+	int size, w_pos, len;
+
+	w_pos = rproc_trace_sync(r, &buf, &size);
+	if (w_pos < 0 || w_pos == r->pos) {
+		/* drained: only a later notification can bring more */
+		r->seq = seq;
+		return 0;
+	}
+
+	len = (w_pos > r->pos ? w_pos : size) - r->pos;
+	len = min_t(size_t, len, min_t(size_t, count, RPROC_TRACE_BOUNCE));
+	memcpy(r->bounce, buf + r->pos, len);
+
+	r->pos += len;
+	if (r->pos == size)
+		r->pos = 0;
+	if (r->pos == w_pos)
+		r->seq = seq;
+
+	return len;
+}
+
+static void rproc_trace_poll_work(struct work_struct *work)
+{
+	struct rproc *rproc = container_of(to_delayed_work(work), struct rproc,
+							trace_poll_work);
+	bool changed = false;
+	char *buf;
+	int id, size, w_pos;
+
+	mutex_lock(&rproc->lock);
+	for (id = 0; id < 2; id++) {
+		if (rproc_trace_get(rproc, id, &buf, &size))
+			continue;
+		w_pos = rproc_trace_widx(buf, size);
+		if (w_pos != rproc->trace_last_w[id]) {
+			rproc->trace_last_w[id] = w_pos;
+			changed = true;
+		}
+	}
+
+	if (rproc->trace_readers && trace_poll_ms)
+		schedule_delayed_work(&rproc->trace_poll_work,
+					msecs_to_jiffies(trace_poll_ms));
+	mutex_unlock(&rproc->lock);
+
+	if (changed)
+		rproc_trace_notify(rproc);
+}
+
+/**
+ * rproc_trace_notify - wake up streaming trace readers
+ * @rproc: the remote processor whose trace buffers were written
+ *
+ * Called when the remote processor signals (RP_MBOX_TRACE_UPDATE) that it
+ * has written to its trace buffers. Safe to call from any context.
+ */
+void rproc_trace_notify(struct rproc *rproc)
+{
+	atomic_inc(&rproc->trace_seq);
+	wake_up_interruptible(&rproc->trace_wq);
+}
+EXPORT_SYMBOL(rproc_trace_notify);
+
+static int rproc_trace_stream_open(struct inode *inode, struct file *filp,
+									int id)
+{
+	struct rproc *rproc = inode->i_private;
+	struct rproc_trace_reader *r;
+	char *buf;
+	int size;
+
+	r = kzalloc(sizeof(*r), GFP_KERNEL);
+	if (!r)
+		return -ENOMEM;
+
+	r->bounce = kmalloc(RPROC_TRACE_BOUNCE, GFP_KERNEL);
+	if (!r->bounce) {
+		kfree(r);
+		return -ENOMEM;
+	}
+
+	r->rproc = rproc;
+	r->id = id;
+
+	mutex_lock(&rproc->lock);
+	/* only stream what is written after the open */
+	r->gen = atomic_read(&rproc->trace_gen);
+	if (!rproc_trace_get(rproc, id, &buf, &size))
+		r->pos = rproc_trace_widx(buf, size);
+	r->seq = atomic_read(&rproc->trace_seq);
+
+	if (!rproc->trace_readers++ && trace_poll_ms)
+		schedule_delayed_work(&rproc->trace_poll_work,
+					msecs_to_jiffies(trace_poll_ms));
+	mutex_unlock(&rproc->lock);
+
+	filp->private_data = r;
+	return nonseekable_open(inode, filp);
+}
+
+static int trace0_stream_open(struct inode *inode, struct file *filp)
+{
+	return rproc_trace_stream_open(inode, filp, 0);
+}
+
+static int trace1_stream_open(struct inode *inode, struct file *filp)
+{
+	return rproc_trace_stream_open(inode, filp, 1);
+}
+
+static int rproc_trace_stream_release(struct inode *inode, struct file *filp)
+{
+	struct rproc_trace_reader *r = filp->private_data;
+	struct rproc *rproc = r->rproc;
+
+	/* a poll already running won't requeue itself without readers */
+	mutex_lock(&rproc->lock);
+	if (!--rproc->trace_readers)
+		cancel_delayed_work(&rproc->trace_poll_work);
+	mutex_unlock(&rproc->lock);
+
+	kfree(r->bounce);
+	kfree(r);
+	return 0;
+}
+
+static ssize_t rproc_trace_stream_read(struct file *filp,
+		char __user *userbuf, size_t count, loff_t *ppos)
+{
+	struct rproc_trace_reader *r = filp->private_data;
+	struct rproc *rproc = r->rproc;
+	ssize_t ret;
+
+	if (!count)
+		return 0;
+
+	for (;;) {
+		if (mutex_lock_interruptible(&rproc->lock))
+			return -EINTR;
+		ret = rproc_trace_copy(r, count);
+		mutex_unlock(&rproc->lock);
+
+		if (ret)
+			return copy_to_user(userbuf, r->bounce, ret) ?
+								-EFAULT : ret;
+
+		if (filp->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+
+		if (wait_event_interruptible(rproc->trace_wq,
+				atomic_read(&rproc->trace_seq) != r->seq))
+			return -ERESTARTSYS;
+	}
+}
+
+static unsigned int rproc_trace_stream_poll(struct file *filp,
+						poll_table *wait)
+{
+	struct rproc_trace_reader *r = filp->private_data;
+	struct rproc *rproc = r->rproc;
+	unsigned int mask = 0;
+	char *buf;
+	int size, w_pos;
+
+	poll_wait(filp, &rproc->trace_wq, wait);
+
+	/* ready is decided by unread data, not by notifications */
+	mutex_lock(&rproc->lock);
+	w_pos = rproc_trace_sync(r, &buf, &size);
+	if (w_pos >= 0 && w_pos != r->pos)
+		mask = POLLIN | POLLRDNORM;
+	mutex_unlock(&rproc->lock);
+
+	return mask;
+}
+
+static const struct file_operations trace0_stream_rproc_ops = {
+	.open = trace0_stream_open,
+	.release = rproc_trace_stream_release,
+	.read = rproc_trace_stream_read,
+	.poll = rproc_trace_stream_poll,
+	.llseek	= no_llseek,
+};
+
+static const struct file_operations trace1_stream_rproc_ops = {
+	.open = trace1_stream_open,
+	.release = rproc_trace_stream_release,
+	.read = rproc_trace_stream_read,
+	.poll = rproc_trace_stream_poll,
+	.llseek	= no_llseek,
+};
+
 /**
  * __find_rproc_by_name - find a registered remote processor by name
  * @name: name of the remote processor
@@ -615,6 +934,11 @@ static int rproc_crash(struct rproc *rproc)
 	if (rproc->trace_buf1 && rproc->last_trace_buf1)
 		memcpy(rproc->last_trace_buf1, rproc->trace_buf1,
 				rproc->last_trace_len1);
+#ifdef CONFIG_REMOTEPROC_FW_CACHE
+	/* the crashed image may have scribbled over its own text */
+	if (rproc->fw_cache)
+		rproc->fw_cache->resident = false;
+#endif
 	rproc->state = RPROC_CRASHED;
 
 	return 0;
@@ -703,6 +1027,10 @@ static void rproc_start(struct rproc *rproc, u64 bootaddr)
 
 	rproc->state = RPROC_RUNNING;
 
+	rproc->boot_stats.start_us = rproc_boot_us(rproc, &rproc->boot_start);
+	rproc->boot_stats.total_us = rproc->boot_stats.fw_us +
+			rproc->boot_stats.load_us + rproc->boot_stats.start_us;
+
 	dev_info(dev, "remote processor %s is now up\n", rproc->name);
 	rproc->secure_ok = true;
 	complete_all(&rproc->secure_restart);
@@ -984,6 +1312,11 @@ static int rproc_handle_resources(struct rproc *rproc, struct fw_resource *rsc,
 		}
 	}
 
+	if (trace_da0 || trace_da1) {
+		atomic_inc(&rproc->trace_gen);
+		rproc_trace_notify(rproc);
+	}
+
 	/*
 	 * post-process crash-dump buffers, as we cannot rely on the order of
 	 * the crash-dump section and the carveout sections.
@@ -1031,6 +1364,27 @@ error:
 	return ret;
 }
 
+static int rproc_copy_section(struct rproc *rproc, phys_addr_t pa,
+					const void *content, u32 len)
+{
+	void *ptr;
+
+	/* ioremaping normal memory, so make sparse happy */
+	ptr = (__force void *) ioremap_nocache(pa, len);
+	if (!ptr) {
+		dev_err(rproc->dev, "can't ioremap 0x%x\n", pa);
+		return -ENOMEM;
+	}
+
+	memcpy(ptr, content, len);
+
+	/* iounmap normal memory, so make sparse happy */
+	iounmap((__force void __iomem *) ptr);
+
+	rproc->boot_stats.copied += len;
+	return 0;
+}
+
 static int rproc_process_fw(struct rproc *rproc, struct fw_section *section,
 						int left, u64 *bootaddr)
 {
@@ -1039,7 +1393,6 @@ static int rproc_process_fw(struct rproc *rproc, struct fw_section *section,
 	u32 len, type;
 	u64 da;
 	int ret = 0;
-	void *ptr;
 	bool copy;
 
 	/* first section should be FW_RESOURCE section */
@@ -1091,18 +1444,10 @@ static int rproc_process_fw(struct rproc *rproc, struct fw_section *section,
 		dev_dbg(dev, "da 0x%llx pa 0x%x len 0x%x\n", da, pa, len);
 
 		if (copy) {
-			/* ioremaping normal memory, so make sparse happy */
-			ptr = (__force void *) ioremap_nocache(pa, len);
-			if (!ptr) {
-				dev_err(dev, "can't ioremap 0x%x\n", pa);
-				ret = -ENOMEM;
+			ret = rproc_copy_section(rproc, pa, section->content,
+									len);
+			if (ret)
 				break;
-			}
-
-			memcpy(ptr, section->content, len);
-
-			/* iounmap normal memory, so make sparse happy */
-			iounmap((__force void __iomem *) ptr);
 		}
 
 		section = (struct fw_section *)(section->content + len);
@@ -1113,6 +1458,323 @@ exit:
 	return ret;
 }
 
+#ifdef CONFIG_REMOTEPROC_FW_CACHE
+static void rproc_fw_cache_free(struct rproc *rproc)
+{
+	struct rproc_fw_cache *cache = rproc->fw_cache;
+
+	if (!cache)
+		return;
+
+	vfree(cache->data);
+	kfree(cache->segs);
+	kfree(cache->rsc);
+	kfree(cache->header);
+	kfree(cache);
+	rproc->fw_cache = NULL;
+}
+
+/*
+ * Resident text is spot checked rather than checksummed in full: the
+ * first RPROC_FW_CRC_CHUNK bytes of every RPROC_FW_CRC_STRIDE, so the
+ * uncached read-back stays a small fraction of the copy it replaces.
+ */
+#define RPROC_FW_CRC_STRIDE	(64 * 1024)
+#define RPROC_FW_CRC_CHUNK	(4 * 1024)
+
+static u32 rproc_fw_crc(const void *p, u32 len)
+{
+	u32 crc = ~0, off;
+
+	for (off = 0; off < len; off += RPROC_FW_CRC_STRIDE)
+		crc = crc32_le(crc, p + off, min_t(u32, len - off,
+							RPROC_FW_CRC_CHUNK));
+
+	return crc;
+}
+
+/*
+ * Keep a compact copy of the loadable parts of the image: the header, a
+ * pristine resource table (rproc_handle_resources patches the carveout
+ * addresses in place) and the text/data payloads. This must run before
+ * the image is processed. Secure images are never cached, their layout
+ * is owned by the secure loader.
+ */
+static void rproc_fw_cache_build(struct rproc *rproc, struct fw_header *image,
+					struct fw_section *section, int left)
+{
+	struct rproc_fw_cache *cache;
+	struct fw_section *sec;
+	int n = 0, i = 0, remain;
+	u32 size = 0;
+	void *p;
+
+	rproc_fw_cache_free(rproc);
+
+	if (rproc->secure_mode || section->type != FW_RESOURCE)
+		return;
+
+	/* size the cache, bailing out on anything rproc_process_fw rejects */
+	for (sec = section, remain = left; remain > sizeof(*sec);) {
+		remain -= sizeof(*sec);
+		if (remain < sec->len)
+			return;
+		if (sec->type == FW_TEXT || sec->type == FW_DATA) {
+			size += sec->len;
+			n++;
+		}
+		remain -= sec->len;
+		sec = (struct fw_section *)(sec->content + sec->len);
+	}
+
+	cache = kzalloc(sizeof(*cache), GFP_KERNEL);
+	if (!cache)
+		return;
+
+	cache->header = kmemdup(image->header, image->header_len, GFP_KERNEL);
+	cache->rsc = kmemdup(section->content, section->len, GFP_KERNEL);
+	cache->segs = kcalloc(n, sizeof(*cache->segs), GFP_KERNEL);
+	cache->data = vmalloc(size);
+	rproc->fw_cache = cache;
+	if (!cache->header || !cache->rsc || !cache->segs || !cache->data) {
+		dev_warn(rproc->dev, "no memory to cache the image\n");
+		rproc_fw_cache_free(rproc);
+		return;
+	}
+
+	cache->header_len = image->header_len;
+	cache->rsc_da = section->da;
+	cache->rsc_len = section->len;
+	cache->num_segs = n;
+
+	for (sec = section, remain = left, p = cache->data;
+					remain > sizeof(*sec); ) {
+		remain -= sizeof(*sec) + sec->len;
+		if (sec->type == FW_TEXT || sec->type == FW_DATA) {
+			cache->segs[i].type = sec->type;
+			cache->segs[i].da = sec->da;
+			cache->segs[i].len = sec->len;
+			cache->segs[i].content = p;
+			memcpy(p, sec->content, sec->len);
+			cache->segs[i].crc = rproc_fw_crc(p, sec->len);
+			p += sec->len;
+			i++;
+		}
+		sec = (struct fw_section *)(sec->content + sec->len);
+	}
+
+	dev_info(rproc->dev, "cached %u bytes of %s\n", size, rproc->firmware);
+}
+
+/* remember where the text went, so the next boot can leave it in place */
+static void rproc_fw_cache_commit(struct rproc *rproc)
+{
+	struct rproc_fw_cache *cache = rproc->fw_cache;
+	int i;
+
+	if (!cache)
+		return;
+
+	for (i = 0; i < cache->num_segs; i++)
+		if (rproc_da_to_pa(rproc, cache->segs[i].da,
+						&cache->segs[i].pa))
+			break;
+
+	cache->resident = i == cache->num_segs;
+}
+
+/* check that resident text still matches what was copied there */
+static bool rproc_fw_seg_intact(struct rproc *rproc,
+					struct rproc_fw_segment *seg)
+{
+	void *ptr;
+	u32 crc;
+
+	/* ioremaping normal memory, so make sparse happy */
+	ptr = (__force void *) ioremap_nocache(seg->pa, seg->len);
+	if (!ptr)
+		return false;
+
+	crc = rproc_fw_crc(ptr, seg->len);
+
+	iounmap((__force void __iomem *) ptr);
+
+	if (crc != seg->crc) {
+		dev_warn(rproc->dev, "text at 0x%x modified, reloading\n",
+								seg->pa);
+		rproc->boot_stats.corrupted++;
+		return false;
+	}
+
+	return true;
+}
+
+static int rproc_fw_cache_load(struct rproc *rproc, u64 *bootaddr)
+{
+	struct rproc_fw_cache *cache = rproc->fw_cache;
+	struct rproc_fw_segment *seg;
+	struct device *dev = rproc->dev;
+	void *rsc;
+	phys_addr_t pa;
+	int i, ret;
+
+	rproc->header = kmemdup(cache->header, cache->header_len, GFP_KERNEL);
+	rsc = kmemdup(cache->rsc, cache->rsc_len, GFP_KERNEL);
+	if (!rproc->header || !rsc) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	rproc->header_len = cache->header_len;
+
+	ret = rproc_handle_resources(rproc, rsc, cache->rsc_len, bootaddr);
+	if (ret)
+		goto out;
+
+	/* the remote side reads back the patched resource table */
+	ret = rproc_da_to_pa(rproc, cache->rsc_da, &pa);
+	if (!ret)
+		ret = rproc_copy_section(rproc, pa, rsc, cache->rsc_len);
+	if (ret)
+		goto out;
+
+	for (i = 0, seg = cache->segs; i < cache->num_segs; i++, seg++) {
+		ret = rproc_da_to_pa(rproc, seg->da, &pa);
+		if (ret) {
+			dev_err(dev, "rproc_da_to_pa failed:%d\n", ret);
+			break;
+		}
+
+		/* data is rewritten by the remote, text is left alone */
+		if (seg->type == FW_TEXT && cache->resident && seg->pa == pa &&
+					rproc_fw_seg_intact(rproc, seg)) {
+			rproc->boot_stats.skipped += seg->len;
+			continue;
+		}
+
+		ret = rproc_copy_section(rproc, pa, seg->content, seg->len);
+		if (ret)
+			break;
+		seg->pa = pa;
+	}
+
+	cache->resident = !ret;
+out:
+	kfree(rsc);
+	return ret;
+}
+
+static void rproc_fw_cache_boot(struct work_struct *work)
+{
+	struct rproc *rproc = container_of(work, struct rproc, fw_cache_work);
+	u64 bootaddr = 0;
+	int ret;
+
+	dev_info(rproc->dev, "starting %s from cached image\n", rproc->name);
+
+	rproc->boot_stats.cached_boots++;
+	rproc->boot_stats.fw_us = rproc_boot_us(rproc, &rproc->boot_start);
+
+	/* event currently used to bump the remoteproc to max freq
+	 * while booting.  */
+	_event_notify(rproc, RPROC_PRELOAD, NULL);
+
+	ret = rproc_fw_cache_load(rproc, &bootaddr);
+	rproc->boot_stats.load_us = rproc_boot_us(rproc, &rproc->boot_start);
+	if (ret) {
+		dev_err(rproc->dev, "Failed to load cached image: %d\n", ret);
+		rproc_fw_cache_free(rproc);
+	} else
+		rproc_start(rproc, bootaddr);
+
+	/* allow all contexts calling rproc_put() to proceed */
+	complete_all(&rproc->firmware_loading_complete);
+	if (ret)
+		_event_notify(rproc, RPROC_LOAD_ERROR, NULL);
+}
+
+static ssize_t rproc_fw_cache_read(struct file *filp, char __user *userbuf,
+						size_t count, loff_t *ppos)
+{
+	struct rproc *rproc = filp->private_data;
+	struct rproc_fw_cache *cache;
+	char buf[32];
+	int i;
+
+	mutex_lock(&rproc->lock);
+	cache = rproc->fw_cache;
+	i = scnprintf(buf, sizeof(buf), "%s\n", !cache ? "empty" :
+				cache->resident ? "resident" : "cached");
+	mutex_unlock(&rproc->lock);
+
+	return simple_read_from_buffer(userbuf, count, ppos, buf, i);
+}
+
+/* any write drops the cache, e.g. after the image has been updated */
+static ssize_t rproc_fw_cache_write(struct file *filp,
+		const char __user *userbuf, size_t count, loff_t *ppos)
+{
+	struct rproc *rproc = filp->private_data;
+	int ret = count;
+
+	mutex_lock(&rproc->lock);
+	if (rproc->state == RPROC_LOADING)
+		ret = -EBUSY;
+	else
+		rproc_fw_cache_free(rproc);
+	mutex_unlock(&rproc->lock);
+
+	return ret;
+}
+
+static const struct file_operations rproc_fw_cache_ops = {
+	.read = rproc_fw_cache_read,
+	.write = rproc_fw_cache_write,
+	.open = rproc_open_generic,
+	.llseek	= generic_file_llseek,
+};
+
+/*
+ * The carveouts are not part of the hibernation image, so whatever was
+ * left in them is gone once we come back.
+ */
+static int rproc_fw_cache_pm_notify(struct notifier_block *nb,
+					unsigned long event, void *unused)
+{
+	struct rproc *rproc;
+
+	if (event != PM_POST_HIBERNATION && event != PM_POST_RESTORE)
+		return NOTIFY_DONE;
+
+	spin_lock(&rprocs_lock);
+	list_for_each_entry(rproc, &rprocs, next)
+		if (rproc->fw_cache)
+			rproc->fw_cache->resident = false;
+	spin_unlock(&rprocs_lock);
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block rproc_fw_cache_pm_nb = {
+	.notifier_call = rproc_fw_cache_pm_notify,
+};
+
+static inline bool rproc_fw_cache_usable(struct rproc *rproc)
+{
+	return rproc->fw_cache && !rproc->secure_mode;
+}
+#else
+static inline void rproc_fw_cache_free(struct rproc *rproc) { }
+static inline void rproc_fw_cache_build(struct rproc *rproc,
+		struct fw_header *image, struct fw_section *section, int left)
+{
+}
+static inline void rproc_fw_cache_commit(struct rproc *rproc) { }
+static inline bool rproc_fw_cache_usable(struct rproc *rproc)
+{
+	return false;
+}
+#endif
+
 static void rproc_loader_cont(const struct firmware *fw, void *context)
 {
 	struct rproc *rproc = context;
@@ -1130,6 +1792,9 @@ static void rproc_loader_cont(const struct firmware *fw, void *context)
 
 	dev_info(dev, "Loaded BIOS image %s, size %d\n", fwfile, fw->size);
 
+	rproc->boot_stats.cold_boots++;
+	rproc->boot_stats.fw_us = rproc_boot_us(rproc, &rproc->boot_start);
+
 	/* make sure this image is sane */
 	if (fw->size < sizeof(struct fw_header)) {
 		dev_err(dev, "Image is too small\n");
@@ -1172,12 +1837,17 @@ static void rproc_loader_cont(const struct firmware *fw, void *context)
 	 * while booting.  */
 	_event_notify(rproc, RPROC_PRELOAD, NULL);
 
+	rproc_fw_cache_build(rproc, image, section, left);
+
 	ret = rproc_process_fw(rproc, section, left, &bootaddr);
+	rproc->boot_stats.load_us = rproc_boot_us(rproc, &rproc->boot_start);
 	if (ret) {
 		dev_err(dev, "Failed to process the image: %d\n", ret);
+		rproc_fw_cache_free(rproc);
 		goto out;
 	}
 
+	rproc_fw_cache_commit(rproc);
 	rproc_start(rproc, bootaddr);
 
 out:
@@ -1200,6 +1870,17 @@ static int rproc_loader(struct rproc *rproc)
 		return -EINVAL;
 	}
 
+	rproc->boot_start = ktime_get();
+	rproc->boot_stats.copied = 0;
+	rproc->boot_stats.skipped = 0;
+
+#ifdef CONFIG_REMOTEPROC_FW_CACHE
+	if (rproc_fw_cache_usable(rproc)) {
+		schedule_work(&rproc->fw_cache_work);
+		return 0;
+	}
+#endif
+
 	/*
 	 * allow building remoteproc as built-in kernel code, without
 	 * hanging the boot process
@@ -1263,6 +1944,11 @@ int rproc_set_secure(const char *name, bool enable)
 	rproc->secure_ttb = NULL;
 	rproc->secure_ok = false;
 	init_completion(&rproc->secure_restart);
+#ifdef CONFIG_REMOTEPROC_FW_CACHE
+	/* a secure load reuses the carveout for its own layout */
+	if (rproc->fw_cache)
+		rproc->fw_cache->resident = false;
+#endif
 
 	/*
 	 * restart the processor, the mode will dictate regular load or
@@ -1745,6 +2431,11 @@ int rproc_register(struct device *dev, const char *name,
 	mutex_init(&rproc->lock);
 	mutex_init(&rproc->secure_lock);
 	INIT_WORK(&rproc->error_work, rproc_error_work);
+	init_waitqueue_head(&rproc->trace_wq);
+	INIT_DELAYED_WORK(&rproc->trace_poll_work, rproc_trace_poll_work);
+#ifdef CONFIG_REMOTEPROC_FW_CACHE
+	INIT_WORK(&rproc->fw_cache_work, rproc_fw_cache_boot);
+#endif
 	BLOCKING_INIT_NOTIFIER_HEAD(&rproc->nbh);
 
 	rproc->state = RPROC_OFFLINE;
@@ -1782,6 +2473,14 @@ int rproc_register(struct device *dev, const char *name,
 
 	debugfs_create_file("name", 0444, rproc->dbg_dir, rproc,
 							&rproc_name_ops);
+	debugfs_create_file("boot_stats", 0444, rproc->dbg_dir, rproc,
+							&rproc_boot_stats_ops);
+	DEBUGFS_ADD(trace0_stream);
+	DEBUGFS_ADD(trace1_stream);
+#ifdef CONFIG_REMOTEPROC_FW_CACHE
+	debugfs_create_file("fw_cache", 0644, rproc->dbg_dir, rproc,
+							&rproc_fw_cache_ops);
+#endif
 
 out:
 	return 0;
@@ -1802,6 +2501,7 @@ int rproc_unregister(const char *name)
 
 	if (rproc->dbg_dir)
 		debugfs_remove_recursive(rproc->dbg_dir);
+	cancel_delayed_work_sync(&rproc->trace_poll_work);
 
 	spin_lock(&rprocs_lock);
 	list_del(&rproc->next);
@@ -1813,6 +2513,7 @@ int rproc_unregister(const char *name)
 	kfree(rproc->qos_request);
 	kfree(rproc->last_trace_buf0);
 	kfree(rproc->last_trace_buf1);
+	rproc_fw_cache_free(rproc);
 	kfree(rproc);
 
 	return 0;
@@ -1827,6 +2528,9 @@ static int __init remoteproc_init(void)
 			pr_err("can't create debugfs dir\n");
 	}
 
+#ifdef CONFIG_REMOTEPROC_FW_CACHE
+	register_pm_notifier(&rproc_fw_cache_pm_nb);
+#endif
 	return 0;
 }
 /* must be ready in time for device_initcall users */
@@ -1834,6 +2538,9 @@ subsys_initcall(remoteproc_init);
 
 static void __exit remoteproc_exit(void)
 {
+#ifdef CONFIG_REMOTEPROC_FW_CACHE
+	unregister_pm_notifier(&rproc_fw_cache_pm_nb);
+#endif
 	if (rproc_dbg)
 		debugfs_remove(rproc_dbg);
 }
@@ -19,7 +19,9 @@
 #include <linux/fdtable.h>
 #include <linux/file.h>
 #include <linux/fs.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
+#include <linux/math64.h>
 #include <linux/miscdevice.h>
 #include <linux/mm.h>
 #include <linux/module.h>
@@ -35,8 +37,9 @@
 #include <linux/vmalloc.h>
 
 #include "binder.h"
+#include "binder_trace.h"
 
-static DEFINE_MUTEX(binder_lock);
+static DEFINE_MUTEX(binder_main_lock);
 static DEFINE_MUTEX(binder_deferred_lock);
 
 static HLIST_HEAD(binder_procs);
@@ -105,6 +108,18 @@ module_param_named(debug_mask, binder_debug_mask, uint, S_IWUSR | S_IRUGO);
 static int binder_debug_no_lock;
 module_param_named(proc_no_lock, binder_debug_no_lock, bool, S_IWUSR | S_IRUGO);
 
+static int binder_latency_stats = 1;
+module_param_named(latency_stats, binder_latency_stats, bool,
+		   S_IWUSR | S_IRUGO);
+
+/*
+ * Number of freed buffer pages each proc keeps mapped for reuse, so that
+ * back-to-back transactions do not map and unmap the same pages. Warm
+ * pages are given back under memory pressure by binder_shrinker.
+ */
+static uint binder_warm_pages_max = 16;
+static atomic_t binder_warm_pages_total = ATOMIC_INIT(0);
+
 static DECLARE_WAIT_QUEUE_HEAD(binder_user_error_wait);
 static int binder_stop_on_user_error;
 
@@ -164,6 +179,119 @@ static inline void binder_stats_created(enum binder_stat_types type)
 	binder_stats.obj_created[type]++;
 }
 
+/*
+ * Latency statistics. Every phase of a transaction is timed into a log2
+ * histogram of microseconds, globally and per proc; nodes only keep a
+ * summary to stay small. All of it is updated under binder_lock, and
+ * costs a clock read per lock acquisition and per transaction phase.
+ */
+enum binder_latency_types {
+	BINDER_LAT_QUEUE,	/* enqueued -> picked up by the target */
+	BINDER_LAT_SERVICE,	/* picked up -> BC_REPLY */
+	BINDER_LAT_ROUND_TRIP,	/* BC_TRANSACTION -> BR_REPLY */
+	BINDER_LAT_ALLOC,	/* binder_alloc_buf */
+	BINDER_LAT_PROC_COUNT,
+	BINDER_LAT_LOCK_WAIT = BINDER_LAT_PROC_COUNT,
+	BINDER_LAT_LOCK_HOLD,
+	BINDER_LAT_COUNT
+};
+
+static const char * const binder_latency_names[] = {
+	"queue",
+	"service",
+	"round_trip",
+	"alloc",
+	"lock_wait",
+	"lock_hold",
+};
+
+/* bucket 0 is < 1us, bucket n is [2^(n-1), 2^n) us, the last one open */
+#define BINDER_LATENCY_BUCKETS		16
+
+struct binder_latency_sum {
+	u32 count;
+	u32 max_us;
+	u64 total_us;
+};
+
+struct binder_latency {
+	struct binder_latency_sum sum;
+	u32 hist[BINDER_LATENCY_BUCKETS];
+};
+
+static struct binder_latency binder_latency[BINDER_LAT_COUNT];
+static ktime_t binder_lock_time;
+
+static inline ktime_t binder_latency_stamp(void)
+{
+	return binder_latency_stats ? ktime_get() : ktime_set(0, 0);
+}
+
+static u32 binder_latency_us(ktime_t start, ktime_t end)
+{
+	s64 us;
+
+	if (!start.tv64 || !end.tv64)
+		return 0;
+	us = ktime_us_delta(end, start);
+	return us > (u32)~0 ? (u32)~0 : us;
+}
+
+static void binder_latency_sum_add(struct binder_latency_sum *sum, u32 us)
+{
+	sum->count++;
+	sum->total_us += us;
+	if (us > sum->max_us)
+		sum->max_us = us;
+}
+
+static void binder_latency_add(struct binder_latency *lat, u32 us)
+{
+	binder_latency_sum_add(&lat->sum, us);
+	lat->hist[us ? min(fls(us), BINDER_LATENCY_BUCKETS - 1) : 0]++;
+}
+
+static inline int binder_trylock(const char *tag)
+{
+	if (!mutex_trylock(&binder_main_lock))
+		return 0;
+	binder_lock_time = binder_latency_stamp();
+	if (binder_lock_time.tv64)
+		binder_latency_add(&binder_latency[BINDER_LAT_LOCK_WAIT], 0);
+	trace_binder_lock(tag);
+	trace_binder_locked(tag);
+	return 1;
+}
+
+static inline void binder_lock(const char *tag)
+{
+	ktime_t start;
+
+	if (binder_trylock(tag))
+		return;
+
+	trace_binder_lock(tag);
+	start = binder_latency_stamp();
+	mutex_lock(&binder_main_lock);
+	binder_lock_time = binder_latency_stamp();
+	if (start.tv64)
+		binder_latency_add(&binder_latency[BINDER_LAT_LOCK_WAIT],
+				   binder_latency_us(start, binder_lock_time));
+	trace_binder_locked(tag);
+}
+
+static inline void binder_unlock(const char *tag)
+{
+	trace_binder_unlock(tag);
+	if (binder_lock_time.tv64) {
+		binder_latency_add(&binder_latency[BINDER_LAT_LOCK_HOLD],
+			binder_latency_us(binder_lock_time,
+					  binder_latency_stamp()));
+		binder_lock_time.tv64 = 0;
+	}
+	mutex_unlock(&binder_main_lock);
+}
+
 struct binder_transaction_log_entry {
 	int debug_id;
 	int call_type;
@@ -222,6 +350,7 @@ struct binder_node {
 	int internal_strong_refs;
 	int local_weak_refs;
 	int local_strong_refs;
+	int tmp_refs;	/* pins the memory only, see binder_transaction */
 	void __user *ptr;
 	void __user *cookie;
 	unsigned has_strong_ref:1;
@@ -232,6 +361,8 @@ struct binder_node {
 	unsigned accept_fds:1;
 	unsigned min_priority:8;
 	struct list_head async_todo;
+	struct binder_latency_sum queue_latency;
+	struct binder_latency_sum service_latency;
 };
 
 struct binder_ref_death {
@@ -263,7 +394,8 @@ struct binder_buffer {
 	unsigned free:1;
 	unsigned allow_user_free:1;
 	unsigned async_transaction:1;
-	unsigned debug_id:29;
+	unsigned free_bucket:3; /* free_buffers[] tree of a free entry */
+	int debug_id;
 
 	struct binder_transaction *transaction;
 
@@ -273,6 +405,14 @@ struct binder_buffer {
 	uint8_t data[0];
 };
 
+/*
+ * Free buffers are kept in one size-sorted tree per power-of-two size
+ * class, starting below 128 bytes, so that the common small transactions
+ * search a small tree.
+ */
+#define BINDER_FREE_BUCKETS		8
+#define BINDER_FREE_BUCKET_SHIFT	7
+
 enum binder_deferred_state {
 	BINDER_DEFERRED_PUT_FILES    = 0x01,
 	BINDER_DEFERRED_FLUSH        = 0x02,
@@ -295,11 +435,13 @@ struct binder_proc {
 	ptrdiff_t user_buffer_offset;
 
 	struct list_head buffers;
-	struct rb_root free_buffers;
+	struct rb_root free_buffers[BINDER_FREE_BUCKETS];
 	struct rb_root allocated_buffers;
 	size_t free_async_space;
 
 	struct page **pages;
+	unsigned long *warm_map; /* mapped pages not used by any buffer */
+	int warm_pages;
 	size_t buffer_size;
 	uint32_t buffer_free;
 	struct list_head todo;
@@ -312,6 +454,14 @@ struct binder_proc {
 	int ready_threads;
 	long default_priority;
 	struct dentry *debugfs_entry;
+	struct binder_latency latency[BINDER_LAT_PROC_COUNT];
+	/*
+	 * Senders copying a payload into this proc's buffer space without
+	 * binder_lock hold a tmp_ref. A released proc is only freed once
+	 * the last of them is done (both protected by binder_lock).
+	 */
+	int tmp_ref;
+	bool is_dead;
 };
 
 enum {
@@ -355,10 +505,13 @@ struct binder_transaction {
 	long	priority;
 	long	saved_priority;
 	uid_t	sender_euid;
+	ktime_t	stamp;	/* enqueued, then picked up by the target */
+	ktime_t	start;	/* the call was sent, replies inherit it */
 };
 
 static void
 binder_defer_work(struct binder_proc *proc, enum binder_deferred_state defer);
+static void binder_proc_dec_tmpref(struct binder_proc *proc);
 
 /*
  * copied from get_unused_fd_flags
@@ -525,18 +678,28 @@ static size_t binder_buffer_size(struct binder_proc *proc,
 			struct binder_buffer, entry) - (size_t)buffer->data;
 }
 
+static int binder_free_bucket(size_t size)
+{
+	return min(fls(size >> BINDER_FREE_BUCKET_SHIFT),
+		   BINDER_FREE_BUCKETS - 1);
+}
+
 static void binder_insert_free_buffer(struct binder_proc *proc,
 				      struct binder_buffer *new_buffer)
 {
-	struct rb_node **p = &proc->free_buffers.rb_node;
+	struct rb_node **p;
 	struct rb_node *parent = NULL;
 	struct binder_buffer *buffer;
 	size_t buffer_size;
 	size_t new_buffer_size;
+	int bucket;
 
 	BUG_ON(!new_buffer->free);
 
 	new_buffer_size = binder_buffer_size(proc, new_buffer);
+	bucket = binder_free_bucket(new_buffer_size);
+	new_buffer->free_bucket = bucket;
+	p = &proc->free_buffers[bucket].rb_node;
 
 	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "binder: %d: add free buffer, size %zd, "
@@ -555,7 +718,51 @@ static void binder_insert_free_buffer(struct binder_proc *proc,
 			p = &parent->rb_right;
 	}
 	rb_link_node(&new_buffer->rb_node, parent, p);
-	rb_insert_color(&new_buffer->rb_node, &proc->free_buffers);
+	rb_insert_color(&new_buffer->rb_node,
+			&proc->free_buffers[bucket]);
+}
+
+/* the size of a free buffer changes when a neighbour is merged into it,
+ * so it is erased from the tree it was inserted into */
+static void binder_erase_free_buffer(struct binder_proc *proc,
+				     struct binder_buffer *buffer)
+{
+	BUG_ON(!buffer->free);
+	rb_erase(&buffer->rb_node, &proc->free_buffers[buffer->free_bucket]);
+}
+
+/* smallest free buffer of at least size bytes */
+static struct binder_buffer *binder_find_free_buffer(struct binder_proc *proc,
+						     size_t size)
+{
+	struct rb_node *n, *best_fit = NULL;
+	struct binder_buffer *buffer;
+	size_t buffer_size;
+	int bucket = binder_free_bucket(size);
+
+	n = proc->free_buffers[bucket].rb_node;
+	while (n) {
+		buffer = rb_entry(n, struct binder_buffer, rb_node);
+		BUG_ON(!buffer->free);
+		buffer_size = binder_buffer_size(proc, buffer);
+
+		if (size < buffer_size) {
+			best_fit = n;
+			n = n->rb_left;
+		} else if (size > buffer_size)
+			n = n->rb_right;
+		else {
+			best_fit = n;
+			break;
+		}
+	}
+
+	/* every buffer in a larger size class fits, take the smallest */
+	while (!best_fit && ++bucket < BINDER_FREE_BUCKETS)
+		best_fit = rb_first(&proc->free_buffers[bucket]);
+
+	return best_fit ? rb_entry(best_fit, struct binder_buffer, rb_node)
+			: NULL;
 }
 
 static void binder_insert_allocated_buffer(struct binder_proc *proc,
@@ -646,9 +853,17 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 	for (page_addr = start; page_addr < end; page_addr += PAGE_SIZE) {
 		int ret;
 		struct page **page_array_ptr;
-		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
-
-		BUG_ON(*page);
+		int index = (page_addr - proc->buffer) / PAGE_SIZE;
+
+		page = &proc->pages[index];
+		if (*page) {
+			/* still mapped from an earlier buffer */
+			BUG_ON(!test_bit(index, proc->warm_map));
+			clear_bit(index, proc->warm_map);
+			proc->warm_pages--;
+			atomic_dec(&binder_warm_pages_total);
+			continue;
+		}
 		*page = alloc_page(GFP_KERNEL | __GFP_ZERO);
 		if (*page == NULL) {
 			printk(KERN_ERR "binder: %d: binder_alloc_buf failed "
@@ -685,7 +900,16 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 free_range:
 	for (page_addr = end - PAGE_SIZE; page_addr >= start;
 	     page_addr -= PAGE_SIZE) {
-		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
+		int index = (page_addr - proc->buffer) / PAGE_SIZE;
+
+		page = &proc->pages[index];
+		if (proc->warm_pages < binder_warm_pages_max) {
+			/* keep it mapped for the next buffer */
+			set_bit(index, proc->warm_map);
+			proc->warm_pages++;
+			atomic_inc(&binder_warm_pages_total);
+			continue;
+		}
 		if (vma)
 			zap_page_range(vma, (uintptr_t)page_addr +
 				proc->user_buffer_offset, PAGE_SIZE, NULL);
@@ -705,14 +929,113 @@ err_no_vma:
 	return -ENOMEM;
 }
 
+/*
+ * Give back up to nr_to_scan warm pages of proc. From reclaim mmap_sem
+ * may only be trylocked (nowait): the caller may hold it already. Must
+ * be called with binder_lock held.
+ */
+static int binder_reclaim_warm_pages(struct binder_proc *proc, int nr_to_scan,
+				     bool nowait)
+{
+	struct mm_struct *mm;
+	struct vm_area_struct *vma;
+	int index, freed = 0;
+
+	mm = get_task_mm(proc->tsk);
+	if (mm && !nowait)
+		down_write(&mm->mmap_sem);
+	else if (mm && !down_write_trylock(&mm->mmap_sem)) {
+		mmput(mm);
+		return 0;
+	}
+	vma = mm ? proc->vma : NULL;
+
+	for_each_set_bit(index, proc->warm_map,
+			 proc->buffer_size / PAGE_SIZE) {
+		void *page_addr = proc->buffer + index * PAGE_SIZE;
+
+		if (freed >= nr_to_scan)
+			break;
+		if (vma)
+			zap_page_range(vma, (uintptr_t)page_addr +
+				proc->user_buffer_offset, PAGE_SIZE, NULL);
+		unmap_kernel_range((unsigned long)page_addr, PAGE_SIZE);
+		__free_page(proc->pages[index]);
+		proc->pages[index] = NULL;
+		clear_bit(index, proc->warm_map);
+		proc->warm_pages--;
+		atomic_dec(&binder_warm_pages_total);
+		freed++;
+	}
+
+	if (mm) {
+		up_write(&mm->mmap_sem);
+		mmput(mm);
+	}
+
+	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
+		     "binder: %d: reclaimed %d warm pages\n", proc->pid, freed);
+	return freed;
+}
+
+static int binder_shrink(struct shrinker *shrinker, struct shrink_control *sc)
+{
+	struct binder_proc *proc;
+	struct hlist_node *pos;
+	int nr_to_scan = sc->nr_to_scan;
+
+	if (nr_to_scan <= 0)
+		return atomic_read(&binder_warm_pages_total);
+
+	if (!binder_trylock(__func__))
+		return -1;
+	hlist_for_each_entry(proc, pos, &binder_procs, proc_node) {
+		if (nr_to_scan <= 0)
+			break;
+		if (proc->warm_pages)
+			nr_to_scan -= binder_reclaim_warm_pages(proc,
+							nr_to_scan, true);
+	}
+	binder_unlock(__func__);
+
+	return atomic_read(&binder_warm_pages_total);
+}
+
+/* lowering the limit gives back the pages each proc holds above it */
+static int binder_set_warm_pages(const char *val, struct kernel_param *kp)
+{
+	struct binder_proc *proc;
+	struct hlist_node *pos;
+	int ret;
+
+	ret = param_set_uint(val, kp);
+	if (ret)
+		return ret;
+
+	binder_lock(__func__);
+	hlist_for_each_entry(proc, pos, &binder_procs, proc_node) {
+		if (proc->warm_pages > binder_warm_pages_max)
+			binder_reclaim_warm_pages(proc, proc->warm_pages -
+						  binder_warm_pages_max, false);
+	}
+	binder_unlock(__func__);
+
+	return 0;
+}
+module_param_call(warm_pages, binder_set_warm_pages, param_get_uint,
+		  &binder_warm_pages_max, S_IWUSR | S_IRUGO);
+
+static struct shrinker binder_shrinker = {
+	.shrink = binder_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
 static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 					      size_t data_size,
 					      size_t offsets_size, int is_async)
 {
-	struct rb_node *n = proc->free_buffers.rb_node;
 	struct binder_buffer *buffer;
 	size_t buffer_size;
-	struct rb_node *best_fit = NULL;
 	void *has_page_addr;
 	void *end_page_addr;
 	size_t size;
@@ -740,30 +1063,13 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 		return NULL;
 	}
 
-	while (n) {
-		buffer = rb_entry(n, struct binder_buffer, rb_node);
-		BUG_ON(!buffer->free);
-		buffer_size = binder_buffer_size(proc, buffer);
-
-		if (size < buffer_size) {
-			best_fit = n;
-			n = n->rb_left;
-		} else if (size > buffer_size)
-			n = n->rb_right;
-		else {
-			best_fit = n;
-			break;
-		}
-	}
-	if (best_fit == NULL) {
+	buffer = binder_find_free_buffer(proc, size);
+	if (buffer == NULL) {
 		printk(KERN_ERR "binder: %d: binder_alloc_buf size %zd failed, "
 		       "no address space\n", proc->pid, size);
 		return NULL;
 	}
-	if (n == NULL) {
-		buffer = rb_entry(best_fit, struct binder_buffer, rb_node);
-		buffer_size = binder_buffer_size(proc, buffer);
-	}
+	buffer_size = binder_buffer_size(proc, buffer);
 
 	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "binder: %d: binder_alloc_buf size %zd got buff"
@@ -771,7 +1077,7 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 
 	has_page_addr =
 		(void *)(((uintptr_t)buffer->data + buffer_size) & PAGE_MASK);
-	if (n == NULL) {
+	if (buffer_size != size) {
 		if (size + sizeof(struct binder_buffer) + 4 >= buffer_size)
 			buffer_size = size; /* no room for other buffers */
 		else
@@ -785,7 +1091,7 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	    (void *)PAGE_ALIGN((uintptr_t)buffer->data), end_page_addr, NULL))
 		return NULL;
 
-	rb_erase(best_fit, &proc->free_buffers);
+	binder_erase_free_buffer(proc, buffer);
 	buffer->free = 0;
 	binder_insert_allocated_buffer(proc, buffer);
 	if (buffer_size != size) {
@@ -907,7 +1213,7 @@ static void binder_free_buf(struct binder_proc *proc,
 		struct binder_buffer *next = list_entry(buffer->entry.next,
 						struct binder_buffer, entry);
 		if (next->free) {
-			rb_erase(&next->rb_node, &proc->free_buffers);
+			binder_erase_free_buffer(proc, next);
 			binder_delete_free_buffer(proc, next);
 		}
 	}
@@ -916,7 +1222,7 @@ static void binder_free_buf(struct binder_proc *proc,
 						struct binder_buffer, entry);
 		if (prev->free) {
 			binder_delete_free_buffer(proc, buffer);
-			rb_erase(&prev->rb_node, &proc->free_buffers);
+			binder_erase_free_buffer(proc, prev);
 			buffer = prev;
 		}
 	}
@@ -1039,7 +1345,7 @@ static int binder_dec_node(struct binder_node *node, int strong, int internal)
 		}
 	} else {
 		if (hlist_empty(&node->refs) && !node->local_strong_refs &&
-		    !node->local_weak_refs) {
+		    !node->local_weak_refs && !node->tmp_refs) {
 			list_del_init(&node->work.entry);
 			if (node->proc) {
 				rb_erase(&node->rb_node, &node->proc->nodes);
@@ -1060,6 +1366,18 @@ static int binder_dec_node(struct binder_node *node, int strong, int internal)
 	return 0;
 }
 
+static void binder_dec_node_tmpref(struct binder_node *node)
+{
+	BUG_ON(node->tmp_refs <= 0);
+	if (--node->tmp_refs)
+		return;
+	/*
+	 * Drops no reference, only frees the node if it became unused
+	 * (or its owner died) while it was pinned.
+	 */
+	binder_dec_node(node, 0, 1);
+}
+
 
 static struct binder_ref *binder_get_ref(struct binder_proc *proc,
 					 uint32_t desc)
@@ -1245,6 +1563,62 @@ static void binder_pop_transaction(struct binder_thread *target_thread,
 	binder_stats_deleted(BINDER_STAT_TRANSACTION);
 }
 
+static void binder_latency_proc_add(struct binder_proc *proc,
+				    enum binder_latency_types type, u32 us)
+{
+	binder_latency_add(&binder_latency[type], us);
+	binder_latency_add(&proc->latency[type], us);
+}
+
+/*
+ * Account the time @proc spent serving @in_reply_to. The node is only
+ * still pinned while the request buffer has not been freed, which is the
+ * usual case as the reply is sent before the request parcel goes away.
+ */
+static void binder_latency_replied(struct binder_proc *proc,
+				   struct binder_transaction *in_reply_to,
+				   ktime_t now)
+{
+	u32 us;
+
+	if (!now.tv64 || !in_reply_to->stamp.tv64)
+		return;
+	us = binder_latency_us(in_reply_to->stamp, now);
+	binder_latency_proc_add(proc, BINDER_LAT_SERVICE, us);
+	if (in_reply_to->buffer && in_reply_to->buffer->target_node)
+		binder_latency_sum_add(
+			&in_reply_to->buffer->target_node->service_latency, us);
+}
+
+/*
+ * @t was just picked up by @proc. Account its queueing (and for replies
+ * the whole round trip) and restart its clock for the service time.
+ */
+static void binder_latency_received(struct binder_proc *proc,
+				    struct binder_transaction *t,
+				    uint32_t cmd)
+{
+	ktime_t now = binder_latency_stamp();
+	u32 us;
+
+	if (!now.tv64) {
+		t->stamp = now;
+		return;
+	}
+	us = binder_latency_us(t->stamp, now);
+	if (t->stamp.tv64) {
+		binder_latency_proc_add(proc, BINDER_LAT_QUEUE, us);
+		if (cmd == BR_TRANSACTION)
+			binder_latency_sum_add(
+				&t->buffer->target_node->queue_latency, us);
+	}
+	if (cmd == BR_REPLY && t->start.tv64)
+		binder_latency_proc_add(proc, BINDER_LAT_ROUND_TRIP,
+					binder_latency_us(t->start, now));
+	trace_binder_transaction_received(t, us);
+	t->stamp = now;
+}
+
 static void binder_send_failed_reply(struct binder_transaction *t,
 				     uint32_t error_code)
 {
@@ -1390,6 +1764,9 @@ static void binder_transaction(struct binder_proc *proc,
 	struct binder_transaction *in_reply_to = NULL;
 	struct binder_transaction_log_entry *e;
 	uint32_t return_error;
+	bool target_ref = false;
+	int copy_failed = 0;
+	ktime_t now;
 
 	e = binder_transaction_log_add(&binder_transaction_log);
 	e->call_type = reply ? 2 : !!(tr->flags & TF_ONE_WAY);
@@ -1543,6 +1920,7 @@ static void binder_transaction(struct binder_proc *proc,
 	t->code = tr->code;
 	t->flags = tr->flags;
 	t->priority = task_nice(current);
+	now = binder_latency_stamp();
 	t->buffer = binder_alloc_buf(target_proc, tr->data_size,
 		tr->offsets_size, !reply && (t->flags & TF_ONE_WAY));
 	if (t->buffer == NULL) {
@@ -1553,23 +1931,89 @@ static void binder_transaction(struct binder_proc *proc,
 	t->buffer->debug_id = t->debug_id;
 	t->buffer->transaction = t;
 	t->buffer->target_node = target_node;
+	if (now.tv64) {
+		u32 us = binder_latency_us(now, ktime_get());
+
+		binder_latency_proc_add(target_proc, BINDER_LAT_ALLOC, us);
+		trace_binder_transaction_alloc_buf(t->buffer, us);
+	} else
+		trace_binder_transaction_alloc_buf(t->buffer, 0);
 	if (target_node)
 		binder_inc_node(target_node, 1, 0, NULL);
 
 	offp = (size_t *)(t->buffer->data + ALIGN(tr->data_size, sizeof(void *)));
 
-	if (copy_from_user(t->buffer->data, tr->data.ptr.buffer, tr->data_size)) {
+	/*
+	 * Copy the payload without binder_lock, so a sender faulting on its
+	 * user memory does not stall every other transaction. The buffer is
+	 * not visible to the target yet. The target's tmp_ref keeps its
+	 * buffer space around and the node's tmp_refs keeps the node's
+	 * memory around, even if binder_deferred_release runs meanwhile.
+	 * Everything else must be revalidated afterwards.
+	 */
+	target_proc->tmp_ref++;
+	if (target_node)
+		target_node->tmp_refs++;
+	target_ref = true;
+	binder_unlock(__func__);
+	if (copy_from_user(t->buffer->data, tr->data.ptr.buffer,
+			   tr->data_size))
+		copy_failed = 1;
+	else if (copy_from_user(offp, tr->data.ptr.offsets,
+				tr->offsets_size))
+		copy_failed = 2;
+	binder_lock(__func__);
+
+	if (copy_failed) {
 		binder_user_error("binder: %d:%d got transaction with invalid "
-			"data ptr\n", proc->pid, thread->pid);
+			"%s ptr\n", proc->pid, thread->pid,
+			copy_failed == 1 ? "data" : "offsets");
 		return_error = BR_FAILED_REPLY;
 		goto err_copy_data_failed;
 	}
-	if (copy_from_user(offp, tr->data.ptr.offsets, tr->offsets_size)) {
-		binder_user_error("binder: %d:%d got transaction with invalid "
-			"offsets ptr\n", proc->pid, thread->pid);
-		return_error = BR_FAILED_REPLY;
+	if (target_proc->is_dead) {
+		return_error = BR_DEAD_REPLY;
 		goto err_copy_data_failed;
 	}
+	if (reply) {
+		/* the thread we reply to may have exited meanwhile */
+		target_thread = in_reply_to->from;
+		if (target_thread == NULL) {
+			return_error = BR_DEAD_REPLY;
+			goto err_copy_data_failed;
+		}
+		if (target_thread->transaction_stack != in_reply_to) {
+			binder_user_error("binder: %d:%d got reply transaction "
+				"with bad target transaction stack %d, "
+				"expected %d\n",
+				proc->pid, thread->pid,
+				target_thread->transaction_stack ?
+				target_thread->transaction_stack->debug_id : 0,
+				in_reply_to->debug_id);
+			return_error = BR_FAILED_REPLY;
+			in_reply_to = NULL;
+			target_thread = NULL;
+			goto err_copy_data_failed;
+		}
+	} else if (target_thread) {
+		/* redo the lookup, the thread may have exited meanwhile */
+		struct binder_transaction *tmp = thread->transaction_stack;
+
+		target_thread = NULL;
+		while (tmp) {
+			if (tmp->from && tmp->from->proc == target_proc)
+				target_thread = tmp->from;
+			tmp = tmp->from_parent;
+		}
+	}
+	t->to_thread = target_thread;
+	if (target_thread) {
+		target_list = &target_thread->todo;
+		target_wait = &target_thread->wait;
+	} else {
+		target_list = &target_proc->todo;
+		target_wait = &target_proc->wait;
+	}
 	if (!IS_ALIGNED(tr->offsets_size, sizeof(size_t))) {
 		binder_user_error("binder: %d:%d got transaction with "
 			"invalid offsets size, %zd\n",
@@ -1715,8 +2159,13 @@ static void binder_transaction(struct binder_proc *proc,
 			goto err_bad_object_type;
 		}
 	}
+	now = binder_latency_stamp();
+	t->stamp = now;
+	t->start = now;
 	if (reply) {
 		BUG_ON(t->buffer->async_transaction != 0);
+		t->start = in_reply_to->start;
+		binder_latency_replied(proc, in_reply_to, now);
 		binder_pop_transaction(target_thread, in_reply_to);
 	} else if (!(t->flags & TF_ONE_WAY)) {
 		BUG_ON(t->buffer->async_transaction != 0);
@@ -1734,10 +2183,14 @@ static void binder_transaction(struct binder_proc *proc,
 	}
 	t->work.type = BINDER_WORK_TRANSACTION;
 	list_add_tail(&t->work.entry, target_list);
+	trace_binder_transaction(reply, t, target_node);
 	tcomplete->type = BINDER_WORK_TRANSACTION_COMPLETE;
 	list_add_tail(&tcomplete->entry, &thread->todo);
 	if (target_wait)
 		wake_up_interruptible(target_wait);
+	if (target_node)
+		binder_dec_node_tmpref(target_node);
+	binder_proc_dec_tmpref(target_proc);
 	return;
 
 err_get_unused_fd_failed:
@@ -1749,9 +2202,17 @@ err_binder_new_node_failed:
 err_bad_object_type:
 err_bad_offset:
 err_copy_data_failed:
+	/* a dead node already had its local references dropped */
+	if (target_node && !target_node->proc)
+		t->buffer->target_node = NULL;
 	binder_transaction_buffer_release(target_proc, t->buffer, offp);
 	t->buffer->transaction = NULL;
 	binder_free_buf(target_proc, t->buffer);
+	if (target_ref) {
+		if (target_node)
+			binder_dec_node_tmpref(target_node);
+		binder_proc_dec_tmpref(target_proc);
+	}
 err_binder_alloc_buf_failed:
 	kfree(tcomplete);
 	binder_stats_deleted(BINDER_STAT_TRANSACTION_COMPLETE);
@@ -2232,7 +2693,7 @@ retry:
 	thread->looper |= BINDER_LOOPER_STATE_WAITING;
 	if (wait_for_proc_work)
 		proc->ready_threads++;
-	mutex_unlock(&binder_lock);
+	binder_unlock(__func__);
 	if (wait_for_proc_work) {
 		if (!(thread->looper & (BINDER_LOOPER_STATE_REGISTERED |
 					BINDER_LOOPER_STATE_ENTERED))) {
@@ -2256,7 +2717,7 @@ retry:
 		} else
 			ret = wait_event_interruptible(thread->wait, binder_has_thread_work(thread));
 	}
-	mutex_lock(&binder_lock);
+	binder_lock(__func__);
 	if (wait_for_proc_work)
 		proc->ready_threads--;
 	thread->looper &= ~BINDER_LOOPER_STATE_WAITING;
@@ -2447,6 +2908,7 @@ retry:
 		ptr += sizeof(tr);
 
 		binder_stat_br(proc, thread, cmd);
+		binder_latency_received(proc, t, cmd);
 		binder_debug(BINDER_DEBUG_TRANSACTION,
 			     "binder: %d:%d %s %d %d:%d, cmd %d"
 			     "size %zd-%zd ptr %p-%p\n",
@@ -2598,12 +3060,12 @@ static unsigned int binder_poll(struct file *filp,
 	struct binder_thread *thread = NULL;
 	int wait_for_proc_work;
 
-	mutex_lock(&binder_lock);
+	binder_lock(__func__);
 	thread = binder_get_thread(proc);
 
 	wait_for_proc_work = thread->transaction_stack == NULL &&
 		list_empty(&thread->todo) && thread->return_error == BR_OK;
-	mutex_unlock(&binder_lock);
+	binder_unlock(__func__);
 
 	if (wait_for_proc_work) {
 		if (binder_has_proc_work(proc, thread))
@@ -2635,7 +3097,7 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	if (ret)
 		return ret;
 
-	mutex_lock(&binder_lock);
+	binder_lock(__func__);
 	thread = binder_get_thread(proc);
 	if (thread == NULL) {
 		ret = -ENOMEM;
@@ -2744,7 +3206,7 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 err:
 	if (thread)
 		thread->looper &= ~BINDER_LOOPER_STATE_NEED_RETURN;
-	mutex_unlock(&binder_lock);
+	binder_unlock(__func__);
 	wait_event_interruptible(binder_user_error_wait, binder_stop_on_user_error < 2);
 	if (ret && ret != -ERESTARTSYS)
 		printk(KERN_INFO "binder: %d:%d ioctl %x %lx returned %d\n", proc->pid, current->pid, cmd, arg, ret);
@@ -2833,6 +3295,13 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 		goto err_alloc_pages_failed;
 	}
 	proc->buffer_size = vma->vm_end - vma->vm_start;
+	proc->warm_map = kzalloc(BITS_TO_LONGS(proc->buffer_size / PAGE_SIZE) *
+				 sizeof(long), GFP_KERNEL);
+	if (proc->warm_map == NULL) {
+		ret = -ENOMEM;
+		failure_string = "alloc warm page map";
+		goto err_alloc_warm_map_failed;
+	}
 
 	vma->vm_ops = &binder_vm_ops;
 	vma->vm_private_data = proc;
@@ -2857,6 +3326,9 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 	return 0;
 
 err_alloc_small_buf_failed:
+	kfree(proc->warm_map);
+	proc->warm_map = NULL;
+err_alloc_warm_map_failed:
 	kfree(proc->pages);
 	proc->pages = NULL;
 err_alloc_pages_failed:
@@ -2885,13 +3357,13 @@ static int binder_open(struct inode *nodp, struct file *filp)
 	INIT_LIST_HEAD(&proc->todo);
 	init_waitqueue_head(&proc->wait);
 	proc->default_priority = task_nice(current);
-	mutex_lock(&binder_lock);
+	binder_lock(__func__);
 	binder_stats_created(BINDER_STAT_PROC);
 	hlist_add_head(&proc->proc_node, &binder_procs);
 	proc->pid = current->group_leader->pid;
 	INIT_LIST_HEAD(&proc->delivered_death);
 	filp->private_data = proc;
-	mutex_unlock(&binder_lock);
+	binder_unlock(__func__);
 
 	if (binder_debugfs_dir_entry_proc) {
 		char strbuf[11];
@@ -2940,12 +3412,75 @@ static int binder_release(struct inode *nodp, struct file *filp)
 	return 0;
 }
 
+static void binder_free_proc(struct binder_proc *proc)
+{
+	struct binder_transaction *t;
+	struct rb_node *n;
+	int buffers, page_count;
+
+	buffers = 0;
+	while ((n = rb_first(&proc->allocated_buffers))) {
+		struct binder_buffer *buffer = rb_entry(n, struct binder_buffer,
+							rb_node);
+		t = buffer->transaction;
+		if (t) {
+			t->buffer = NULL;
+			buffer->transaction = NULL;
+			printk(KERN_ERR "binder: release proc %d, "
+			       "transaction %d, not freed\n",
+			       proc->pid, t->debug_id);
+			/*BUG();*/
+		}
+		binder_free_buf(proc, buffer);
+		buffers++;
+	}
+
+	binder_stats_deleted(BINDER_STAT_PROC);
+
+	page_count = 0;
+	if (proc->pages) {
+		int i;
+		for (i = 0; i < proc->buffer_size / PAGE_SIZE; i++) {
+			if (proc->pages[i]) {
+				void *page_addr = proc->buffer + i * PAGE_SIZE;
+				binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
+					     "binder_release: %d: "
+					     "page %d at %p not freed\n",
+					     proc->pid, i,
+					     page_addr);
+				unmap_kernel_range((unsigned long)page_addr,
+					PAGE_SIZE);
+				__free_page(proc->pages[i]);
+				page_count++;
+			}
+		}
+		atomic_sub(proc->warm_pages, &binder_warm_pages_total);
+		kfree(proc->warm_map);
+		kfree(proc->pages);
+		vfree(proc->buffer);
+	}
+
+	put_task_struct(proc->tsk);
+
+	binder_debug(BINDER_DEBUG_OPEN_CLOSE,
+		     "binder_release: %d buffers %d, pages %d\n",
+		     proc->pid, buffers, page_count);
+
+	kfree(proc);
+}
+
+static void binder_proc_dec_tmpref(struct binder_proc *proc)
+{
+	BUG_ON(proc->tmp_ref <= 0);
+	if (!--proc->tmp_ref && proc->is_dead)
+		binder_free_proc(proc);
+}
+
 static void binder_deferred_release(struct binder_proc *proc)
 {
 	struct hlist_node *pos;
-	struct binder_transaction *t;
 	struct rb_node *n;
-	int threads, nodes, incoming_refs, outgoing_refs, buffers, active_transactions, page_count;
+	int threads, nodes, incoming_refs, outgoing_refs, active_transactions;
 
 	BUG_ON(proc->vma);
 	BUG_ON(proc->files);
@@ -2973,7 +3508,7 @@ static void binder_deferred_release(struct binder_proc *proc)
 		nodes++;
 		rb_erase(&node->rb_node, &proc->nodes);
 		list_del_init(&node->work.entry);
-		if (hlist_empty(&node->refs)) {
+		if (hlist_empty(&node->refs) && !node->tmp_refs) {
 			kfree(node);
 			binder_stats_deleted(BINDER_STAT_NODE);
 		} else {
@@ -3011,57 +3546,17 @@ static void binder_deferred_release(struct binder_proc *proc)
 		binder_delete_ref(ref);
 	}
 	binder_release_work(&proc->todo);
-	buffers = 0;
-
-	while ((n = rb_first(&proc->allocated_buffers))) {
-		struct binder_buffer *buffer = rb_entry(n, struct binder_buffer,
-							rb_node);
-		t = buffer->transaction;
-		if (t) {
-			t->buffer = NULL;
-			buffer->transaction = NULL;
-			printk(KERN_ERR "binder: release proc %d, "
-			       "transaction %d, not freed\n",
-			       proc->pid, t->debug_id);
-			/*BUG();*/
-		}
-		binder_free_buf(proc, buffer);
-		buffers++;
-	}
-
-	binder_stats_deleted(BINDER_STAT_PROC);
-
-	page_count = 0;
-	if (proc->pages) {
-		int i;
-		for (i = 0; i < proc->buffer_size / PAGE_SIZE; i++) {
-			if (proc->pages[i]) {
-				void *page_addr = proc->buffer + i * PAGE_SIZE;
-				binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
-					     "binder_release: %d: "
-					     "page %d at %p not freed\n",
-					     proc->pid, i,
-					     page_addr);
-				unmap_kernel_range((unsigned long)page_addr,
-					PAGE_SIZE);
-				__free_page(proc->pages[i]);
-				page_count++;
-			}
-		}
-		kfree(proc->pages);
-		vfree(proc->buffer);
-	}
-
-	put_task_struct(proc->tsk);
 
 	binder_debug(BINDER_DEBUG_OPEN_CLOSE,
 		     "binder_release: %d threads %d, nodes %d (ref %d), "
-		     "refs %d, active transactions %d, buffers %d, "
-		     "pages %d\n",
+		     "refs %d, active transactions %d\n",
 		     proc->pid, threads, nodes, incoming_refs, outgoing_refs,
-		     active_transactions, buffers, page_count);
+		     active_transactions);
 
-	kfree(proc);
+	/* a sender still copying into our buffers frees us when done */
+	proc->is_dead = true;
+	if (!proc->tmp_ref)
+		binder_free_proc(proc);
 }
 
 static void binder_deferred_func(struct work_struct *work)
@@ -3071,7 +3566,7 @@ static void binder_deferred_func(struct work_struct *work)
 
 	int defer;
 	do {
-		mutex_lock(&binder_lock);
+		binder_lock(__func__);
 		mutex_lock(&binder_deferred_lock);
 		if (!hlist_empty(&binder_deferred_list)) {
 			proc = hlist_entry(binder_deferred_list.first,
@@ -3098,7 +3593,7 @@ static void binder_deferred_func(struct work_struct *work)
 		if (defer & BINDER_DEFERRED_RELEASE)
 			binder_deferred_release(proc); /* frees proc */
 
-		mutex_unlock(&binder_lock);
+		binder_unlock(__func__);
 		if (files)
 			put_files_struct(files);
 	} while (proc);
@@ -3414,6 +3909,7 @@ static void print_binder_proc_stats(struct seq_file *m,
 	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
 		count++;
 	seq_printf(m, "  buffers: %d\n", count);
+	seq_printf(m, "  warm pages: %d\n", proc->warm_pages);
 
 	count = 0;
 	list_for_each_entry(w, &proc->todo, entry) {
@@ -3439,7 +3935,7 @@ static int binder_state_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_lock(__func__);
 
 	seq_puts(m, "binder state:\n");
 
@@ -3451,7 +3947,7 @@ static int binder_state_show(struct seq_file *m, void *unused)
 	hlist_for_each_entry(proc, pos, &binder_procs, proc_node)
 		print_binder_proc(m, proc, 1);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_unlock(__func__);
 	return 0;
 }
 
@@ -3462,7 +3958,7 @@ static int binder_stats_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_lock(__func__);
 
 	seq_puts(m, "binder stats:\n");
 
@@ -3471,7 +3967,7 @@ static int binder_stats_show(struct seq_file *m, void *unused)
 	hlist_for_each_entry(proc, pos, &binder_procs, proc_node)
 		print_binder_proc_stats(m, proc);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_unlock(__func__);
 	return 0;
 }
 
@@ -3482,13 +3978,75 @@ static int binder_transactions_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_lock(__func__);
 
 	seq_puts(m, "binder transactions:\n");
 	hlist_for_each_entry(proc, pos, &binder_procs, proc_node)
 		print_binder_proc(m, proc, 0);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_unlock(__func__);
+	return 0;
+}
+
+static void print_binder_latency(struct seq_file *m, const char *prefix,
+				 struct binder_latency *lat, int count)
+{
+	int i, j;
+
+	for (i = 0; i < count; i++) {
+		if (!lat[i].sum.count)
+			continue;
+		seq_printf(m, "%s%s: %u avg %llu max %u:", prefix,
+			   binder_latency_names[i], lat[i].sum.count,
+			   div_u64(lat[i].sum.total_us, lat[i].sum.count),
+			   lat[i].sum.max_us);
+		for (j = 0; j < BINDER_LATENCY_BUCKETS; j++)
+			seq_printf(m, " %u", lat[i].hist[j]);
+		seq_puts(m, "\n");
+	}
+}
+
+static void print_binder_latency_sum(struct seq_file *m, const char *name,
+				     struct binder_latency_sum *sum)
+{
+	seq_printf(m, " %s %u avg %llu max %u", name, sum->count,
+		   sum->count ? div_u64(sum->total_us, sum->count) : 0,
+		   sum->max_us);
+}
+
+static int binder_latency_show(struct seq_file *m, void *unused)
+{
+	struct binder_proc *proc;
+	struct binder_node *node;
+	struct hlist_node *pos;
+	struct rb_node *n;
+	int do_lock = !binder_debug_no_lock;
+
+	if (do_lock)
+		binder_lock(__func__);
+
+	seq_puts(m, "binder latency (us), histogram buckets <1 <2 <4 .. "
+		 "<16384 >=16384:\n");
+	print_binder_latency(m, "", binder_latency, BINDER_LAT_COUNT);
+
+	hlist_for_each_entry(proc, pos, &binder_procs, proc_node) {
+		seq_printf(m, "proc %d\n", proc->pid);
+		print_binder_latency(m, "  ", proc->latency,
+				     BINDER_LAT_PROC_COUNT);
+		for (n = rb_first(&proc->nodes); n != NULL; n = rb_next(n)) {
+			node = rb_entry(n, struct binder_node, rb_node);
+			if (!node->queue_latency.count)
+				continue;
+			seq_printf(m, "  node %d:", node->debug_id);
+			print_binder_latency_sum(m, "queue",
+						 &node->queue_latency);
+			print_binder_latency_sum(m, "service",
+						 &node->service_latency);
+			seq_puts(m, "\n");
+		}
+	}
+	if (do_lock)
+		binder_unlock(__func__);
 	return 0;
 }
 
@@ -3498,11 +4056,11 @@ static int binder_proc_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_lock(__func__);
 	seq_puts(m, "binder proc state:\n");
 	print_binder_proc(m, proc, 1);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_unlock(__func__);
 	return 0;
 }
 
@@ -3551,6 +4109,7 @@ BINDER_DEBUG_ENTRY(state);
 BINDER_DEBUG_ENTRY(stats);
 BINDER_DEBUG_ENTRY(transactions);
 BINDER_DEBUG_ENTRY(transaction_log);
+BINDER_DEBUG_ENTRY(latency);
 
 static int __init binder_init(void)
 {
@@ -3565,6 +4124,7 @@ static int __init binder_init(void)
 		binder_debugfs_dir_entry_proc = debugfs_create_dir("proc",
 						 binder_debugfs_dir_entry_root);
 	ret = misc_register(&binder_miscdev);
+	register_shrinker(&binder_shrinker);
 	if (binder_debugfs_dir_entry_root) {
 		debugfs_create_file("state",
 				    S_IRUGO,
@@ -3591,10 +4151,18 @@ static int __init binder_init(void)
 				    binder_debugfs_dir_entry_root,
 				    &binder_transaction_log_failed,
 				    &binder_transaction_log_fops);
+		debugfs_create_file("latency",
+				    S_IRUGO,
+				    binder_debugfs_dir_entry_root,
+				    NULL,
+				    &binder_latency_fops);
 	}
 	return ret;
 }
 
 device_initcall(binder_init);
 
+#define CREATE_TRACE_POINTS
+#include "binder_trace.h"
+
 MODULE_LICENSE("GPL v2");
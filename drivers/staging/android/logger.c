@@ -21,46 +21,68 @@
 #include <linux/module.h>
 #include <linux/fs.h>
 #include <linux/miscdevice.h>
+#include <linux/mm.h>
 #include <linux/uaccess.h>
 #include <linux/poll.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/percpu.h>
 #include <linux/time.h>
 #include "logger.h"
 
 #include <asm/ioctls.h>
 
+#define LOGGER_ENTRY_MAX_LEN \
+	(sizeof(struct logger_entry) + LOGGER_ENTRY_MAX_PAYLOAD)
+
 /*
  * struct logger_log - represents a specific log, such as 'main' or 'radio'
  *
  * This structure lives from module insertion until module removal, so it does
  * not need additional reference counting. The structure is protected by the
- * mutex 'mutex'.
+ * spinlock 'lock', which is never held across a user copy: writers assemble
+ * their entry beforehand and readers take a snapshot of one entry under it.
  */
 struct logger_log {
 	unsigned char 		*buffer;/* the ring buffer itself */
 	struct miscdevice	misc;	/* misc device representing the log */
 	wait_queue_head_t	wq;	/* wait queue for readers */
 	struct list_head	readers; /* this log's readers */
-	struct mutex		mutex;	/* mutex protecting buffer */
+	spinlock_t		lock;	/* lock protecting buffer */
 	size_t			w_off;	/* current write head offset */
 	size_t			head;	/* new readers start here */
 	size_t			size;	/* size of the log */
+	struct logger_mmap_header *mmap_hdr; /* header page for mmap() */
 };
 
 /*
  * struct logger_reader - a logging device open for reading
  *
  * This object lives from open to release, so we don't need additional
- * reference counting. The structure is protected by log->mutex.
+ * reference counting. The offsets are protected by log->lock, the entry
+ * snapshot in 'buf' by 'mutex'.
  */
 struct logger_reader {
 	struct logger_log	*log;	/* associated log */
 	struct list_head	list;	/* entry in logger_log's list */
 	size_t			r_off;	/* current read head offset */
 	bool			r_all;	/* reader can read all entries */
+	bool			r_mapped; /* reader parses the mmap()ed ring */
 	int			r_ver;	/* reader ABI version */
+	struct mutex		mutex;	/* serializes reads of this reader */
+	unsigned char		buf[LOGGER_ENTRY_MAX_LEN]; /* entry snapshot */
+};
+
+/*
+ * struct logger_stage - a per-CPU buffer a writer assembles its entry in,
+ * so that the ring is only touched by a single memcpy under log->lock.
+ */
+struct logger_stage {
+	unsigned char		buf[LOGGER_ENTRY_MAX_LEN];
 };
 
+static DEFINE_PER_CPU(struct logger_stage, logger_stage);
+
 /* logger_offset - returns index 'n' into the log via (optimized) modulus */
 #define logger_offset(n)	((n) & (log->size - 1))
 
@@ -112,7 +134,7 @@ static struct logger_entry *get_entry_header(struct logger_log *log,
  * get_entry_msg_len - Grabs the length of the message of the entry
  * starting from from 'off'.
  *
- * Caller needs to hold log->mutex.
+ * Caller needs to hold log->lock.
  */
 static __u32 get_entry_msg_len(struct logger_log *log, size_t off)
 {
@@ -156,54 +178,42 @@ static ssize_t copy_header_to_user(int ver, struct logger_entry *entry,
 }
 
 /*
- * do_read_log_to_user - reads exactly 'count' bytes from 'log' into the
- * user-space buffer 'buf'. Returns 'count' on success.
+ * do_read_log - copies the 'count' bytes at 'off' out of the ring into 'buf'
  *
- * Caller must hold log->mutex.
+ * Caller must hold log->lock.
  */
-static ssize_t do_read_log_to_user(struct logger_log *log,
-				   struct logger_reader *reader,
-				   char __user *buf,
-				   size_t count)
+static void do_read_log(struct logger_log *log, size_t off, void *buf,
+			size_t count)
 {
-	struct logger_entry scratch;
-	struct logger_entry *entry;
 	size_t len;
-	size_t msg_start;
 
-	/*
-	 * First, copy the header to userspace, using the version of
-	 * the header requested
-	 */
-	entry = get_entry_header(log, reader->r_off, &scratch);
-	if (copy_header_to_user(reader->r_ver, entry, buf))
-		return -EFAULT;
+	len = min(count, log->size - off);
+	memcpy(buf, log->buffer + off, len);
 
-	count -= get_user_hdr_len(reader->r_ver);
-	buf += get_user_hdr_len(reader->r_ver);
-	msg_start = logger_offset(reader->r_off + sizeof(struct logger_entry));
+	if (count != len)
+		memcpy(buf + len, log->buffer, count - len);
+}
 
-	/*
-	 * We read from the msg in two disjoint operations. First, we read from
-	 * the current msg head offset up to 'count' bytes or to the end of
-	 * the log, whichever comes first.
-	 */
-	len = min(count, log->size - msg_start);
-	if (copy_to_user(buf, log->buffer + msg_start, len))
-		return -EFAULT;
+/*
+ * do_read_log_to_user - copies the entry snapshot of 'reader' into the
+ * user-space buffer 'buf', using the header version the reader asked for.
+ * Returns the number of bytes copied on success.
+ *
+ * Caller must hold reader->mutex.
+ */
+static ssize_t do_read_log_to_user(struct logger_reader *reader,
+				   char __user *buf)
+{
+	struct logger_entry *entry = (struct logger_entry *) reader->buf;
+	size_t hdr_len = get_user_hdr_len(reader->r_ver);
 
-	/*
-	 * Second, we read any remaining bytes, starting back at the head of
-	 * the log.
-	 */
-	if (count != len)
-		if (copy_to_user(buf + len, log->buffer, count - len))
-			return -EFAULT;
+	if (copy_header_to_user(reader->r_ver, entry, buf))
+		return -EFAULT;
 
-	reader->r_off = logger_offset(reader->r_off +
-		sizeof(struct logger_entry) + count);
+	if (copy_to_user(buf + hdr_len, entry->msg, entry->len))
+		return -EFAULT;
 
-	return count + get_user_hdr_len(reader->r_ver);
+	return hdr_len + entry->len;
 }
 
 /*
@@ -250,13 +260,14 @@ static ssize_t logger_read(struct file *file, char __user *buf,
 	ssize_t ret;
 	DEFINE_WAIT(wait);
 
+	mutex_lock(&reader->mutex);
 start:
 	while (1) {
 		prepare_to_wait(&log->wq, &wait, TASK_INTERRUPTIBLE);
 
-		mutex_lock(&log->mutex);
+		spin_lock(&log->lock);
 		ret = (log->w_off == reader->r_off);
-		mutex_unlock(&log->mutex);
+		spin_unlock(&log->lock);
 		if (!ret)
 			break;
 
@@ -275,9 +286,9 @@ start:
 
 	finish_wait(&log->wq, &wait);
 	if (ret)
-		return ret;
+		goto out;
 
-	mutex_lock(&log->mutex);
+	spin_lock(&log->lock);
 
 	if (!reader->r_all)
 		reader->r_off = get_next_entry_by_uid(log,
@@ -285,23 +296,33 @@ start:
 
 	/* is there still something to read or did we race? */
 	if (unlikely(log->w_off == reader->r_off)) {
-		mutex_unlock(&log->mutex);
+		spin_unlock(&log->lock);
 		goto start;
 	}
 
 	/* get the size of the next entry */
-	ret = get_user_hdr_len(reader->r_ver) +
-		get_entry_msg_len(log, reader->r_off);
-	if (count < ret) {
+	ret = get_entry_msg_len(log, reader->r_off);
+	if (count < get_user_hdr_len(reader->r_ver) + ret) {
+		spin_unlock(&log->lock);
 		ret = -EINVAL;
 		goto out;
 	}
 
-	/* get exactly one entry from the log */
-	ret = do_read_log_to_user(log, reader, buf, ret);
+	/*
+	 * Take exactly one entry out of the log. Writers may overwrite it
+	 * as soon as the lock is dropped, so it is copied to userspace from
+	 * the snapshot.
+	 */
+	ret += sizeof(struct logger_entry);
+	do_read_log(log, reader->r_off, reader->buf, ret);
+	reader->r_off = logger_offset(reader->r_off + ret);
+
+	spin_unlock(&log->lock);
+
+	ret = do_read_log_to_user(reader, buf);
 
 out:
-	mutex_unlock(&log->mutex);
+	mutex_unlock(&reader->mutex);
 
 	return ret;
 }
@@ -310,7 +331,7 @@ out:
  * get_next_entry - return the offset of the first valid entry at least 'len'
  * bytes after 'off'.
  *
- * Caller must hold log->mutex.
+ * Caller must hold log->lock.
  */
 static size_t get_next_entry(struct logger_log *log, size_t off, size_t len)
 {
@@ -349,7 +370,7 @@ static inline int clock_interval(size_t a, size_t b, size_t c)
  * We do this by "pulling forward" the readers and start head to the first
  * entry after the new write head.
  *
- * The caller needs to hold log->mutex.
+ * The caller needs to hold log->lock.
  */
 static void fix_up_readers(struct logger_log *log, size_t len)
 {
@@ -357,8 +378,12 @@ static void fix_up_readers(struct logger_log *log, size_t len)
 	size_t new = logger_offset(old + len);
 	struct logger_reader *reader;
 
-	if (clock_interval(old, new, log->head))
-		log->head = get_next_entry(log, log->head, len);
+	if (clock_interval(old, new, log->head)) {
+		size_t head = get_next_entry(log, log->head, len);
+
+		log->mmap_hdr->head_pos += logger_offset(head - log->head);
+		log->head = head;
+	}
 
 	list_for_each_entry(reader, &log->readers, list)
 		if (clock_interval(old, new, reader->r_off))
@@ -368,7 +393,7 @@ static void fix_up_readers(struct logger_log *log, size_t len)
 /*
  * do_write_log - writes 'len' bytes from 'buf' to 'log'
  *
- * The caller needs to hold log->mutex.
+ * The caller needs to hold log->lock.
  */
 static void do_write_log(struct logger_log *log, const void *buf, size_t count)
 {
@@ -385,44 +410,82 @@ static void do_write_log(struct logger_log *log, const void *buf, size_t count)
 }
 
 /*
- * do_write_log_user - writes 'len' bytes from the user-space buffer 'buf' to
- * the log 'log'
- *
- * The caller needs to hold log->mutex.
+ * do_copy_iov_from_user - gathers 'count' bytes of payload from the
+ * user-space vectors 'iov' into 'buf'. With 'atomic' set the copy must not
+ * fault, and fails instead of paging the user buffer in.
  *
  * Returns 'count' on success, negative error code on failure.
  */
-static ssize_t do_write_log_from_user(struct logger_log *log,
-				      const void __user *buf, size_t count)
+static ssize_t do_copy_iov_from_user(void *buf, const struct iovec *iov,
+				     unsigned long nr_segs, size_t count,
+				     bool atomic)
 {
-	size_t len;
+	size_t done = 0;
 
-	len = min(count, log->size - log->w_off);
-	if (len && copy_from_user(log->buffer + log->w_off, buf, len))
-		return -EFAULT;
+	while (nr_segs-- > 0 && done < count) {
+		size_t len;
+		unsigned long left;
 
-	if (count != len)
-		if (copy_from_user(log->buffer, buf + len, count - len))
+		/* figure out how much of this vector we can keep */
+		len = min_t(size_t, iov->iov_len, count - done);
+
+		if (atomic) {
+			if (!access_ok(VERIFY_READ, iov->iov_base, len))
+				return -EFAULT;
+			left = __copy_from_user_inatomic(buf + done,
+							 iov->iov_base, len);
+		} else
+			left = copy_from_user(buf + done, iov->iov_base, len);
+		if (unlikely(left))
 			return -EFAULT;
 
-	log->w_off = logger_offset(log->w_off + count);
+		iov++;
+		done += len;
+	}
+
+	return done;
+}
+
+/*
+ * do_commit_log - appends the complete entry 'buf' of 'len' bytes to 'log'
+ */
+static void do_commit_log(struct logger_log *log, const void *buf, size_t len)
+{
+	spin_lock(&log->lock);
 
-	return count;
+	/*
+	 * Fix up any readers, pulling them forward to the first readable
+	 * entry after (what will be) the new write offset.
+	 */
+	fix_up_readers(log, len);
+	/* mapped readers must see the head move before its entries go */
+	smp_wmb();
+	do_write_log(log, buf, len);
+	smp_wmb();
+	log->mmap_hdr->w_pos += len;
+
+	spin_unlock(&log->lock);
 }
 
 /*
  * logger_aio_write - our write method, implementing support for write(),
  * writev(), and aio_write(). Writes are our fast path, and we try to optimize
  * them above all else.
+ *
+ * The entry is assembled in this CPU's staging buffer without any lock and
+ * appended to the ring in one go, so concurrent writers only ever spin for
+ * the length of a memcpy. Should the payload not be resident, the entry is
+ * assembled in a temporary buffer instead, where faulting it in is fine.
  */
 ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 			 unsigned long nr_segs, loff_t ppos)
 {
 	struct logger_log *log = file_get_log(iocb->ki_filp);
-	size_t orig = log->w_off;
 	struct logger_entry header;
 	struct timespec now;
-	ssize_t ret = 0;
+	unsigned char *entry;
+	size_t len;
+	ssize_t ret;
 
 	now = current_kernel_time();
 
@@ -438,39 +501,32 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 	if (unlikely(!header.len))
 		return 0;
 
-	mutex_lock(&log->mutex);
-
-	/*
-	 * Fix up any readers, pulling them forward to the first readable
-	 * entry after (what will be) the new write offset. We do this now
-	 * because if we partially fail, we can end up with clobbered log
-	 * entries that encroach on readable buffer.
-	 */
-	fix_up_readers(log, sizeof(struct logger_entry) + header.len);
-
-	do_write_log(log, &header, sizeof(struct logger_entry));
-
-	while (nr_segs-- > 0) {
-		size_t len;
-		ssize_t nr;
-
-		/* figure out how much of this vector we can keep */
-		len = min_t(size_t, iov->iov_len, header.len - ret);
-
-		/* write out this segment's payload */
-		nr = do_write_log_from_user(log, iov->iov_base, len);
-		if (unlikely(nr < 0)) {
-			log->w_off = orig;
-			mutex_unlock(&log->mutex);
-			return nr;
-		}
-
-		iov++;
-		ret += nr;
+	len = sizeof(struct logger_entry) + header.len;
+
+	entry = get_cpu_var(logger_stage).buf;
+	memcpy(entry, &header, sizeof(struct logger_entry));
+	pagefault_disable();
+	ret = do_copy_iov_from_user(entry + sizeof(struct logger_entry),
+				    iov, nr_segs, header.len, true);
+	pagefault_enable();
+	if (likely(ret >= 0))
+		do_commit_log(log, entry, len);
+	put_cpu_var(logger_stage);
+
+	if (unlikely(ret < 0)) {
+		entry = kmalloc(len, GFP_KERNEL);
+		if (!entry)
+			return -ENOMEM;
+		memcpy(entry, &header, sizeof(struct logger_entry));
+		ret = do_copy_iov_from_user(entry + sizeof(struct logger_entry),
+					    iov, nr_segs, header.len, false);
+		if (ret >= 0)
+			do_commit_log(log, entry, len);
+		kfree(entry);
+		if (ret < 0)
+			return ret;
 	}
 
-	mutex_unlock(&log->mutex);
-
 	/* wake up any blocked readers */
 	wake_up_interruptible(&log->wq);
 
@@ -505,16 +561,18 @@ static int logger_open(struct inode *inode, struct file *file)
 			return -ENOMEM;
 
 		reader->log = log;
+		reader->r_mapped = false;
 		reader->r_ver = 1;
 		reader->r_all = in_egroup_p(inode->i_gid) ||
 			capable(CAP_SYSLOG);
+		mutex_init(&reader->mutex);
 
 		INIT_LIST_HEAD(&reader->list);
 
-		mutex_lock(&log->mutex);
+		spin_lock(&log->lock);
 		reader->r_off = log->head;
 		list_add_tail(&reader->list, &log->readers);
-		mutex_unlock(&log->mutex);
+		spin_unlock(&log->lock);
 
 		file->private_data = reader;
 	} else
@@ -532,7 +590,11 @@ static int logger_release(struct inode *ignored, struct file *file)
 {
 	if (file->f_mode & FMODE_READ) {
 		struct logger_reader *reader = file->private_data;
+		struct logger_log *log = reader->log;
+
+		spin_lock(&log->lock);
 		list_del(&reader->list);
+		spin_unlock(&log->lock);
 		kfree(reader);
 	}
 
@@ -562,18 +624,82 @@ static unsigned int logger_poll(struct file *file, poll_table *wait)
 
 	poll_wait(file, &log->wq, wait);
 
-	mutex_lock(&log->mutex);
+	spin_lock(&log->lock);
 	if (!reader->r_all)
 		reader->r_off = get_next_entry_by_uid(log,
 			reader->r_off, current_euid());
 
-	if (log->w_off != reader->r_off)
+	if (log->w_off != reader->r_off) {
 		ret |= POLLIN | POLLRDNORM;
-	mutex_unlock(&log->mutex);
+		/* mapped readers parse the ring themselves, report once */
+		if (reader->r_mapped)
+			reader->r_off = log->w_off;
+	}
+	spin_unlock(&log->lock);
 
 	return ret;
 }
 
+static unsigned long logger_buffer_pfn(struct logger_log *log, size_t off)
+{
+	void *addr = log->buffer + off;
+
+	if (is_vmalloc_or_module_addr(addr))
+		return vmalloc_to_pfn(addr);
+	return virt_to_phys(addr) >> PAGE_SHIFT;
+}
+
+/*
+ * logger_mmap - the log's mmap file operation
+ *
+ * Maps the header page followed by the ring read-only, see struct
+ * logger_mmap_header. Only readers allowed to see every entry may map the
+ * ring, as it is not filtered by uid.
+ */
+static int logger_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct logger_reader *reader;
+	struct logger_log *log;
+	unsigned long addr;
+	size_t off;
+	int ret;
+
+	if (!(file->f_mode & FMODE_READ))
+		return -EBADF;
+
+	reader = file->private_data;
+	log = reader->log;
+
+	if (!reader->r_all)
+		return -EPERM;
+	if (vma->vm_pgoff ||
+	    vma->vm_end - vma->vm_start > PAGE_SIZE + log->size)
+		return -EINVAL;
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	addr = vma->vm_start;
+	ret = remap_pfn_range(vma, addr,
+			      virt_to_phys(log->mmap_hdr) >> PAGE_SHIFT,
+			      PAGE_SIZE, vma->vm_page_prot);
+	addr += PAGE_SIZE;
+
+	for (off = 0; !ret && addr < vma->vm_end; off += PAGE_SIZE) {
+		ret = remap_pfn_range(vma, addr, logger_buffer_pfn(log, off),
+				      PAGE_SIZE, vma->vm_page_prot);
+		addr += PAGE_SIZE;
+	}
+	if (ret)
+		return ret;
+
+	spin_lock(&log->lock);
+	reader->r_mapped = true;
+	spin_unlock(&log->lock);
+
+	return 0;
+}
+
 static long logger_set_version(struct logger_reader *reader, void __user *arg)
 {
 	int version;
@@ -594,7 +720,18 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	long ret = -EINVAL;
 	void __user *argp = (void __user *) arg;
 
-	mutex_lock(&log->mutex);
+	/* this one copies from userspace, so it cannot run under log->lock */
+	if (cmd == LOGGER_SET_VERSION) {
+		if (!(file->f_mode & FMODE_READ))
+			return -EBADF;
+		reader = file->private_data;
+		mutex_lock(&reader->mutex);
+		ret = logger_set_version(reader, argp);
+		mutex_unlock(&reader->mutex);
+		return ret;
+	}
+
+	spin_lock(&log->lock);
 
 	switch (cmd) {
 	case LOGGER_GET_LOG_BUF_SIZE:
@@ -636,6 +773,7 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		list_for_each_entry(reader, &log->readers, list)
 			reader->r_off = log->w_off;
 		log->head = log->w_off;
+		log->mmap_hdr->head_pos = log->mmap_hdr->w_pos;
 		ret = 0;
 		break;
 	case LOGGER_GET_VERSION:
@@ -646,17 +784,9 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		reader = file->private_data;
 		ret = reader->r_ver;
 		break;
-	case LOGGER_SET_VERSION:
-		if (!(file->f_mode & FMODE_READ)) {
-			ret = -EBADF;
-			break;
-		}
-		reader = file->private_data;
-		ret = logger_set_version(reader, argp);
-		break;
 	}
 
-	mutex_unlock(&log->mutex);
+	spin_unlock(&log->lock);
 
 	return ret;
 }
@@ -666,6 +796,7 @@ static const struct file_operations logger_fops = {
 	.read = logger_read,
 	.aio_write = logger_aio_write,
 	.poll = logger_poll,
+	.mmap = logger_mmap,
 	.unlocked_ioctl = logger_ioctl,
 	.compat_ioctl = logger_ioctl,
 	.open = logger_open,
@@ -675,10 +806,11 @@ static const struct file_operations logger_fops = {
 /*
  * Defines a log structure with name 'NAME' and a size of 'SIZE' bytes, which
  * must be a power of two, and greater than
- * (LOGGER_ENTRY_MAX_PAYLOAD + sizeof(struct logger_entry)).
+ * (LOGGER_ENTRY_MAX_PAYLOAD + sizeof(struct logger_entry)). The buffer is
+ * page aligned so that it can be mapped to userspace.
  */
 #define DEFINE_LOGGER_DEVICE(VAR, NAME, SIZE) \
-static unsigned char _buf_ ## VAR[SIZE]; \
+static unsigned char _buf_ ## VAR[SIZE] __aligned(PAGE_SIZE); \
 static struct logger_log VAR = { \
 	.buffer = _buf_ ## VAR, \
 	.misc = { \
@@ -689,7 +821,7 @@ static struct logger_log VAR = { \
 	}, \
 	.wq = __WAIT_QUEUE_HEAD_INITIALIZER(VAR .wq), \
 	.readers = LIST_HEAD_INIT(VAR .readers), \
-	.mutex = __MUTEX_INITIALIZER(VAR .mutex), \
+	.lock = __SPIN_LOCK_UNLOCKED(VAR .lock), \
 	.w_off = 0, \
 	.head = 0, \
 	.size = SIZE, \
@@ -717,10 +849,20 @@ static int __init init_log(struct logger_log *log)
 {
 	int ret;
 
+	log->mmap_hdr = (void *) get_zeroed_page(GFP_KERNEL);
+	if (unlikely(!log->mmap_hdr))
+		return -ENOMEM;
+	log->mmap_hdr->magic = LOGGER_MMAP_MAGIC;
+	log->mmap_hdr->version = LOGGER_MMAP_VERSION;
+	log->mmap_hdr->hdr_size = sizeof(struct logger_entry);
+	log->mmap_hdr->data_offset = PAGE_SIZE;
+	log->mmap_hdr->size = log->size;
+
 	ret = misc_register(&log->misc);
 	if (unlikely(ret)) {
 		printk(KERN_ERR "logger: failed to register misc "
 		       "device for log '%s'!\n", log->misc.name);
+		free_page((unsigned long) log->mmap_hdr);
 		return ret;
 	}
 
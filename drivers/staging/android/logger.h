@@ -51,6 +51,32 @@ struct logger_entry {
 	char		msg[0];		/* the entry's payload */
 };
 
+/*
+ * The header page at the start of a log's read-only mmap(), followed by
+ * the ring itself at 'data_offset'. Entries are framed as in the version 2
+ * ABI: a struct logger_entry of 'hdr_size' bytes followed by 'len' bytes of
+ * payload, wrapping around the end of the ring.
+ *
+ * Positions are free-running byte counts, the ring offset of a position is
+ * pos & (size - 1). Entries in [head_pos, w_pos) are valid. A collector
+ * reads w_pos, parses entries up to it, then rereads head_pos: anything it
+ * parsed before head_pos may have been overwritten meanwhile and must be
+ * dropped, resuming at head_pos. poll() reports POLLIN once per batch of
+ * new entries.
+ */
+struct logger_mmap_header {
+	__u32		magic;		/* LOGGER_MMAP_MAGIC */
+	__u32		version;	/* LOGGER_MMAP_VERSION */
+	__u32		hdr_size;	/* sizeof(struct logger_entry) */
+	__u32		data_offset;	/* offset of the ring in the mapping */
+	__u32		size;		/* size of the ring, a power of two */
+	__u32		head_pos;	/* position of the oldest entry */
+	__u32		w_pos;		/* position of the next entry */
+};
+
+#define LOGGER_MMAP_MAGIC	0x4c4f474d	/* "LOGM" */
+#define LOGGER_MMAP_VERSION	1
+
 #define LOGGER_LOG_RADIO	"log_radio"	/* radio-related messages */
 #define LOGGER_LOG_EVENTS	"log_events"	/* system/hardware events */
 #define LOGGER_LOG_SYSTEM	"log_system"	/* system/framework messages */
@@ -16,6 +16,13 @@
  * percentage of the cached memory is locked this can be very inaccurate
  * and processes may not get killed until the normal oom killer is triggered.
  *
+ * Besides the shrinker, a kernel thread polls the same thresholds so that
+ * kills happen ahead of direct reclaim. While reclaim is inefficient (less
+ * than 100 - pressure_level percent of the scanned pages get reclaimed) the
+ * thresholds it uses are raised by pressure_margin percent. Kill counts by
+ * reason and the time from a kill to the victim being freed are reported in
+ * /sys/module/lowmemorykiller/parameters/stats.
+ *
  * Copyright (C) 2007-2008 Google, Inc.
  *
  * This software is licensed under the terms of the GNU General Public
@@ -35,6 +42,14 @@
 #include <linux/oom.h>
 #include <linux/sched.h>
 #include <linux/notifier.h>
+#include <linux/hash.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/ktime.h>
+#include <linux/swap.h>
+#include <linux/vmstat.h>
 
 static uint32_t lowmem_debug_level = 2;
 static int lowmem_adj[6] = {
@@ -54,6 +69,66 @@ static int lowmem_minfree_size = 4;
 
 static struct task_struct *lowmem_deathpending;
 static unsigned long lowmem_deathpending_timeout;
+static DEFINE_MUTEX(lowmem_kill_lock);
+
+static int lowmem_proactive = 1;
+static uint32_t lowmem_pressure_level = 60;	/* % of scanned not reclaimed */
+static uint32_t lowmem_pressure_margin = 25;	/* % added to minfree */
+
+/* below this many scanned pages per poll, reclaim efficiency is noise */
+#define LOWMEM_PRESSURE_MIN_SCAN	(SWAP_CLUSTER_MAX * 16)
+
+static struct task_struct *lowmem_task;
+static DECLARE_WAIT_QUEUE_HEAD(lowmem_wait);
+static bool lowmem_wakeup;
+/* set while the thread waits without a timeout for reclaim to start */
+static bool lowmem_idle;
+
+enum lowmem_kill_reason {
+	LOWMEM_KILL_SHRINKER,
+	LOWMEM_KILL_WATERMARK,
+	LOWMEM_KILL_PRESSURE,
+	LOWMEM_KILL_REASONS
+};
+
+static const char * const lowmem_kill_reason_names[] = {
+	"shrinker",
+	"watermark",
+	"pressure",
+};
+
+static unsigned int lowmem_kills[LOWMEM_KILL_REASONS];
+static ktime_t lowmem_kill_time;
+static unsigned int lowmem_free_us_last;
+static unsigned int lowmem_free_us_max;
+static u64 lowmem_free_us_total;
+static unsigned int lowmem_free_count;
+
+/*
+ * Index of the candidate processes, so that picking a victim only looks at
+ * the highest populated oom_adj buckets instead of every task. Thread group
+ * leaders are added at fork and exec, moved when their oom_adj changes and
+ * dropped when their task_struct is freed, which is what keeps the task
+ * pointers valid while lowmem_index_lock is held.
+ *
+ * Should an entry ever fail to be allocated, the index is no longer
+ * trusted and victims are picked by walking all tasks as before.
+ */
+#define LOWMEM_ADJ_BUCKETS	(OOM_ADJUST_MAX - OOM_DISABLE + 1)
+#define LOWMEM_HASH_BITS	6
+
+struct lowmem_entry {
+	struct hlist_node	hash;	/* in lowmem_hash, by task */
+	struct list_head	list;	/* in lowmem_buckets, by adj */
+	struct task_struct	*task;	/* thread group leader */
+	int			adj;
+};
+
+static struct list_head lowmem_buckets[LOWMEM_ADJ_BUCKETS];
+static struct hlist_head lowmem_hash[1 << LOWMEM_HASH_BITS];
+static DEFINE_SPINLOCK(lowmem_index_lock);
+static struct kmem_cache *lowmem_entry_cachep;
+static bool lowmem_index_incomplete;
 
 #define lowmem_print(level, x...)			\
 	do {						\
@@ -68,68 +143,164 @@ static struct notifier_block task_nb = {
 	.notifier_call	= task_notify_func,
 };
 
+static struct lowmem_entry *lowmem_find_entry(struct task_struct *task)
+{
+	struct lowmem_entry *entry;
+	struct hlist_node *node;
+
+	hlist_for_each_entry(entry, node,
+			     &lowmem_hash[hash_ptr(task, LOWMEM_HASH_BITS)], hash)
+		if (entry->task == task)
+			return entry;
+	return NULL;
+}
+
+static void lowmem_index_update(struct task_struct *task, gfp_t gfp_mask)
+{
+	struct lowmem_entry *entry;
+	struct lowmem_entry *new = NULL;
+	unsigned long flags;
+	int adj;
+
+	task = task->group_leader;
+	if (task->flags & PF_KTHREAD)
+		return;
+
+	spin_lock_irqsave(&lowmem_index_lock, flags);
+	entry = lowmem_find_entry(task);
+	if (!entry) {
+		spin_unlock_irqrestore(&lowmem_index_lock, flags);
+		new = kmem_cache_alloc(lowmem_entry_cachep, gfp_mask);
+		spin_lock_irqsave(&lowmem_index_lock, flags);
+		entry = lowmem_find_entry(task);
+		if (!entry) {
+			if (!new) {
+				lowmem_index_incomplete = true;
+				goto out;
+			}
+			entry = new;
+			new = NULL;
+			entry->task = task;
+			hlist_add_head(&entry->hash,
+				&lowmem_hash[hash_ptr(task, LOWMEM_HASH_BITS)]);
+			INIT_LIST_HEAD(&entry->list);
+		}
+	}
+	adj = clamp_t(int, task->signal->oom_adj, OOM_DISABLE, OOM_ADJUST_MAX);
+	entry->adj = adj;
+	list_move(&entry->list, &lowmem_buckets[adj - OOM_DISABLE]);
+out:
+	spin_unlock_irqrestore(&lowmem_index_lock, flags);
+	if (new)
+		kmem_cache_free(lowmem_entry_cachep, new);
+}
+
+static int
+oom_adj_notify_func(struct notifier_block *self, unsigned long val,
+		    void *data)
+{
+	lowmem_index_update(data, GFP_KERNEL);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block oom_adj_nb = {
+	.notifier_call	= oom_adj_notify_func,
+};
+
 static int
 task_notify_func(struct notifier_block *self, unsigned long val, void *data)
 {
 	struct task_struct *task = data;
+	struct lowmem_entry *entry;
+	unsigned long flags;
+
+	if (task == lowmem_deathpending) {
+		unsigned int us = ktime_to_us(ktime_sub(ktime_get(),
+							lowmem_kill_time));
 
-	if (task == lowmem_deathpending)
+		lowmem_free_us_last = us;
+		if (us > lowmem_free_us_max)
+			lowmem_free_us_max = us;
+		lowmem_free_us_total += us;
+		lowmem_free_count++;
 		lowmem_deathpending = NULL;
+		/* the thread may go on killing right away */
+		lowmem_wakeup = true;
+		wake_up(&lowmem_wait);
+	}
+
+	spin_lock_irqsave(&lowmem_index_lock, flags);
+	entry = lowmem_find_entry(task);
+	if (entry) {
+		hlist_del(&entry->hash);
+		list_del(&entry->list);
+	}
+	spin_unlock_irqrestore(&lowmem_index_lock, flags);
+	if (entry)
+		kmem_cache_free(lowmem_entry_cachep, entry);
 
 	return NOTIFY_OK;
 }
 
-static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
+/*
+ * lowmem_select_indexed - pick the biggest process of the highest populated
+ * oom_adj bucket at or above min_adj. Returns it with a reference held.
+ */
+static struct task_struct *lowmem_select_indexed(int min_adj, int *oom_adj,
+						 int *size)
 {
-	struct task_struct *p;
 	struct task_struct *selected = NULL;
-	int rem = 0;
-	int tasksize;
-	int i;
-	int min_adj = OOM_ADJUST_MAX + 1;
-	int selected_tasksize = 0;
-	int selected_oom_adj;
-	int array_size = ARRAY_SIZE(lowmem_adj);
-	int other_free = global_page_state(NR_FREE_PAGES);
-	int other_file = global_page_state(NR_FILE_PAGES) -
-						global_page_state(NR_SHMEM);
+	struct lowmem_entry *entry;
+	unsigned long flags;
+	int adj;
 
-	/*
-	 * If we already have a death outstanding, then
-	 * bail out right away; indicating to vmscan
-	 * that we have nothing further to offer on
-	 * this pass.
-	 *
-	 */
-	if (lowmem_deathpending &&
-	    time_before_eq(jiffies, lowmem_deathpending_timeout))
-		return 0;
+	*size = 0;
+	spin_lock_irqsave(&lowmem_index_lock, flags);
+	for (adj = OOM_ADJUST_MAX; adj >= max(min_adj, OOM_DISABLE); adj--) {
+		list_for_each_entry(entry, &lowmem_buckets[adj - OOM_DISABLE],
+				    list) {
+			struct task_struct *p = entry->task;
+			int tasksize = 0;
 
-	if (lowmem_adj_size < array_size)
-		array_size = lowmem_adj_size;
-	if (lowmem_minfree_size < array_size)
-		array_size = lowmem_minfree_size;
-	for (i = 0; i < array_size; i++) {
-		if (other_free < lowmem_minfree[i] &&
-		    other_file < lowmem_minfree[i]) {
-			min_adj = lowmem_adj[i];
-			break;
+			/*
+			 * Tasks are freed from RCU callbacks, which may have
+			 * interrupted a task_lock() holder: never spin on it
+			 * under lowmem_index_lock.
+			 */
+			if (!spin_trylock(&p->alloc_lock))
+				continue;
+			if (p->mm)
+				tasksize = get_mm_rss(p->mm);
+			task_unlock(p);
+			if (tasksize <= *size)
+				continue;
+			selected = p;
+			*size = tasksize;
+			*oom_adj = adj;
+			lowmem_print(2, "select %d (%s), adj %d, size %d, "
+				     "to kill\n", p->pid, p->comm, adj, tasksize);
 		}
+		if (selected)
+			break;
 	}
-	if (sc->nr_to_scan > 0)
-		lowmem_print(3, "lowmem_shrink %lu, %x, ofree %d %d, ma %d\n",
-			     sc->nr_to_scan, sc->gfp_mask, other_free, other_file,
-			     min_adj);
-	rem = global_page_state(NR_ACTIVE_ANON) +
-		global_page_state(NR_ACTIVE_FILE) +
-		global_page_state(NR_INACTIVE_ANON) +
-		global_page_state(NR_INACTIVE_FILE);
-	if (sc->nr_to_scan <= 0 || min_adj == OOM_ADJUST_MAX + 1) {
-		lowmem_print(5, "lowmem_shrink %lu, %x, return %d\n",
-			     sc->nr_to_scan, sc->gfp_mask, rem);
-		return rem;
-	}
-	selected_oom_adj = min_adj;
+	if (selected)
+		get_task_struct(selected);
+	spin_unlock_irqrestore(&lowmem_index_lock, flags);
+
+	return selected;
+}
+
+/*
+ * lowmem_select_scan - same as lowmem_select_indexed, by walking all tasks.
+ */
+static struct task_struct *lowmem_select_scan(int min_adj, int *oom_adj,
+					      int *size)
+{
+	struct task_struct *p;
+	struct task_struct *selected = NULL;
+	int tasksize;
+	int selected_tasksize = 0;
+	int selected_oom_adj = min_adj;
 
 	read_lock(&tasklist_lock);
 	for_each_process(p) {
@@ -166,21 +337,230 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 		lowmem_print(2, "select %d (%s), adj %d, size %d, to kill\n",
 			     p->pid, p->comm, oom_adj, tasksize);
 	}
+	if (selected)
+		get_task_struct(selected);
+	read_unlock(&tasklist_lock);
+
+	*oom_adj = selected_oom_adj;
+	*size = selected_tasksize;
+	return selected;
+}
+
+/*
+ * lowmem_min_adj - the lowest oom_adj to kill at for the given amount of
+ * free and file pages, with the minfree thresholds raised by 'margin'
+ * percent. Returns OOM_ADJUST_MAX + 1 if nothing needs to be killed.
+ */
+static int lowmem_min_adj(int other_free, int other_file, int margin)
+{
+	int array_size = ARRAY_SIZE(lowmem_adj);
+	int i;
+
+	if (lowmem_adj_size < array_size)
+		array_size = lowmem_adj_size;
+	if (lowmem_minfree_size < array_size)
+		array_size = lowmem_minfree_size;
+	for (i = 0; i < array_size; i++) {
+		int minfree = lowmem_minfree[i] +
+			lowmem_minfree[i] * margin / 100;
+
+		if (other_free < minfree && other_file < minfree)
+			return lowmem_adj[i];
+	}
+	return OOM_ADJUST_MAX + 1;
+}
+
+static bool lowmem_deathpending_active(void)
+{
+	return lowmem_deathpending &&
+	       time_before_eq(jiffies, lowmem_deathpending_timeout);
+}
+
+/*
+ * lowmem_kill - kill the best candidate at or above min_adj. Returns its
+ * size in pages, 0 if there was none or another kill is still pending.
+ */
+static int lowmem_kill(int min_adj, enum lowmem_kill_reason reason)
+{
+	struct task_struct *selected;
+	int selected_tasksize = 0;
+	int selected_oom_adj;
+
+	/* the shrinker must not wait for the thread, nor the other way */
+	if (!mutex_trylock(&lowmem_kill_lock))
+		return 0;
+
+	/*
+	 * If we already have a death outstanding, then
+	 * bail out right away; indicating to vmscan
+	 * that we have nothing further to offer on
+	 * this pass.
+	 *
+	 */
+	if (lowmem_deathpending_active())
+		goto out;
+
+	if (unlikely(lowmem_index_incomplete))
+		selected = lowmem_select_scan(min_adj, &selected_oom_adj,
+					      &selected_tasksize);
+	else
+		selected = lowmem_select_indexed(min_adj, &selected_oom_adj,
+						 &selected_tasksize);
 	if (selected) {
-		lowmem_print(1, "send sigkill to %d (%s), adj %d, size %d\n",
-			     selected->pid, selected->comm,
-			     selected_oom_adj, selected_tasksize);
+		lowmem_print(1, "send sigkill to %d (%s), adj %d, size %d, "
+			     "%s\n", selected->pid, selected->comm,
+			     selected_oom_adj, selected_tasksize,
+			     lowmem_kill_reason_names[reason]);
+		lowmem_kills[reason]++;
+		lowmem_kill_time = ktime_get();
 		lowmem_deathpending = selected;
 		lowmem_deathpending_timeout = jiffies + HZ;
-		force_sig(SIGKILL, selected);
-		rem -= selected_tasksize;
+		/* a task that exited meanwhile has no sighand left */
+		read_lock(&tasklist_lock);
+		if (selected->sighand)
+			force_sig(SIGKILL, selected);
+		read_unlock(&tasklist_lock);
+		put_task_struct(selected);
 	}
+out:
+	mutex_unlock(&lowmem_kill_lock);
+	return selected_tasksize;
+}
+
+static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
+{
+	int rem = 0;
+	int min_adj;
+	int other_free = global_page_state(NR_FREE_PAGES);
+	int other_file = global_page_state(NR_FILE_PAGES) -
+						global_page_state(NR_SHMEM);
+
+	/* reclaim is running, have an idle thread start sampling pressure */
+	if (sc->nr_to_scan > 0 && lowmem_idle) {
+		lowmem_idle = false;
+		lowmem_wakeup = true;
+		wake_up(&lowmem_wait);
+	}
+
+	if (lowmem_deathpending_active())
+		return 0;
+
+	min_adj = lowmem_min_adj(other_free, other_file, 0);
+	if (sc->nr_to_scan > 0)
+		lowmem_print(3, "lowmem_shrink %lu, %x, ofree %d %d, ma %d\n",
+			     sc->nr_to_scan, sc->gfp_mask, other_free, other_file,
+			     min_adj);
+	rem = global_page_state(NR_ACTIVE_ANON) +
+		global_page_state(NR_ACTIVE_FILE) +
+		global_page_state(NR_INACTIVE_ANON) +
+		global_page_state(NR_INACTIVE_FILE);
+	if (sc->nr_to_scan <= 0 || min_adj == OOM_ADJUST_MAX + 1) {
+		lowmem_print(5, "lowmem_shrink %lu, %x, return %d\n",
+			     sc->nr_to_scan, sc->gfp_mask, rem);
+		return rem;
+	}
+
+	/* reclaim got here first, make sure the thread polls closely */
+	if (lowmem_task) {
+		lowmem_wakeup = true;
+		wake_up(&lowmem_wait);
+	}
+
+	rem -= lowmem_kill(min_adj, LOWMEM_KILL_SHRINKER);
 	lowmem_print(4, "lowmem_shrink %lu, %x, return %d\n",
 		     sc->nr_to_scan, sc->gfp_mask, rem);
-	read_unlock(&tasklist_lock);
 	return rem;
 }
 
+/*
+ * lowmem_pressure - percentage of the pages scanned by reclaim since the
+ * last call that could not be reclaimed, 0 if too few were scanned to tell.
+ */
+static int lowmem_pressure(void)
+{
+#ifdef CONFIG_VM_EVENT_COUNTERS
+	static unsigned long last_scanned, last_reclaimed;
+	unsigned long events[NR_VM_EVENT_ITEMS];
+	unsigned long scanned = 0, reclaimed = 0;
+	int i;
+
+	all_vm_events(events);
+	for (i = 0; i < MAX_NR_ZONES; i++) {
+		scanned += events[PGSCAN_KSWAPD_NORMAL - ZONE_NORMAL + i] +
+			   events[PGSCAN_DIRECT_NORMAL - ZONE_NORMAL + i];
+		reclaimed += events[PGSTEAL_NORMAL - ZONE_NORMAL + i];
+	}
+
+	i = 0;
+	if (scanned - last_scanned >= LOWMEM_PRESSURE_MIN_SCAN &&
+	    reclaimed - last_reclaimed < scanned - last_scanned)
+		i = 100 - (reclaimed - last_reclaimed) * 100 /
+			(scanned - last_scanned);
+	last_scanned = scanned;
+	last_reclaimed = reclaimed;
+	return i;
+#else
+	return 0;
+#endif
+}
+
+static int lowmem_thread(void *unused)
+{
+	long timeout = MAX_SCHEDULE_TIMEOUT;
+
+	set_freezable();
+	while (!kthread_should_stop()) {
+		int other_free, other_file, min_adj, pressure, margin;
+		enum lowmem_kill_reason reason = LOWMEM_KILL_WATERMARK;
+
+		lowmem_idle = timeout == MAX_SCHEDULE_TIMEOUT;
+		wait_event_freezable_timeout(lowmem_wait,
+			lowmem_wakeup || kthread_should_stop(), timeout);
+		lowmem_wakeup = false;
+		lowmem_idle = false;
+		if (!lowmem_proactive) {
+			timeout = MAX_SCHEDULE_TIMEOUT;
+			continue;
+		}
+
+		other_free = global_page_state(NR_FREE_PAGES);
+		other_file = global_page_state(NR_FILE_PAGES) -
+			global_page_state(NR_SHMEM);
+		pressure = lowmem_pressure();
+
+		margin = 0;
+		min_adj = lowmem_min_adj(other_free, other_file, 0);
+		if (min_adj == OOM_ADJUST_MAX + 1 &&
+		    pressure >= lowmem_pressure_level) {
+			margin = lowmem_pressure_margin;
+			min_adj = lowmem_min_adj(other_free, other_file,
+						 margin);
+			reason = LOWMEM_KILL_PRESSURE;
+		}
+
+		/*
+		 * Poll closely while within twice the thresholds, keep
+		 * sampling reclaim efficiency while reclaim runs and otherwise
+		 * sleep until the shrinker or a dying victim wakes us.
+		 */
+		if (lowmem_min_adj(other_free, other_file, 100 + margin) !=
+		    OOM_ADJUST_MAX + 1)
+			timeout = HZ / 10;
+		else if (pressure)
+			timeout = HZ;
+		else
+			timeout = MAX_SCHEDULE_TIMEOUT;
+
+		if (min_adj == OOM_ADJUST_MAX + 1)
+			continue;
+		lowmem_print(3, "lowmem_thread ofree %d %d, pressure %d, "
+			     "ma %d\n", other_free, other_file, pressure,
+			     min_adj);
+		lowmem_kill(min_adj, reason);
+	}
+	return 0;
+}
+
 static struct shrinker lowmem_shrinker = {
 	.shrink = lowmem_shrink,
 	.seeks = DEFAULT_SEEKS * 16
@@ -188,15 +568,50 @@ static struct shrinker lowmem_shrinker = {
 
 static int __init lowmem_init(void)
 {
+	struct task_struct *p;
+	int i;
+
+	lowmem_entry_cachep = KMEM_CACHE(lowmem_entry, 0);
+	if (!lowmem_entry_cachep)
+		return -ENOMEM;
+	for (i = 0; i < LOWMEM_ADJ_BUCKETS; i++)
+		INIT_LIST_HEAD(&lowmem_buckets[i]);
+
 	task_free_register(&task_nb);
+	register_oom_adj_notifier(&oom_adj_nb);
+
+	/* index what is already running, later changes come from oom_adj_nb */
+	read_lock(&tasklist_lock);
+	for_each_process(p)
+		lowmem_index_update(p, GFP_ATOMIC);
+	read_unlock(&tasklist_lock);
+
 	register_shrinker(&lowmem_shrinker);
+
+	lowmem_task = kthread_run(lowmem_thread, NULL, "lowmemorykiller");
+	if (IS_ERR(lowmem_task)) {
+		printk(KERN_WARNING "lowmemorykiller: no thread, only "
+		       "killing from the shrinker\n");
+		lowmem_task = NULL;
+	}
 	return 0;
 }
 
 static void __exit lowmem_exit(void)
 {
+	struct lowmem_entry *entry, *tmp;
+	int i;
+
+	if (lowmem_task)
+		kthread_stop(lowmem_task);
 	unregister_shrinker(&lowmem_shrinker);
+	unregister_oom_adj_notifier(&oom_adj_nb);
 	task_free_unregister(&task_nb);
+
+	for (i = 0; i < LOWMEM_ADJ_BUCKETS; i++)
+		list_for_each_entry_safe(entry, tmp, &lowmem_buckets[i], list)
+			kmem_cache_free(lowmem_entry_cachep, entry);
+	kmem_cache_destroy(lowmem_entry_cachep);
 }
 
 module_param_named(cost, lowmem_shrinker.seeks, int, S_IRUGO | S_IWUSR);
@@ -205,6 +620,28 @@ module_param_array_named(adj, lowmem_adj, int, &lowmem_adj_size,
 module_param_array_named(minfree, lowmem_minfree, uint, &lowmem_minfree_size,
 			 S_IRUGO | S_IWUSR);
 module_param_named(debug_level, lowmem_debug_level, uint, S_IRUGO | S_IWUSR);
+module_param_named(proactive, lowmem_proactive, bool, S_IRUGO | S_IWUSR);
+module_param_named(pressure_level, lowmem_pressure_level, uint,
+		   S_IRUGO | S_IWUSR);
+module_param_named(pressure_margin, lowmem_pressure_margin, uint,
+		   S_IRUGO | S_IWUSR);
+
+static int lowmem_get_stats(char *buffer, struct kernel_param *kp)
+{
+	int len = 0;
+	int i;
+
+	for (i = 0; i < LOWMEM_KILL_REASONS; i++)
+		len += sprintf(buffer + len, "%s %u ",
+			       lowmem_kill_reason_names[i], lowmem_kills[i]);
+	len += sprintf(buffer + len, "kill_to_free_us last %u avg %llu "
+		       "max %u", lowmem_free_us_last,
+		       lowmem_free_count ?
+		       div_u64(lowmem_free_us_total, lowmem_free_count) : 0,
+		       lowmem_free_us_max);
+	return len;
+}
+module_param_call(stats, NULL, lowmem_get_stats, NULL, S_IRUGO);
 
 module_init(lowmem_init);
 module_exit(lowmem_exit);
@@ -16,6 +16,7 @@
 */
 
 #include <linux/err.h>
+#include <linux/math64.h>
 #include <linux/module.h>
 #include <linux/reboot.h>
 #include <linux/slab.h>
@@ -43,6 +44,9 @@
 #define HYSTERESIS_VALUE 2000
 #define NORMAL_TEMP_MONITORING_RATE 1000
 #define FAST_TEMP_MONITORING_RATE 250
+#define SLOW_TEMP_MONITORING_RATE 4000
+#define AVERAGE_FAR_MARGIN 10000
+#define AVERAGE_NEAR_MARGIN 2000
 #define DECREASE_MPU_FREQ_PERIOD 2000
 
 #define OMAP_GRADIENT_SLOPE_4460    348
@@ -72,6 +76,12 @@ struct omap_die_governor {
 	int average_period;
 	int avg_cpu_sensor_temp;
 	int avg_is_valid;
+	int avg_samples;
+	unsigned long avg_stamp;
+	int hotspot_temp;
+	int die_temp_lower;
+	int die_temp_upper;
+	bool die_temp_thresh_set;
 	struct delayed_work average_cpu_sensor_work;
 	struct delayed_work decrease_mpu_freq_work;
 	int gradient_slope;
@@ -115,7 +125,21 @@ static struct omap_thermal_zone omap_thermal_zones[] = {
 };
 static struct thermal_dev *therm_fw;
 static struct omap_die_governor *omap_gov;
-static int cpu_sensor_temp_table[AVERAGE_NUMBER];
+
+static int average_slow_period = SLOW_TEMP_MONITORING_RATE;
+module_param(average_slow_period, int, 0644);
+MODULE_PARM_DESC(average_slow_period,
+	"Averaging period in ms when far from the next zone boundary");
+
+static int average_far_margin = AVERAGE_FAR_MARGIN;
+module_param(average_far_margin, int, 0644);
+MODULE_PARM_DESC(average_far_margin,
+	"Hot spot margin in mC above which the slow period is used");
+
+static int average_near_margin = AVERAGE_NEAR_MARGIN;
+module_param(average_near_margin, int, 0644);
+MODULE_PARM_DESC(average_near_margin,
+	"Hot spot margin in mC below which the zone period is used");
 
 /**
  * DOC: Introduction
@@ -159,6 +183,16 @@ static int cpu_sensor_temp_table[AVERAGE_NUMBER];
  *
  * NO_ACTION: Means just that.  There was no action taken based on the current
  * temperature sent in.
+ *
+ * Zone changes are driven by the on-die sensor threshold interrupts, which
+ * call into the governor through process_temp.  The only periodic work is
+ * the on-die temperature average used for the PCB based gradient.  It is
+ * an exponential moving average weighted by the time between samples, so
+ * its window stays AVERAGE_NUMBER zone periods long whatever the sampling
+ * period is.  The sampling period itself adapts to the distance between
+ * the hot spot and the upper boundary of the current zone: it stretches to
+ * average_slow_period when the device is far from the boundary and shrinks
+ * to the zone average_rate when it gets within average_near_margin.
 */
 
 /**
@@ -250,13 +284,85 @@ static signed hotspot_temp_to_sensor_temp(int hot_spot_temp)
 			(1000 + omap_gov->gradient_slope);
 }
 
+/*
+ * omap_update_temp_thresh() - Program the on-die sensor thresholds matching
+ *		the current hot spot zone boundaries.
+ *
+ * @force: Program the thresholds even if they did not change. This is
+ *	needed after a threshold interrupt since the sensor masks the
+ *	direction which fired until the thresholds are set again.
+ */
+static void omap_update_temp_thresh(bool force)
+{
+	int temp_lower;
+	int temp_upper;
+
+	temp_lower = hotspot_temp_to_sensor_temp(omap_gov->hotspot_temp_lower);
+	temp_upper = hotspot_temp_to_sensor_temp(omap_gov->hotspot_temp_upper);
+
+	if (!force && omap_gov->die_temp_thresh_set &&
+	    temp_lower == omap_gov->die_temp_lower &&
+	    temp_upper == omap_gov->die_temp_upper)
+		return;
+
+	thermal_device_call(omap_gov->temp_sensor, set_temp_thresh, temp_lower,
+								temp_upper);
+	omap_gov->die_temp_lower = temp_lower;
+	omap_gov->die_temp_upper = temp_upper;
+	omap_gov->die_temp_thresh_set = true;
+}
+
+/*
+ * omap_average_period() - Compute the next on-die averaging period
+ *
+ * Without a PCB sensor the average does not feed the gradient, so it is
+ * only refreshed at the slow period.  Otherwise the period is interpolated
+ * between the zone average_rate, when the hot spot is within
+ * average_near_margin of the zone upper boundary, and average_slow_period,
+ * when it is more than average_far_margin away.
+ *
+ * Returns the period in ms
+ */
+static int omap_average_period(void)
+{
+	int fast = NORMAL_TEMP_MONITORING_RATE;
+	int slow, margin, near, far;
+
+	if (omap_gov->prev_zone != NO_ACTION)
+		fast = omap_thermal_zones[omap_gov->prev_zone - 1].average_rate;
+
+	slow = max(average_slow_period, fast);
+
+	if (thermal_lookup_temp("pcb") < 0)
+		return slow;
+
+	if (!omap_gov->avg_is_valid || omap_gov->prev_zone == NO_ACTION)
+		return fast;
+
+	near = max(average_near_margin, 0);
+	far = max(average_far_margin, near + 1);
+	margin = omap_gov->hotspot_temp_upper - omap_gov->hotspot_temp;
+
+	if (margin <= near)
+		return fast;
+	if (margin >= far)
+		return slow;
+
+	return fast + (slow - fast) * (margin - near) / (far - near);
+}
+
+static void omap_rearm_average(void)
+{
+	omap_gov->average_period = omap_average_period();
+	cancel_delayed_work(&omap_gov->average_cpu_sensor_work);
+	schedule_delayed_work(&omap_gov->average_cpu_sensor_work,
+				msecs_to_jiffies(omap_gov->average_period));
+}
+
 static int omap_enter_zone(struct omap_thermal_zone *zone,
 				bool set_cooling_level,
 				struct list_head *cooling_list, int cpu_temp)
 {
-	int temp_upper;
-	int temp_lower;
-
 	if (list_empty(cooling_list)) {
 		pr_err("%s: No Cooling devices registered\n",
 			__func__);
@@ -273,13 +379,8 @@ static int omap_enter_zone(struct omap_thermal_zone *zone,
 	}
 	omap_gov->hotspot_temp_lower = zone->temp_lower;
 	omap_gov->hotspot_temp_upper = zone->temp_upper;
-	temp_lower = hotspot_temp_to_sensor_temp(omap_gov->hotspot_temp_lower);
-	temp_upper = hotspot_temp_to_sensor_temp(omap_gov->hotspot_temp_upper);
-	thermal_device_call(omap_gov->temp_sensor, set_temp_thresh, temp_lower,
-								temp_upper);
+	omap_update_temp_thresh(true);
 	omap_update_report_rate(omap_gov->temp_sensor, zone->update_rate);
-	if (thermal_lookup_temp("pcb") >= 0)
-		omap_gov->average_period = zone->average_rate;
 
 	return 0;
 }
@@ -312,6 +413,7 @@ static int omap_cpu_thermal_manager(struct list_head *cooling_list, int temp)
 
 	omap_gov->sensor_temp = temp;
 	cpu_temp = convert_omap_sensor_temp_to_hotspot_temp(temp);
+	omap_gov->hotspot_temp = cpu_temp;
 
 	if (cpu_temp >= OMAP_FATAL_TEMP) {
 		omap_fatal_zone(cpu_temp);
@@ -363,6 +465,7 @@ static int omap_cpu_thermal_manager(struct list_head *cooling_list, int temp)
 
 	if (zone != NO_ACTION) {
 		struct omap_thermal_zone *therm_zone;
+		bool zone_changed = omap_gov->prev_zone != zone;
 
 		therm_zone = &omap_thermal_zones[zone - 1];
 		if (omap_gov->panic_zone_reached)
@@ -383,6 +486,13 @@ static int omap_cpu_thermal_manager(struct list_head *cooling_list, int temp)
 		}
 		omap_enter_zone(therm_zone, set_cooling_level,
 				cooling_list, cpu_temp);
+
+		/*
+		 * The boundaries moved, so the pending averaging period
+		 * may now be far too long (or needlessly short).
+		 */
+		if (zone_changed || zone == PANIC_ZONE)
+			omap_rearm_average();
 	}
 
 	return zone;
@@ -404,13 +514,13 @@ static void decrease_mpu_freq_fn(struct work_struct *work)
  * this is helpful to handle burst activity of OMAP when extrapolating
  * the OMAP hot spot temperature from on-die sensor and PCB temperature
  * Re-evaluate the temperature gradient between hot spot and on-die sensor
- * (See absolute_delta) and reconfigure the thresholds if needed
+ * (See absolute_delta) and reconfigure the thresholds if they moved
  */
 static void average_on_die_temperature(void)
 {
-	int i;
-	int die_temp_lower = 0;
-	int die_temp_upper = 0;
+	unsigned long now = jiffies;
+	int window = NORMAL_TEMP_MONITORING_RATE;
+	int elapsed;
 
 	if (omap_gov->temp_sensor == NULL)
 		return;
@@ -422,37 +532,40 @@ static void average_on_die_temperature(void)
 	if (omap_gov->sensor_temp == -EINVAL)
 		return;
 
-	/* Update historical buffer */
-	for (i = 1; i < AVERAGE_NUMBER; i++) {
-		cpu_sensor_temp_table[AVERAGE_NUMBER - i] =
-		cpu_sensor_temp_table[AVERAGE_NUMBER - i - 1];
-	}
-	cpu_sensor_temp_table[0] = omap_gov->sensor_temp;
-
-	if (cpu_sensor_temp_table[AVERAGE_NUMBER - 1] == 0)
-		omap_gov->avg_is_valid = 0;
-	else
-		omap_gov->avg_is_valid = 1;
+	/*
+	 * Exponential moving average weighted by the time since the last
+	 * sample, with a window of AVERAGE_NUMBER zone averaging periods.
+	 */
+	if (omap_gov->prev_zone != NO_ACTION)
+		window = omap_thermal_zones[omap_gov->prev_zone - 1].average_rate;
+	window *= AVERAGE_NUMBER;
 
-	/* Compute the new average value */
-	omap_gov->avg_cpu_sensor_temp = 0;
-	for (i = 0; i < AVERAGE_NUMBER; i++)
-		omap_gov->avg_cpu_sensor_temp += cpu_sensor_temp_table[i];
+	if (omap_gov->avg_samples == 0) {
+		omap_gov->avg_cpu_sensor_temp = omap_gov->sensor_temp;
+	} else {
+		elapsed = jiffies_to_msecs(now - omap_gov->avg_stamp);
+		if (elapsed >= window)
+			omap_gov->avg_cpu_sensor_temp = omap_gov->sensor_temp;
+		else
+			omap_gov->avg_cpu_sensor_temp += div_s64((s64)
+				(omap_gov->sensor_temp -
+				 omap_gov->avg_cpu_sensor_temp) * elapsed,
+				window);
+	}
+	omap_gov->avg_stamp = now;
 
-	omap_gov->avg_cpu_sensor_temp =
-		(omap_gov->avg_cpu_sensor_temp / AVERAGE_NUMBER);
+	if (omap_gov->avg_samples < AVERAGE_NUMBER)
+		omap_gov->avg_samples++;
+	omap_gov->avg_is_valid = omap_gov->avg_samples >= AVERAGE_NUMBER;
 
 	/*
 	 * Reconfigure the current temperature thresholds according
 	 * to the current PCB temperature
 	 */
-	convert_omap_sensor_temp_to_hotspot_temp(omap_gov->sensor_temp);
-	die_temp_lower = hotspot_temp_to_sensor_temp(
-		omap_gov->hotspot_temp_lower);
-	die_temp_upper = hotspot_temp_to_sensor_temp(
-		omap_gov->hotspot_temp_upper);
-	thermal_device_call(omap_gov->temp_sensor, set_temp_thresh,
-					die_temp_lower, die_temp_upper);
+	omap_gov->hotspot_temp =
+		convert_omap_sensor_temp_to_hotspot_temp(omap_gov->sensor_temp);
+	if (omap_gov->prev_zone != NO_ACTION)
+		omap_update_temp_thresh(false);
 
 	return;
 }
@@ -465,6 +578,7 @@ static void average_cpu_sensor_delayed_work_fn(struct work_struct *work)
 
 	average_on_die_temperature();
 
+	omap_gov->average_period = omap_average_period();
 	schedule_delayed_work(&omap_gov->average_cpu_sensor_work,
 				msecs_to_jiffies(omap_gov->average_period));
 }
@@ -488,6 +602,9 @@ static int omap_die_pm_notifier_cb(struct notifier_block *notifier,
 		cancel_delayed_work_sync(&omap_gov->decrease_mpu_freq_work);
 		break;
 	case PM_POST_SUSPEND:
+		/* The average is stale after suspend, start it over */
+		omap_gov->avg_samples = 0;
+		omap_gov->avg_is_valid = 0;
 		schedule_work(&omap_gov->average_cpu_sensor_work.work);
 		break;
 	}
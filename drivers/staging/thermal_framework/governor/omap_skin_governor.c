@@ -0,0 +1,529 @@
+/*
+ * drivers/staging/thermal_framework/governor/omap_skin_governor.c
+ *
+ * Skin temperature governor
+ *
+ * Fuses the board temperature sensors into an estimate of the outer
+ * (skin) temperature of the device and shares one cooling demand between
+ * all the cooling agents of the "skin" domain.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+*/
+
+#include <linux/err.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/types.h>
+#include <linux/jiffies.h>
+#include <linux/mutex.h>
+#include <linux/suspend.h>
+#include <linux/workqueue.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/thermal_framework.h>
+
+#define SKIN_DOMAIN		"skin"
+
+/* Cooling agents of the skin domain are driven with 0..SKIN_THROTTLE_MAX */
+#define SKIN_THROTTLE_MAX	1000
+
+/* All temperatures are in milli-celsius, all periods in ms */
+#define SKIN_LIMIT_TEMP		41000
+#define SKIN_BAND		4000
+#define SKIN_OFFSET		-2000
+#define SKIN_TIME_CONSTANT	60000
+#define SKIN_POLL_PERIOD	2000
+#define SKIN_KP			500
+#define SKIN_KI			10
+
+/**
+ * DOC: Introduction
+ * =================
+ * On a head-worn device the temperature that limits us is the one the
+ * user feels on the frame near the display and the battery, not the OMAP
+ * junction temperature.  None of the sensors measures it directly, so
+ * this governor registers a virtual "skin" sensor which estimates it.
+ *
+ * The estimate is a weighted mix of the temperatures reported by the
+ * "pcb", "flex", "battery" and "cpu" domains, each with its own offset.
+ * Domains without a sensor or without a valid reading are left out and
+ * the weights of the others are renormalised.  The mix is then passed
+ * through a first order low pass filter with a time constant of
+ * skin_time_constant ms, which stands for the thermal mass between the
+ * boards and the outer surface.
+ *
+ * The skin estimate feeds a PI controller which computes a single cooling
+ * demand between 0 and SKIN_THROTTLE_MAX.  The proportional part ramps
+ * from 0 at skin_limit - skin_band up to skin_kp at skin_limit.  The
+ * integral part grows by skin_ki per degree-second spent above the limit
+ * and shrinks the same way below it.
+ *
+ * The demand is shared between the cooling agents of the "skin" domain.
+ * Every agent has a [start, full] window on the demand scale.  It receives
+ * 0 below start and SKIN_THROTTLE_MAX above full, and is ramped linearly
+ * in between.  The default windows shed charge current first, then GPU
+ * clock and display brightness, and cap the CPU last, so a heavy workload
+ * loses a little of everything before it hits a hard CPU cap.  An agent
+ * must treat its throttle value as a fraction of its own range and
+ * ignore repeated values.
+ */
+
+struct skin_input {
+	const char *domain;
+	int weight;		/* relative weight in the mix */
+	int offset;		/* added to the sensor temperature */
+	int temp;		/* last valid reading */
+	bool valid;
+};
+
+static struct skin_input skin_inputs[] = {
+	{ .domain = "pcb",	.weight = 450,	.offset = 0 },
+	{ .domain = "flex",	.weight = 300,	.offset = 0 },
+	{ .domain = "battery",	.weight = 150,	.offset = 0 },
+	{ .domain = "cpu",	.weight = 100,	.offset = -15000 },
+};
+
+struct skin_actuator {
+	const char *name;	/* name of the cooling agent thermal_dev */
+	int start;		/* demand at which the agent starts to throttle */
+	int full;		/* demand at which the agent is fully throttled */
+	int level;		/* last throttle sent to the agent */
+};
+
+static struct skin_actuator skin_actuators[] = {
+	{ .name = "charger_cooling",	  .start = 0,	.full = 400 },
+	{ .name = "gpu_cooling",	  .start = 100,	.full = 800 },
+	{ .name = "backlight_cooling",	  .start = 200,	.full = 700 },
+	{ .name = "cpufreq_skin_cooling", .start = 300,	.full = 1000 },
+};
+
+struct omap_skin_governor {
+	struct mutex lock;
+	struct delayed_work poll_work;
+	int mix_temp;
+	int skin_temp;
+	bool model_valid;
+	unsigned long model_stamp;
+	int demand;
+	int integral;		/* demand scaled by 1000 */
+	unsigned long ctrl_stamp;
+	bool ctrl_valid;
+};
+
+static struct omap_skin_governor *skin_gov;
+
+static int skin_limit = SKIN_LIMIT_TEMP;
+module_param(skin_limit, int, 0644);
+MODULE_PARM_DESC(skin_limit, "Skin temperature limit in mC");
+
+static int skin_band = SKIN_BAND;
+module_param(skin_band, int, 0644);
+MODULE_PARM_DESC(skin_band,
+	"Width in mC of the proportional band below the skin limit");
+
+static int skin_offset = SKIN_OFFSET;
+module_param(skin_offset, int, 0644);
+MODULE_PARM_DESC(skin_offset, "Offset in mC from the sensor mix to the skin");
+
+static int skin_time_constant = SKIN_TIME_CONSTANT;
+module_param(skin_time_constant, int, 0644);
+MODULE_PARM_DESC(skin_time_constant,
+	"Time constant in ms of the skin low pass filter, 0 to disable");
+
+static int skin_poll_period = SKIN_POLL_PERIOD;
+module_param(skin_poll_period, int, 0644);
+MODULE_PARM_DESC(skin_poll_period, "Sensor polling period in ms");
+
+static int skin_kp = SKIN_KP;
+module_param(skin_kp, int, 0644);
+MODULE_PARM_DESC(skin_kp, "Proportional demand at the skin limit");
+
+static int skin_ki = SKIN_KI;
+module_param(skin_ki, int, 0644);
+MODULE_PARM_DESC(skin_ki, "Integral demand per degree-second over the limit");
+
+static struct skin_input *skin_find_input(const char *domain)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(skin_inputs); i++)
+		if (!strcmp(skin_inputs[i].domain, domain))
+			return &skin_inputs[i];
+
+	return NULL;
+}
+
+static struct skin_actuator *skin_find_actuator(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(skin_actuators); i++)
+		if (!strcmp(skin_actuators[i].name, name))
+			return &skin_actuators[i];
+
+	return NULL;
+}
+
+/*
+ * skin_model_update() - Read all inputs and update the skin estimate
+ *
+ * Negative values are error codes in the thermal framework, so a sensor
+ * below 0C is left out of the mix.  This only matters in conditions where
+ * no cooling is needed anyway.
+ *
+ * Returns 0 when the estimate is valid, -ENODATA otherwise.
+ * Must be called with skin_gov->lock held.
+ */
+static int skin_model_update(void)
+{
+	unsigned long now = jiffies;
+	s64 sum = 0;
+	int weights = 0;
+	int elapsed;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(skin_inputs); i++) {
+		struct skin_input *in = &skin_inputs[i];
+		int temp;
+
+		temp = thermal_lookup_temp(in->domain);
+		in->valid = temp >= 0 && in->weight > 0;
+		if (!in->valid)
+			continue;
+
+		in->temp = temp;
+		sum += (s64)(temp + in->offset) * in->weight;
+		weights += in->weight;
+	}
+
+	if (!weights)
+		return -ENODATA;
+
+	skin_gov->mix_temp = (int)div_s64(sum, weights) + skin_offset;
+
+	elapsed = jiffies_to_msecs(now - skin_gov->model_stamp);
+	if (!skin_gov->model_valid || skin_time_constant <= 0 ||
+	    elapsed >= skin_time_constant)
+		skin_gov->skin_temp = skin_gov->mix_temp;
+	else
+		skin_gov->skin_temp += div_s64((s64)(skin_gov->mix_temp -
+				skin_gov->skin_temp) * elapsed,
+				skin_time_constant);
+
+	skin_gov->model_stamp = now;
+	skin_gov->model_valid = true;
+
+	return 0;
+}
+
+/*
+ * skin_update_demand() - Run the PI controller on the skin estimate
+ *
+ * Must be called with skin_gov->lock held.
+ */
+static void skin_update_demand(int skin_temp)
+{
+	unsigned long now = jiffies;
+	int elapsed = 0;
+	int band = max(skin_band, 1);
+	int prop;
+
+	if (skin_gov->ctrl_valid)
+		elapsed = min_t(unsigned int,
+				jiffies_to_msecs(now - skin_gov->ctrl_stamp),
+				10 * max(skin_poll_period, 1));
+	skin_gov->ctrl_stamp = now;
+	skin_gov->ctrl_valid = true;
+
+	/* mC * ms * (demand / C.s) / 1000 gives demand scaled by 1000 */
+	skin_gov->integral += div_s64((s64)(skin_temp - skin_limit) *
+				elapsed * skin_ki, 1000);
+	skin_gov->integral = clamp(skin_gov->integral, 0,
+				SKIN_THROTTLE_MAX * 1000);
+
+	prop = (skin_temp - (skin_limit - band)) * skin_kp / band;
+	prop = clamp(prop, 0, SKIN_THROTTLE_MAX);
+
+	skin_gov->demand = clamp(prop + skin_gov->integral / 1000, 0,
+				SKIN_THROTTLE_MAX);
+}
+
+static int skin_actuator_level(struct skin_actuator *act, int demand)
+{
+	if (!act)
+		return demand;
+	if (demand <= act->start)
+		return 0;
+	if (demand >= act->full || act->full <= act->start)
+		return SKIN_THROTTLE_MAX;
+
+	return (demand - act->start) * SKIN_THROTTLE_MAX /
+		(act->full - act->start);
+}
+
+static int omap_skin_process_temp(struct thermal_dev *gov,
+				struct list_head *cooling_list,
+				struct thermal_dev *temp_sensor,
+				int temp)
+{
+	struct thermal_dev *tdev;
+	int demand;
+
+	mutex_lock(&skin_gov->lock);
+	if (!skin_gov->model_valid) {
+		mutex_unlock(&skin_gov->lock);
+		return 0;
+	}
+	skin_update_demand(temp);
+	demand = skin_gov->demand;
+	mutex_unlock(&skin_gov->lock);
+
+	list_for_each_entry(tdev, cooling_list, node) {
+		struct skin_actuator *act = skin_find_actuator(tdev->name);
+		int level = skin_actuator_level(act, demand);
+
+		if (act) {
+			if (act->level != level)
+				pr_debug("%s: skin %d demand %d, %s %d -> %d\n",
+					__func__, temp, demand, act->name,
+					act->level, level);
+			act->level = level;
+		}
+		thermal_device_call(tdev, cool_device, level);
+	}
+
+	return demand;
+}
+
+static int omap_skin_report_temp(struct thermal_dev *tdev)
+{
+	int temp = -ENODATA;
+
+	mutex_lock(&skin_gov->lock);
+	if (skin_gov->model_valid)
+		temp = skin_gov->skin_temp;
+	mutex_unlock(&skin_gov->lock);
+
+	return temp;
+}
+
+static struct thermal_dev_ops omap_skin_sensor_ops = {
+	.report_temp = omap_skin_report_temp,
+};
+
+static struct thermal_dev omap_skin_sensor = {
+	.name		= "omap_skin_model",
+	.domain_name	= SKIN_DOMAIN,
+	.dev_ops	= &omap_skin_sensor_ops,
+};
+
+static struct thermal_dev_ops omap_skin_gov_ops = {
+	.process_temp = omap_skin_process_temp,
+};
+
+static struct thermal_dev omap_skin_gov = {
+	.name		= "omap_skin_governor",
+	.domain_name	= SKIN_DOMAIN,
+	.dev_ops	= &omap_skin_gov_ops,
+};
+
+static void omap_skin_poll_work_fn(struct work_struct *work)
+{
+	int ret;
+
+	mutex_lock(&skin_gov->lock);
+	ret = skin_model_update();
+	if (!ret)
+		omap_skin_sensor.current_temp = skin_gov->skin_temp;
+	mutex_unlock(&skin_gov->lock);
+
+	if (!ret)
+		thermal_sensor_set_temp(&omap_skin_sensor);
+
+	schedule_delayed_work(&skin_gov->poll_work,
+			msecs_to_jiffies(max(skin_poll_period, 100)));
+}
+
+static int omap_skin_pm_notifier_cb(struct notifier_block *notifier,
+				unsigned long pm_event,  void *unused)
+{
+	switch (pm_event) {
+	case PM_SUSPEND_PREPARE:
+		cancel_delayed_work_sync(&skin_gov->poll_work);
+		break;
+	case PM_POST_SUSPEND:
+		/* jiffies stood still, so the filter state is meaningless */
+		mutex_lock(&skin_gov->lock);
+		skin_gov->model_valid = false;
+		skin_gov->ctrl_valid = false;
+		mutex_unlock(&skin_gov->lock);
+		schedule_delayed_work(&skin_gov->poll_work, 0);
+		break;
+	}
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block omap_skin_pm_notifier = {
+	.notifier_call = omap_skin_pm_notifier_cb,
+};
+
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *skin_dbg;
+
+static int skin_model_show(struct seq_file *s, void *unused)
+{
+	int i;
+
+	mutex_lock(&skin_gov->lock);
+	seq_printf(s, "skin %d mix %d valid %d limit %d\n",
+		skin_gov->skin_temp, skin_gov->mix_temp,
+		skin_gov->model_valid, skin_limit);
+	seq_printf(s, "demand %d integral %d\n", skin_gov->demand,
+		skin_gov->integral / 1000);
+	mutex_unlock(&skin_gov->lock);
+
+	seq_printf(s, "\ninputs:\n");
+	for (i = 0; i < ARRAY_SIZE(skin_inputs); i++) {
+		struct skin_input *in = &skin_inputs[i];
+
+		seq_printf(s, "%-8s weight %4d offset %6d temp %6d%s\n",
+			in->domain, in->weight, in->offset, in->temp,
+			in->valid ? "" : " (missing)");
+	}
+
+	seq_printf(s, "\nactuators:\n");
+	for (i = 0; i < ARRAY_SIZE(skin_actuators); i++) {
+		struct skin_actuator *act = &skin_actuators[i];
+
+		seq_printf(s, "%-20s start %4d full %4d level %4d\n",
+			act->name, act->start, act->full, act->level);
+	}
+
+	return 0;
+}
+
+static int skin_model_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, skin_model_show, inode->i_private);
+}
+
+/*
+ * Accepts "input <domain> <weight> <offset>" and
+ * "actuator <name> <start> <full>".
+ */
+static ssize_t skin_model_write(struct file *file,
+				const char __user *ubuf, size_t count,
+				loff_t *ppos)
+{
+	char buf[64], name[32];
+	int a, b;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	if (sscanf(buf, "input %31s %d %d", name, &a, &b) == 3) {
+		struct skin_input *in = skin_find_input(name);
+
+		if (!in || a < 0)
+			return -EINVAL;
+		mutex_lock(&skin_gov->lock);
+		in->weight = a;
+		in->offset = b;
+		mutex_unlock(&skin_gov->lock);
+	} else if (sscanf(buf, "actuator %31s %d %d", name, &a, &b) == 3) {
+		struct skin_actuator *act = skin_find_actuator(name);
+
+		if (!act || a < 0 || b <= a || b > SKIN_THROTTLE_MAX)
+			return -EINVAL;
+		mutex_lock(&skin_gov->lock);
+		act->start = a;
+		act->full = b;
+		mutex_unlock(&skin_gov->lock);
+	} else {
+		return -EINVAL;
+	}
+
+	return count;
+}
+
+static const struct file_operations skin_model_fops = {
+	.open		= skin_model_open,
+	.read		= seq_read,
+	.write		= skin_model_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init omap_skin_debug_init(void)
+{
+	skin_dbg = debugfs_create_dir("omap_skin_governor", NULL);
+	if (IS_ERR_OR_NULL(skin_dbg))
+		return;
+
+	debugfs_create_file("model", S_IRUGO | S_IWUSR, skin_dbg, NULL,
+			    &skin_model_fops);
+}
+
+static void __exit omap_skin_debug_exit(void)
+{
+	debugfs_remove_recursive(skin_dbg);
+}
+#else
+static inline void omap_skin_debug_init(void) { }
+static inline void omap_skin_debug_exit(void) { }
+#endif
+
+static int __init omap_skin_governor_init(void)
+{
+	skin_gov = kzalloc(sizeof(struct omap_skin_governor), GFP_KERNEL);
+	if (!skin_gov) {
+		pr_err("%s:Cannot allocate memory\n", __func__);
+		return -ENOMEM;
+	}
+
+	mutex_init(&skin_gov->lock);
+	INIT_DELAYED_WORK(&skin_gov->poll_work, omap_skin_poll_work_fn);
+
+	thermal_governor_dev_register(&omap_skin_gov);
+	thermal_sensor_dev_register(&omap_skin_sensor);
+
+	if (register_pm_notifier(&omap_skin_pm_notifier))
+		pr_err("%s: omap_skin pm registration failed!\n", __func__);
+
+	omap_skin_debug_init();
+
+	schedule_delayed_work(&skin_gov->poll_work,
+			msecs_to_jiffies(skin_poll_period));
+
+	return 0;
+}
+
+static void __exit omap_skin_governor_exit(void)
+{
+	omap_skin_debug_exit();
+	unregister_pm_notifier(&omap_skin_pm_notifier);
+	cancel_delayed_work_sync(&skin_gov->poll_work);
+	thermal_sensor_dev_unregister(&omap_skin_sensor);
+	thermal_governor_dev_unregister(&omap_skin_gov);
+	kfree(skin_gov);
+}
+
+module_init(omap_skin_governor_init);
+module_exit(omap_skin_governor_exit);
+
+MODULE_DESCRIPTION("OMAP skin temperature thermal governor");
+MODULE_LICENSE("GPL");
@@ -79,6 +79,7 @@ struct tmp102_temp_sensor {
 	struct i2c_client *iclient;
 	struct mutex sensor_mutex;
 	struct pcb_sens *tpcb;
+	struct thermal_dev *therm_fw;
 
 	unsigned long last_update;
 	int temp;
@@ -164,6 +165,23 @@ static int omap_read_temp(struct device *dev,
 	return sprintf(buf, "%d\n", temp);
 }
 
+/*
+ * Thermal framework reports are in milli-celsius, the duty cycle
+ * governor keeps using the plain celsius value.
+ */
+static int jet_tmp102_report_temp(struct thermal_dev *tdev)
+{
+	struct tmp102_temp_sensor *tmp102 = tmp102_data;
+
+	tmp102->therm_fw->current_temp = tmp102_read_current_temp() * 1000;
+
+	return tmp102->therm_fw->current_temp;
+}
+
+static struct thermal_dev_ops jet_tmp102_sensor_ops = {
+	.report_temp = jet_tmp102_report_temp,
+};
+
 static DEVICE_ATTR(temperature, S_IRUGO, omap_read_temp,
 			  NULL);
 static struct attribute* temp102_attributes[] =
@@ -252,6 +270,17 @@ static int __devinit tmp102_temp_sensor_probe(
 		goto tpcb_alloc_err;
 	}
 
+	tmp102->therm_fw = kzalloc(sizeof(struct thermal_dev), GFP_KERNEL);
+	if (tmp102->therm_fw) {
+		tmp102->therm_fw->name = "jet_tmp102_sensor";
+		tmp102->therm_fw->domain_name = "pcb";
+		tmp102->therm_fw->dev = &client->dev;
+		tmp102->therm_fw->dev_ops = &jet_tmp102_sensor_ops;
+		thermal_sensor_dev_register(tmp102->therm_fw);
+	} else {
+		dev_warn(&client->dev, "not registered to thermal framework\n");
+	}
+
 	dev_info(&client->dev, "initialized\n");
 
 	return 0;
@@ -272,6 +301,10 @@ static int __devexit tmp102_temp_sensor_remove(struct i2c_client *client)
 {
 	struct tmp102_temp_sensor *tmp102 = i2c_get_clientdata(client);
 	sysfs_remove_group(&client->dev.kobj, &temp102_attr_group);
+	if (tmp102->therm_fw) {
+		thermal_sensor_dev_unregister(tmp102->therm_fw);
+		kfree(tmp102->therm_fw);
+	}
 	/* Reset TMP102 and Stop monitoring*/
 	tmp102_write_reg(client, TMP102_CONF_REG,(TMP102_RESET|TMP102_CONF_SD));
 
@@ -321,15 +321,19 @@ int thermal_lookup_temp(const char *name)
 	struct thermal_domain *thermal_domain;
 	int ret = -ENODEV;
 
+	/*
+	 * Governors poll optional domains (e.g. "pcb") on boards which do
+	 * not populate them, so a missing domain or sensor is not an error.
+	 */
 	thermal_domain = thermal_domain_find(name);
 	if (!thermal_domain) {
-		pr_err("%s: %s is a non existing domain\n", __func__, name);
+		pr_debug("%s: %s is a non existing domain\n", __func__, name);
 		return ret;
 	}
 
 	ret = thermal_device_call(thermal_domain->temp_sensor, report_temp);
 	if (ret < 0) {
-		pr_err("%s: getting temp is not supported for domain %s\n",
+		pr_debug("%s: getting temp is not supported for domain %s\n",
 			__func__, thermal_domain->domain_name);
 		ret = -EOPNOTSUPP;
 	}
@@ -23,9 +23,12 @@
 #include <linux/highmem.h>
 #include <linux/list.h>
 #include <linux/lzo.h>
+#include <linux/moduleparam.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/types.h>
+#include <linux/vmstat.h>
+#include <linux/workqueue.h>
 #include <linux/atomic.h>
 #include "tmem.h"
 
@@ -893,6 +896,55 @@ static struct tmem_hostops zcache_hostops = {
  * zcache implementations for PAM page descriptor ops
  */
 
+/*
+ * Ephemeral pages are only worth keeping while memory is otherwise idle,
+ * so the zbud pool is sized from free memory: it may hold up to
+ * eph_free_percent of the pages that are free or already in the pool,
+ * and never more than eph_max_percent of RAM.  Puts beyond that fail and
+ * kick a worker that evicts the pool back below budget; the put path
+ * runs with irqs off and cannot evict itself.
+ */
+static unsigned int zcache_eph_free_percent = 50;
+module_param_named(eph_free_percent, zcache_eph_free_percent, uint, 0644);
+static unsigned int zcache_eph_max_percent = 15;
+module_param_named(eph_max_percent, zcache_eph_max_percent, uint, 0644);
+
+/* evict down to this share of the budget so puts don't flap at the limit */
+#define ZCACHE_EPH_EVICT_TARGET(budget)	((budget) - (budget) / 8)
+
+static unsigned long zcache_eph_over_budget;
+static unsigned long zcache_evicted_budget_pages;
+
+static unsigned long zcache_eph_budget(void)
+{
+	unsigned long raw = atomic_read(&zcache_zbud_curr_raw_pages);
+	unsigned long avail = global_page_state(NR_FREE_PAGES) + raw;
+
+	return min(avail / 100 * zcache_eph_free_percent,
+		   totalram_pages / 100 * zcache_eph_max_percent);
+}
+
+static void zcache_eph_evict_work(struct work_struct *work)
+{
+	unsigned long target = ZCACHE_EPH_EVICT_TARGET(zcache_eph_budget());
+	long before = atomic_read(&zcache_zbud_curr_raw_pages);
+	long after;
+
+	if (before <= target)
+		return;
+	if (!spin_trylock(&zcache_direct_reclaim_lock)) {
+		zcache_aborted_shrink++;
+		return;
+	}
+	zbud_evict_pages(before - target);
+	spin_unlock(&zcache_direct_reclaim_lock);
+
+	after = atomic_read(&zcache_zbud_curr_raw_pages);
+	if (after < before)
+		zcache_evicted_budget_pages += before - after;
+}
+static DECLARE_WORK(zcache_eph_evict, zcache_eph_evict_work);
+
 static atomic_t zcache_curr_eph_pampd_count = ATOMIC_INIT(0);
 static unsigned long zcache_curr_eph_pampd_count_max;
 static atomic_t zcache_curr_pers_pampd_count = ATOMIC_INIT(0);
@@ -911,6 +963,12 @@ static void *zcache_pampd_create(struct tmem_pool *pool, struct tmem_oid *oid,
 	unsigned long count;
 
 	if (ephemeral) {
+		if (atomic_read(&zcache_zbud_curr_raw_pages) >=
+						zcache_eph_budget()) {
+			zcache_eph_over_budget++;
+			schedule_work(&zcache_eph_evict);
+			goto out;
+		}
 		ret = zcache_compress(page, &cdata, &clen);
 		if (ret == 0)
 
@@ -1067,6 +1125,11 @@ static struct notifier_block zcache_cpu_notifier_block = {
 };
 
 #ifdef CONFIG_SYSFS
+static int zcache_show_eph_budget(char *buf)
+{
+	return sprintf(buf, "%lu\n", zcache_eph_budget());
+}
+
 #define ZCACHE_SYSFS_RO(_name) \
 	static ssize_t zcache_##_name##_show(struct kobject *kobj, \
 				struct kobj_attribute *attr, char *buf) \
@@ -1122,6 +1185,8 @@ ZCACHE_SYSFS_RO(put_to_flush);
 ZCACHE_SYSFS_RO(aborted_preload);
 ZCACHE_SYSFS_RO(aborted_shrink);
 ZCACHE_SYSFS_RO(compress_poor);
+ZCACHE_SYSFS_RO(eph_over_budget);
+ZCACHE_SYSFS_RO(evicted_budget_pages);
 ZCACHE_SYSFS_RO_ATOMIC(zbud_curr_raw_pages);
 ZCACHE_SYSFS_RO_ATOMIC(zbud_curr_zpages);
 ZCACHE_SYSFS_RO_ATOMIC(curr_obj_count);
@@ -1130,6 +1195,7 @@ ZCACHE_SYSFS_RO_CUSTOM(zbud_unbuddied_list_counts,
 			zbud_show_unbuddied_list_counts);
 ZCACHE_SYSFS_RO_CUSTOM(zbud_cumul_chunk_counts,
 			zbud_show_cumul_chunk_counts);
+ZCACHE_SYSFS_RO_CUSTOM(eph_budget_pages, zcache_show_eph_budget);
 
 static struct attribute *zcache_attrs[] = {
 	&zcache_curr_obj_count_attr.attr,
@@ -1153,6 +1219,9 @@ static struct attribute *zcache_attrs[] = {
 	&zcache_evicted_raw_pages_attr.attr,
 	&zcache_evicted_unbuddied_pages_attr.attr,
 	&zcache_evicted_buddied_pages_attr.attr,
+	&zcache_evicted_budget_pages_attr.attr,
+	&zcache_eph_over_budget_attr.attr,
+	&zcache_eph_budget_pages_attr.attr,
 	&zcache_failed_get_free_pages_attr.attr,
 	&zcache_failed_alloc_attr.attr,
 	&zcache_put_to_flush_attr.attr,
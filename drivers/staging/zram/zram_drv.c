@@ -27,8 +27,13 @@
 #include <linux/buffer_head.h>
 #include <linux/device.h>
 #include <linux/genhd.h>
+#include <linux/hash.h>
 #include <linux/highmem.h>
+#include <linux/jhash.h>
+#include <linux/ktime.h>
+#include <linux/percpu.h>
 #include <linux/slab.h>
+#include <linux/lz4.h>
 #include <linux/lzo.h>
 #include <linux/string.h>
 #include <linux/vmalloc.h>
@@ -38,6 +43,23 @@
 /* Globals */
 static int zram_major;
 struct zram *devices;
+static struct kmem_cache *zram_dedup_cache;
+
+/* The first entry is the default for new devices */
+static const struct zram_compressor zram_compressors[] = {
+	{
+		.name = "lz4",
+		.workmem_size = LZ4_MEM_COMPRESS,
+		.compress = lz4_compress,
+		.decompress = lz4_decompress_safe,
+	},
+	{
+		.name = "lzo",
+		.workmem_size = LZO1X_MEM_COMPRESS,
+		.compress = lzo1x_1_compress,
+		.decompress = lzo1x_decompress_safe,
+	},
+};
 
 /* Module params (documentation at end) */
 unsigned int num_devices;
@@ -71,6 +93,19 @@ static void zram_stat64_inc(struct zram *zram, u64 *v)
 	zram_stat64_add(zram, v, 1);
 }
 
+static void zram_stat64_max(struct zram *zram, u64 *v, u64 val)
+{
+	spin_lock(&zram->stat64_lock);
+	if (val > *v)
+		*v = val;
+	spin_unlock(&zram->stat64_lock);
+}
+
+static u64 zram_ns_since(ktime_t start)
+{
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
 static int zram_test_flag(struct zram *zram, u32 index,
 			enum zram_pageflags flag)
 {
@@ -104,6 +139,137 @@ static int page_zero_filled(void *ptr)
 	return 1;
 }
 
+ssize_t zram_show_compressors(struct zram *zram, char *buf)
+{
+	ssize_t sz = 0;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(zram_compressors); i++) {
+		const struct zram_compressor *comp = &zram_compressors[i];
+
+		if (comp == zram->comp)
+			sz += sprintf(buf + sz, "[%s] ", comp->name);
+		else
+			sz += sprintf(buf + sz, "%s ", comp->name);
+	}
+	buf[sz - 1] = '\n';
+
+	return sz;
+}
+
+int zram_set_compressor(struct zram *zram, const char *name)
+{
+	int i, ret = -EINVAL;
+
+	mutex_lock(&zram->init_lock);
+	if (zram->init_done) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(zram_compressors); i++) {
+		if (sysfs_streq(name, zram_compressors[i].name)) {
+			zram->comp = &zram_compressors[i];
+			ret = 0;
+			break;
+		}
+	}
+
+out:
+	mutex_unlock(&zram->init_lock);
+	return ret;
+}
+
+/*
+ * Streams are per-CPU so writers on different CPUs never contend for
+ * compression buffers; the mutex only covers preemption and migration
+ * while a stream is in use.
+ */
+static struct zram_stream *zram_stream_get(struct zram *zram)
+{
+	struct zram_stream *zstrm;
+
+	zstrm = per_cpu_ptr(zram->streams, get_cpu());
+	put_cpu();
+	mutex_lock(&zstrm->lock);
+
+	return zstrm;
+}
+
+static void zram_stream_put(struct zram_stream *zstrm)
+{
+	mutex_unlock(&zstrm->lock);
+}
+
+static struct hlist_head *dedup_content_head(struct zram *zram, u32 checksum)
+{
+	return &zram->dedup_content[hash_32(checksum, ZRAM_DEDUP_HASH_BITS)];
+}
+
+static struct hlist_head *dedup_location_head(struct zram *zram,
+				struct page *page, u32 offset)
+{
+	return &zram->dedup_location[hash_long((unsigned long)page ^ offset,
+					ZRAM_DEDUP_HASH_BITS)];
+}
+
+/*
+ * Find a stored object whose compressed image equals 'src' and take a
+ * reference on it.  Caller must hold table_lock.
+ */
+static struct zram_dedup *zram_dedup_get(struct zram *zram,
+				const unsigned char *src, size_t clen,
+				u32 checksum)
+{
+	struct zram_dedup *dedup;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry(dedup, pos, dedup_content_head(zram, checksum),
+				content) {
+		unsigned char *cmem;
+		int match;
+
+		if (dedup->checksum != checksum || dedup->clen != clen)
+			continue;
+
+		cmem = kmap_atomic(dedup->page, KM_USER1) + dedup->offset;
+		match = !memcmp(cmem + sizeof(struct zobj_header), src, clen);
+		kunmap_atomic(cmem, KM_USER1);
+
+		if (match) {
+			dedup->refcount++;
+			return dedup;
+		}
+	}
+
+	return NULL;
+}
+
+/* Caller must hold table_lock. */
+static struct zram_dedup *zram_dedup_lookup(struct zram *zram,
+				struct page *page, u32 offset)
+{
+	struct zram_dedup *dedup;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry(dedup, pos,
+			dedup_location_head(zram, page, offset), location) {
+		if (dedup->page == page && dedup->offset == offset)
+			return dedup;
+	}
+
+	return NULL;
+}
+
+/* Caller must hold table_lock. */
+static void zram_dedup_insert(struct zram *zram, struct zram_dedup *dedup)
+{
+	hlist_add_head(&dedup->content,
+			dedup_content_head(zram, dedup->checksum));
+	hlist_add_head(&dedup->location,
+			dedup_location_head(zram, dedup->page, dedup->offset));
+}
+
 static void zram_set_disksize(struct zram *zram, size_t totalram_bytes)
 {
 	if (!zram->disksize) {
@@ -137,10 +303,13 @@ static void zram_free_page(struct zram *zram, size_t index)
 {
 	u32 clen;
 	void *obj;
+	struct zram_dedup *dedup = NULL;
 
 	struct page *page = zram->table[index].page;
 	u32 offset = zram->table[index].offset;
 
+	spin_lock(&zram->table_lock);
+
 	if (unlikely(!page)) {
 		/*
 		 * No memory is allocated for zero filled pages.
@@ -150,6 +319,7 @@ static void zram_free_page(struct zram *zram, size_t index)
 			zram_clear_flag(zram, index, ZRAM_ZERO);
 			zram_stat_dec(&zram->stats.pages_zero);
 		}
+		spin_unlock(&zram->table_lock);
 		return;
 	}
 
@@ -165,14 +335,39 @@ static void zram_free_page(struct zram *zram, size_t index)
 	clen = xv_get_object_size(obj) - sizeof(struct zobj_header);
 	kunmap_atomic(obj, KM_USER0);
 
-	xv_free(zram->mem_pool, page, offset);
 	if (clen <= PAGE_SIZE / 2)
 		zram_stat_dec(&zram->stats.good_compress);
 
+	if (zram_test_flag(zram, index, ZRAM_DEDUP)) {
+		zram_clear_flag(zram, index, ZRAM_DEDUP);
+		dedup = zram_dedup_lookup(zram, page, offset);
+		BUG_ON(!dedup);
+
+		/* Other slots still use this object */
+		if (--dedup->refcount) {
+			zram_stat_dec(&zram->stats.pages_dedup);
+			zram_stat_dec(&zram->stats.pages_stored);
+			spin_unlock(&zram->table_lock);
+
+			zram_stat64_sub(zram, &zram->stats.dedup_size, clen);
+			goto reset;
+		}
+
+		hlist_del(&dedup->content);
+		hlist_del(&dedup->location);
+	}
+
+	xv_free(zram->mem_pool, page, offset);
+
 out:
-	zram_stat64_sub(zram, &zram->stats.compr_size, clen);
 	zram_stat_dec(&zram->stats.pages_stored);
+	spin_unlock(&zram->table_lock);
 
+	if (dedup)
+		kmem_cache_free(zram_dedup_cache, dedup);
+	zram_stat64_sub(zram, &zram->stats.compr_size, clen);
+
+reset:
 	zram->table[index].page = NULL;
 	zram->table[index].offset = 0;
 }
@@ -217,6 +412,8 @@ static void zram_read(struct zram *zram, struct bio *bio)
 	bio_for_each_segment(bvec, bio, i) {
 		int ret;
 		size_t clen;
+		u64 elapsed;
+		ktime_t start;
 		struct page *page;
 		struct zobj_header *zheader;
 		unsigned char *user_mem, *cmem;
@@ -251,16 +448,21 @@ static void zram_read(struct zram *zram, struct bio *bio)
 		cmem = kmap_atomic(zram->table[index].page, KM_USER1) +
 				zram->table[index].offset;
 
-		ret = lzo1x_decompress_safe(
+		start = ktime_get();
+		ret = zram->comp->decompress(
 			cmem + sizeof(*zheader),
 			xv_get_object_size(cmem) - sizeof(*zheader),
 			user_mem, &clen);
+		elapsed = zram_ns_since(start);
 
 		kunmap_atomic(user_mem, KM_USER0);
 		kunmap_atomic(cmem, KM_USER1);
 
+		zram_stat64_add(zram, &zram->stats.decompr_time, elapsed);
+		zram_stat64_max(zram, &zram->stats.decompr_max, elapsed);
+
 		/* Should NEVER happen. Return bio error if it does. */
-		if (unlikely(ret != LZO_E_OK)) {
+		if (unlikely(ret)) {
 			pr_err("Decompression failed! err=%d, page=%u\n",
 				ret, index);
 			zram_stat64_inc(zram, &zram->stats.failed_reads);
@@ -290,14 +492,16 @@ static void zram_write(struct zram *zram, struct bio *bio)
 
 	bio_for_each_segment(bvec, bio, i) {
 		int ret;
-		u32 offset;
+		u32 offset, checksum;
 		size_t clen;
+		ktime_t start;
+		struct zram_dedup *dedup = NULL;
+		struct zram_stream *zstrm;
 		struct zobj_header *zheader;
 		struct page *page, *page_store;
 		unsigned char *user_mem, *cmem, *src;
 
 		page = bvec->bv_page;
-		src = zram->compress_buffer;
 
 		/*
 		 * System overwrites unused sectors. Free memory associated
@@ -307,25 +511,31 @@ static void zram_write(struct zram *zram, struct bio *bio)
 				zram_test_flag(zram, index, ZRAM_ZERO))
 			zram_free_page(zram, index);
 
-		mutex_lock(&zram->lock);
+		zstrm = zram_stream_get(zram);
+		src = zstrm->buffer;
 
 		user_mem = kmap_atomic(page, KM_USER0);
 		if (page_zero_filled(user_mem)) {
 			kunmap_atomic(user_mem, KM_USER0);
-			mutex_unlock(&zram->lock);
+			zram_stream_put(zstrm);
+			spin_lock(&zram->table_lock);
 			zram_stat_inc(&zram->stats.pages_zero);
 			zram_set_flag(zram, index, ZRAM_ZERO);
+			spin_unlock(&zram->table_lock);
 			index++;
 			continue;
 		}
 
-		ret = lzo1x_1_compress(user_mem, PAGE_SIZE, src, &clen,
-					zram->compress_workmem);
+		start = ktime_get();
+		ret = zram->comp->compress(user_mem, PAGE_SIZE, src, &clen,
+					zstrm->workmem);
+		zram_stat64_add(zram, &zram->stats.compr_time,
+				zram_ns_since(start));
 
 		kunmap_atomic(user_mem, KM_USER0);
 
-		if (unlikely(ret != LZO_E_OK)) {
-			mutex_unlock(&zram->lock);
+		if (unlikely(ret)) {
+			zram_stream_put(zstrm);
 			pr_err("Compression failed! err=%d\n", ret);
 			zram_stat64_inc(zram, &zram->stats.failed_writes);
 			goto out;
@@ -340,7 +550,7 @@ static void zram_write(struct zram *zram, struct bio *bio)
 			clen = PAGE_SIZE;
 			page_store = alloc_page(GFP_NOIO | __GFP_HIGHMEM);
 			if (unlikely(!page_store)) {
-				mutex_unlock(&zram->lock);
+				zram_stream_put(zstrm);
 				pr_info("Error allocating memory for "
 					"incompressible page: %u\n", index);
 				zram_stat64_inc(zram,
@@ -350,16 +560,41 @@ static void zram_write(struct zram *zram, struct bio *bio)
 
 			offset = 0;
 			zram_set_flag(zram, index, ZRAM_UNCOMPRESSED);
-			zram_stat_inc(&zram->stats.pages_expand);
 			zram->table[index].page = page_store;
 			src = kmap_atomic(page, KM_USER0);
 			goto memstore;
 		}
 
+		/* Share the object of an identical page if there is one */
+		checksum = jhash(src, clen, 0);
+		spin_lock(&zram->table_lock);
+		dedup = zram_dedup_get(zram, src, clen, checksum);
+		if (dedup) {
+			zram->table[index].page = dedup->page;
+			zram->table[index].offset = dedup->offset;
+			zram_set_flag(zram, index, ZRAM_DEDUP);
+			zram_stat_inc(&zram->stats.pages_stored);
+			zram_stat_inc(&zram->stats.pages_dedup);
+			if (clen <= PAGE_SIZE / 2)
+				zram_stat_inc(&zram->stats.good_compress);
+			spin_unlock(&zram->table_lock);
+			zram_stream_put(zstrm);
+
+			zram_stat64_add(zram, &zram->stats.dedup_size, clen);
+			index++;
+			continue;
+		}
+		spin_unlock(&zram->table_lock);
+
+		/* Without a tracking entry the page is simply not shared */
+		dedup = kmem_cache_alloc(zram_dedup_cache, GFP_NOIO);
+
 		if (xv_malloc(zram->mem_pool, clen + sizeof(*zheader),
 				&zram->table[index].page, &offset,
 				GFP_NOIO | __GFP_HIGHMEM)) {
-			mutex_unlock(&zram->lock);
+			zram_stream_put(zstrm);
+			if (dedup)
+				kmem_cache_free(zram_dedup_cache, dedup);
 			pr_info("Error allocating memory for compressed "
 				"page: %u, size=%zu\n", index, clen);
 			zram_stat64_inc(zram, &zram->stats.failed_writes);
@@ -388,12 +623,25 @@ memstore:
 			kunmap_atomic(src, KM_USER0);
 
 		/* Update stats */
-		zram_stat64_add(zram, &zram->stats.compr_size, clen);
+		spin_lock(&zram->table_lock);
+		if (dedup) {
+			dedup->page = zram->table[index].page;
+			dedup->offset = offset;
+			dedup->clen = clen;
+			dedup->checksum = checksum;
+			dedup->refcount = 1;
+			zram_dedup_insert(zram, dedup);
+			zram_set_flag(zram, index, ZRAM_DEDUP);
+		}
 		zram_stat_inc(&zram->stats.pages_stored);
-		if (clen <= PAGE_SIZE / 2)
+		if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)))
+			zram_stat_inc(&zram->stats.pages_expand);
+		else if (clen <= PAGE_SIZE / 2)
 			zram_stat_inc(&zram->stats.good_compress);
+		spin_unlock(&zram->table_lock);
 
-		mutex_unlock(&zram->lock);
+		zram_stream_put(zstrm);
+		zram_stat64_add(zram, &zram->stats.compr_size, clen);
 		index++;
 	}
 
@@ -453,19 +701,56 @@ static int zram_make_request(struct request_queue *queue, struct bio *bio)
 	return 0;
 }
 
+static void zram_free_streams(struct zram *zram)
+{
+	int cpu;
+
+	if (!zram->streams)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct zram_stream *zstrm = per_cpu_ptr(zram->streams, cpu);
+
+		kfree(zstrm->workmem);
+		free_pages((unsigned long)zstrm->buffer, 1);
+	}
+
+	free_percpu(zram->streams);
+	zram->streams = NULL;
+}
+
+static int zram_alloc_streams(struct zram *zram)
+{
+	int cpu;
+
+	zram->streams = alloc_percpu(struct zram_stream);
+	if (!zram->streams)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct zram_stream *zstrm = per_cpu_ptr(zram->streams, cpu);
+
+		mutex_init(&zstrm->lock);
+		zstrm->workmem = kzalloc(zram->comp->workmem_size, GFP_KERNEL);
+		zstrm->buffer = (void *)__get_free_pages(GFP_KERNEL |
+							__GFP_ZERO, 1);
+		if (!zstrm->workmem || !zstrm->buffer)
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
 void zram_reset_device(struct zram *zram)
 {
 	size_t index;
+	int i;
 
 	mutex_lock(&zram->init_lock);
 	zram->init_done = 0;
 
 	/* Free various per-device buffers */
-	kfree(zram->compress_workmem);
-	free_pages((unsigned long)zram->compress_buffer, 1);
-
-	zram->compress_workmem = NULL;
-	zram->compress_buffer = NULL;
+	zram_free_streams(zram);
 
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
@@ -475,7 +760,8 @@ void zram_reset_device(struct zram *zram)
 		page = zram->table[index].page;
 		offset = zram->table[index].offset;
 
-		if (!page)
+		/* Shared objects are freed once, from the dedup hash */
+		if (!page || zram_test_flag(zram, index, ZRAM_DEDUP))
 			continue;
 
 		if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)))
@@ -484,6 +770,23 @@ void zram_reset_device(struct zram *zram)
 			xv_free(zram->mem_pool, page, offset);
 	}
 
+	for (i = 0; zram->dedup_location && i < 1 << ZRAM_DEDUP_HASH_BITS;
+	     i++) {
+		struct zram_dedup *dedup;
+		struct hlist_node *pos, *n;
+
+		hlist_for_each_entry_safe(dedup, pos, n,
+				&zram->dedup_location[i], location) {
+			xv_free(zram->mem_pool, dedup->page, dedup->offset);
+			kmem_cache_free(zram_dedup_cache, dedup);
+		}
+	}
+
+	kfree(zram->dedup_content);
+	kfree(zram->dedup_location);
+	zram->dedup_content = NULL;
+	zram->dedup_location = NULL;
+
 	vfree(zram->table);
 	zram->table = NULL;
 
@@ -511,26 +814,29 @@ int zram_init_device(struct zram *zram)
 
 	zram_set_disksize(zram, totalram_pages << PAGE_SHIFT);
 
-	zram->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
-	if (!zram->compress_workmem) {
-		pr_err("Error allocating compressor working memory!\n");
+	num_pages = zram->disksize >> PAGE_SHIFT;
+	zram->table = vzalloc(num_pages * sizeof(*zram->table));
+	if (!zram->table) {
+		pr_err("Error allocating zram address table\n");
+		/* To prevent accessing table entries during cleanup */
+		zram->disksize = 0;
 		ret = -ENOMEM;
 		goto fail;
 	}
 
-	zram->compress_buffer = (void *)__get_free_pages(__GFP_ZERO, 1);
-	if (!zram->compress_buffer) {
-		pr_err("Error allocating compressor buffer space\n");
-		ret = -ENOMEM;
+	ret = zram_alloc_streams(zram);
+	if (ret) {
+		pr_err("Error allocating %s compression streams\n",
+			zram->comp->name);
 		goto fail;
 	}
 
-	num_pages = zram->disksize >> PAGE_SHIFT;
-	zram->table = vzalloc(num_pages * sizeof(*zram->table));
-	if (!zram->table) {
-		pr_err("Error allocating zram address table\n");
-		/* To prevent accessing table entries during cleanup */
-		zram->disksize = 0;
+	zram->dedup_content = kcalloc(1 << ZRAM_DEDUP_HASH_BITS,
+				sizeof(struct hlist_head), GFP_KERNEL);
+	zram->dedup_location = kcalloc(1 << ZRAM_DEDUP_HASH_BITS,
+				sizeof(struct hlist_head), GFP_KERNEL);
+	if (!zram->dedup_content || !zram->dedup_location) {
+		pr_err("Error allocating dedup hash tables\n");
 		ret = -ENOMEM;
 		goto fail;
 	}
@@ -579,9 +885,10 @@ static int create_device(struct zram *zram, int device_id)
 {
 	int ret = 0;
 
-	mutex_init(&zram->lock);
 	mutex_init(&zram->init_lock);
+	spin_lock_init(&zram->table_lock);
 	spin_lock_init(&zram->stat64_lock);
+	zram->comp = &zram_compressors[0];
 
 	zram->queue = blk_alloc_queue(GFP_KERNEL);
 	if (!zram->queue) {
@@ -664,11 +971,17 @@ static int __init zram_init(void)
 		goto out;
 	}
 
+	zram_dedup_cache = KMEM_CACHE(zram_dedup, 0);
+	if (!zram_dedup_cache) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
 	zram_major = register_blkdev(0, "zram");
 	if (zram_major <= 0) {
 		pr_warning("Unable to get major number\n");
 		ret = -EBUSY;
-		goto out;
+		goto destroy_cache;
 	}
 
 	if (!num_devices) {
@@ -698,6 +1011,8 @@ free_devices:
 	kfree(devices);
 unregister:
 	unregister_blkdev(zram_major, "zram");
+destroy_cache:
+	kmem_cache_destroy(zram_dedup_cache);
 out:
 	return ret;
 }
@@ -718,6 +1033,7 @@ static void __exit zram_exit(void)
 	unregister_blkdev(zram_major, "zram");
 
 	kfree(devices);
+	kmem_cache_destroy(zram_dedup_cache);
 	pr_debug("Cleanup done!\n");
 }
 
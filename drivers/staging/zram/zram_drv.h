@@ -17,6 +17,7 @@
 
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
+#include <linux/list.h>
 
 #include "xvmalloc.h"
 
@@ -71,6 +72,9 @@ enum zram_pageflags {
 	/* Page consists entirely of zeros */
 	ZRAM_ZERO,
 
+	/* Compressed object is tracked in the dedup hash */
+	ZRAM_DEDUP,
+
 	__NR_ZRAM_PAGEFLAGS,
 };
 
@@ -84,6 +88,40 @@ struct table {
 	u8 flags;
 } __attribute__((aligned(4)));
 
+/*
+ * Every compressed object is indexed by a checksum of its compressed
+ * image so identical pages written to different slots share one object.
+ * The compressors are deterministic, so equal pages compress to equal
+ * images and comparing those is enough to prove a match.
+ */
+#define ZRAM_DEDUP_HASH_BITS	12
+
+struct zram_dedup {
+	struct hlist_node content;	/* hashed by checksum */
+	struct hlist_node location;	/* hashed by page/offset */
+	struct page *page;
+	u16 offset;
+	u16 clen;
+	u32 checksum;
+	u32 refcount;			/* table entries using this object */
+};
+
+struct zram_compressor {
+	const char *name;
+	size_t workmem_size;
+	int (*compress)(const unsigned char *src, size_t src_len,
+			unsigned char *dst, size_t *dst_len, void *wrkmem);
+	int (*decompress)(const unsigned char *src, size_t src_len,
+			unsigned char *dst, size_t *dst_len);
+};
+
+/* Per-CPU compression working memory and output buffer */
+struct zram_stream {
+	struct mutex lock;	/* held while the stream is in use */
+	void *workmem;
+	void *buffer;
+};
+
 struct zram_stats {
 	u64 compr_size;		/* compressed size of pages stored */
 	u64 num_reads;		/* failed + successful */
@@ -96,16 +134,23 @@ struct zram_stats {
 	u32 pages_stored;	/* no. of pages currently stored */
 	u32 good_compress;	/* % of pages with compression ratio<=50% */
 	u32 pages_expand;	/* % of incompressible pages */
+	u32 pages_dedup;	/* no. of pages sharing another's object */
+	u64 dedup_size;		/* compressed bytes saved by dedup */
+	u64 compr_time;		/* ns spent compressing */
+	u64 decompr_time;	/* ns spent decompressing */
+	u64 decompr_max;	/* longest single decompression, ns */
 };
 
 struct zram {
 	struct xv_pool *mem_pool;
-	void *compress_workmem;
-	void *compress_buffer;
+	const struct zram_compressor *comp;
+	struct zram_stream __percpu *streams;
 	struct table *table;
+	/* protect table entries, dedup hashes and 32-bit stats */
+	spinlock_t table_lock;
+	struct hlist_head *dedup_content;
+	struct hlist_head *dedup_location;
 	spinlock_t stat64_lock;	/* protect 64-bit stats */
-	struct mutex lock;	/* protect compression buffers against
-				 * concurrent writes */
 	struct request_queue *queue;
 	struct gendisk *disk;
 	int init_done;
@@ -128,5 +173,7 @@ extern struct attribute_group zram_disk_attr_group;
 
 extern int zram_init_device(struct zram *zram);
 extern void zram_reset_device(struct zram *zram);
+extern ssize_t zram_show_compressors(struct zram *zram, char *buf);
+extern int zram_set_compressor(struct zram *zram, const char *name);
 
 #endif
@@ -28,6 +28,7 @@
 #include <linux/fcntl.h>
 #include <linux/syscalls.h>
 #include <linux/fs.h>
+#include <linux/thermal_framework.h>
 #include <asm/uaccess.h>
 
 #include <video/omapdss.h>
@@ -91,6 +92,11 @@ bool static kopin_init_done = 0;
 bool static kopin_first_image = 1;
 u16 static kopin_current_pwm = A230_DEFAULT_BRIGHTNESS;
 
+// Skin cooling may dim the display down to this share of the user setting
+#define A230_THERMAL_MIN_PERMILLE	500
+u16 static kopin_thermal_scale = 1000;
+static struct omap_dss_device *kopin_dssdev;
+
 static REG8_t kopin_init_data[] =
 {
 	{0x00,0xC2},{0x01,0x00},{0x02,0x04},{0x03,0x01},{0x04,0x01},{0x05,0x00},{0x06,0x1E},{0x07,0x0B},{0x08,0x0B},{0x09,0x80},{0x0F,0x00},
@@ -241,6 +247,8 @@ static void kopin_a230_panel_setup_update(int x, int y, int w, int h)
 
 static void a230_set_pwm(u16 val)
 {
+	val = (u32)val * kopin_thermal_scale / 1000;
+
 	rfbi_bus_lock();
 	kopin_a230_write_reg(A230_PWM0_H_ADDR, val>>4, is_direct_mode);
 	kopin_a230_write_reg(A230_PWM1_H_ADDR, val>>4, is_direct_mode);
@@ -248,10 +256,44 @@ static void a230_set_pwm(u16 val)
 	rfbi_bus_unlock();
 }
 
+#ifdef CONFIG_THERMAL_FRAMEWORK
+// @throttle: share of the dimming range to apply, 0..1000
+static int a230_backlight_cool_device(struct thermal_dev *tdev, int throttle)
+{
+	u16 scale;
+
+	throttle = clamp(throttle, 0, 1000);
+	scale = 1000 - (1000 - A230_THERMAL_MIN_PERMILLE) * throttle / 1000;
+	if (scale == kopin_thermal_scale)
+		return 0;
+
+	kopin_thermal_scale = scale;
+	if (bootmode >= BOOTMODE_ANDROID && kopin_dssdev &&
+	    kopin_dssdev->state == OMAP_DSS_DISPLAY_ACTIVE)
+		a230_set_pwm(kopin_current_pwm);
+
+	return 0;
+}
+
+static struct thermal_dev_ops a230_backlight_cooling_ops = {
+	.cool_device = a230_backlight_cool_device,
+};
+
+static struct thermal_dev a230_backlight_cooling = {
+	.name		= "backlight_cooling",
+	.domain_name	= "skin",
+	.dev_ops	= &a230_backlight_cooling_ops,
+};
+#endif
+
 static void __exit kopin_a230_panel_remove(struct omap_dss_device *dssdev)
 {
 	struct kopin_data *sd = dev_get_drvdata(&dssdev->dev);
 
+#ifdef CONFIG_THERMAL_FRAMEWORK
+	thermal_cooling_dev_unregister(&a230_backlight_cooling);
+#endif
+	kopin_dssdev = NULL;
 	kfree(sd);
 }
 
@@ -616,6 +658,12 @@ static int kopin_a230_panel_probe(struct omap_dss_device *dssdev)
 
 	proc_create_data("kopinctrl", S_IWUSR, NULL, &kopin_proc_fops, NULL);
 
+	kopin_dssdev = dssdev;
+#ifdef CONFIG_THERMAL_FRAMEWORK
+	a230_backlight_cooling.dev = &dssdev->dev;
+	thermal_cooling_dev_register(&a230_backlight_cooling);
+#endif
+
 	return 0;
 
 err_kzalloc:
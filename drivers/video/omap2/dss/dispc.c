@@ -89,6 +89,24 @@ struct dispc_irq_stats {
 	unsigned irqs[32];
 };
 
+/*
+ * Address layout of the last successful dispc_setup_plane() per plane, so
+ * that a buffer flip with otherwise unchanged geometry can be programmed
+ * with dispc_set_plane_addr() without redoing the full plane setup.
+ */
+struct dispc_plane_addr_cfg {
+	bool valid;
+	enum omap_color_mode color_mode;
+	enum omap_dss_rotation_type rotation_type;
+	u8 rotation;
+	bool mirror;
+	unsigned offset0, offset1;
+	unsigned long tiler_width, tiler_height;
+	u32 v_inc;
+	u16 width, height;
+	s32 row_inc, pix_inc;
+};
+
 static struct {
 	struct platform_device *pdev;
 	void __iomem    *base;
@@ -101,6 +119,7 @@ static struct {
 	struct clk *dss_clk;
 
 	u32	fifo_size[MAX_DSS_OVERLAYS];
+	struct dispc_plane_addr_cfg plane_addr[MAX_DSS_OVERLAYS];
 
 	u32	channel_irq[3]; /* Max channels hardcoded to 3*/
 
@@ -314,8 +333,12 @@ static void dispc_restore_context(void)
 
 	DSSDBG("dispc_restore_context\n");
 
-	if (!dispc.ctx_valid)
+	if (!dispc.ctx_valid) {
+		/* registers may be at reset values, force full plane setup */
+		for (i = 0; i < MAX_DSS_OVERLAYS; i++)
+			dispc.plane_addr[i].valid = false;
 		return;
+	}
 
 	ctx = dispc_get_ctx_loss_count();
 
@@ -2372,6 +2395,7 @@ int dispc_setup_plane(enum omap_plane plane,
 	u32 fifo_high, fifo_low;
 	unsigned long flags;
 	u32 udf_mask;
+	u32 v_inc = 0;
 
 	DSSDBG("dispc_setup_plane %d, pa %x, sw %d, %d,%d, %d/%dx%d/%d -> "
 	       "%dx%d, ilace %d, cmode %x, rot %d, mir %d chan %d %dtap\n",
@@ -2381,6 +2405,9 @@ int dispc_setup_plane(enum omap_plane plane,
 	       ilace, color_mode,
 	       rotation, mirror, channel, five_taps ? 5 : 3);
 
+	if (plane < MAX_DSS_OVERLAYS)
+		dispc.plane_addr[plane].valid = false;
+
 	if (paddr == 0)
 		return -EINVAL;
 
@@ -2528,6 +2555,7 @@ int dispc_setup_plane(enum omap_plane plane,
 		tilview_rotate(&view, rotation * 90);
 		tilview_flip(&view, mirror, false);
 		paddr = view.tsptr;
+		v_inc = view.v_inc;
 
 		/* we cannot do TB field interlaced in rotated view */
 		pix_inc = 1 + (x_decim - 1) * bpp * pixpg;
@@ -2609,6 +2637,95 @@ int dispc_setup_plane(enum omap_plane plane,
 		dispc_setup_plane_fifo(plane, fifo_low, fifo_high);
 	}
 
+	/*
+	 * Field-mode and interlaced offsets depend on more than the buffer
+	 * address, so only progressive setups are eligible for the fast path.
+	 */
+	if (plane < MAX_DSS_OVERLAYS && !ilace) {
+		struct dispc_plane_addr_cfg *ac = &dispc.plane_addr[plane];
+
+		ac->color_mode = color_mode;
+		ac->rotation_type = rotation_type;
+		ac->rotation = rotation;
+		ac->mirror = mirror;
+		ac->offset0 = offset0;
+		ac->offset1 = offset1;
+		ac->tiler_width = tiler_width;
+		ac->tiler_height = tiler_height;
+		ac->v_inc = v_inc;
+		ac->width = width;
+		ac->height = height;
+		ac->row_inc = row_inc;
+		ac->pix_inc = pix_inc;
+		ac->valid = true;
+	}
+
+	return 0;
+}
+
+/*
+ * Reprogram only the base address registers of a plane whose layout was
+ * set up by the last dispc_setup_plane() call. Returns -EINVAL if there is
+ * no usable recorded layout, in which case the caller has to do a full
+ * dispc_setup_plane().
+ */
+int dispc_set_plane_addr(enum omap_plane plane, u32 paddr, u32 puv_addr)
+{
+	struct dispc_plane_addr_cfg *ac;
+
+	if (plane >= MAX_DSS_OVERLAYS || paddr == 0)
+		return -EINVAL;
+
+	ac = &dispc.plane_addr[plane];
+	if (!ac->valid)
+		return -EINVAL;
+
+	if (ac->color_mode == OMAP_DSS_COLOR_NV12 && puv_addr == 0)
+		return -EINVAL;
+
+	if (ac->rotation_type == OMAP_DSS_ROT_TILER) {
+		struct tiler_view_t view = {0};
+
+		tilview_create(&view, paddr, ac->tiler_width,
+			       ac->tiler_height);
+		tilview_rotate(&view, ac->rotation * 90);
+		tilview_flip(&view, ac->mirror, false);
+
+		/* a different container stride changes row_inc/offset1 */
+		if (view.v_inc != ac->v_inc)
+			return -EINVAL;
+		paddr = view.tsptr;
+
+		if (puv_addr) {
+			tilview_create(&view, puv_addr, ac->tiler_width / 2,
+				       ac->tiler_height / 2);
+			tilview_rotate(&view, ac->rotation * 90);
+			tilview_flip(&view, ac->mirror, false);
+			puv_addr = view.tsptr;
+		}
+	}
+
+	DSSDBG("dispc_set_plane_addr %d, pa %x, uv %x\n",
+	       plane, paddr, puv_addr);
+
+	_dispc_set_plane_ba0(plane, paddr + ac->offset0);
+	_dispc_set_plane_ba1(plane, paddr + ac->offset1);
+
+	if (ac->color_mode == OMAP_DSS_COLOR_NV12) {
+		_dispc_set_plane_ba0_uv(plane, puv_addr + ac->offset0);
+		_dispc_set_plane_ba1_uv(plane, puv_addr + ac->offset1);
+	}
+
+	/* the low threshold depends on the buffer's position in TILER */
+	if (cpu_is_omap44xx()) {
+		u32 fifo_low = dispc_calculate_threshold(plane,
+				paddr + ac->offset0, puv_addr + ac->offset0,
+				ac->width, ac->height,
+				ac->row_inc, ac->pix_inc);
+		dispc_setup_plane_fifo(plane, fifo_low,
+				       dispc_get_plane_fifo_size(plane) - 1);
+	}
+
 	return 0;
 }
 
@@ -2616,6 +2733,9 @@ int dispc_enable_plane(enum omap_plane plane, bool enable)
 {
 	DSSDBG("dispc_enable_plane %d, %d\n", plane, enable);
 
+	if (!enable && plane < MAX_DSS_OVERLAYS)
+		dispc.plane_addr[plane].valid = false;
+
 	REG_FLD_MOD(DISPC_OVL_ATTRIBUTES(plane), enable ? 1 : 0, 0, 0);
 
 	return 0;
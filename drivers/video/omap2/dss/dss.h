@@ -481,6 +481,7 @@ int dispc_setup_plane(enum omap_plane plane,
 		      u8 global_alpha, u8 pre_mult_alpha,
 		      enum omap_channel channel,
 		      u32 puv_addr, bool source_of_wb);
+int dispc_set_plane_addr(enum omap_plane plane, u32 paddr, u32 puv_addr);
 int dispc_scaling_decision(u16 width, u16 height,
 		u16 out_width, u16 out_height,
 		enum omap_plane plane,
@@ -519,6 +519,9 @@ struct overlay_cache_data {
 	 * registers. Set when writing to shadow registers, cleared at
 	 * VSYNC/EVSYNC */
 	bool shadow_dirty;
+	/* If true, only the buffer addresses changed since the configuration
+	 * last written, so only the base address registers need updating. */
+	bool ba_only;
 
 	bool enabled;
 
@@ -1018,6 +1021,11 @@ static int configure_overlay(enum omap_plane plane)
 
 	mc = &dss_cache.manager_cache[c->channel];
 
+	if (c->ba_only && !m2m_with_ovl && !m2m_with_mgr &&
+	    !(c->manual_update && mc->do_manual_update) &&
+	    !dispc_set_plane_addr(plane, c->paddr, c->p_uv_addr))
+		return 0;
+
 	x = c->pos_x;
 	y = c->pos_y;
 	w = c->width;
@@ -1173,6 +1181,41 @@ static int configure_overlay(enum omap_plane plane)
 	return 0;
 }
 
+/* returns true if the new overlay info differs from the cache only in the
+ * buffer addresses */
+static bool overlay_cache_ba_only(struct overlay_cache_data *oc,
+				  struct omap_overlay_info *info,
+				  struct omap_overlay_manager *mgr)
+{
+	if (!oc->enabled || !info->enabled || mgr->device_changed)
+		return false;
+
+	/* a full configuration is still pending */
+	if (oc->dirty && !oc->ba_only)
+		return false;
+
+	return oc->channel == mgr->id &&
+		oc->screen_width == info->screen_width &&
+		oc->width == info->width &&
+		oc->height == info->height &&
+		oc->color_mode == info->color_mode &&
+		oc->rotation == info->rotation &&
+		oc->rotation_type == info->rotation_type &&
+		oc->mirror == info->mirror &&
+		oc->pos_x == info->pos_x &&
+		oc->pos_y == info->pos_y &&
+		oc->out_width == info->out_width &&
+		oc->out_height == info->out_height &&
+		oc->global_alpha == info->global_alpha &&
+		oc->pre_mult_alpha == info->pre_mult_alpha &&
+		oc->zorder == info->zorder &&
+		oc->min_x_decim == info->min_x_decim &&
+		oc->max_x_decim == info->max_x_decim &&
+		oc->min_y_decim == info->min_y_decim &&
+		oc->max_y_decim == info->max_y_decim &&
+		!memcmp(&oc->cconv, &info->cconv, sizeof(oc->cconv));
+}
+
 static void configure_manager(enum omap_channel channel)
 {
 	struct manager_cache_data *c;
@@ -2048,6 +2091,7 @@ static int omap_dss_mgr_apply(struct omap_overlay_manager *mgr)
 		ovl->info.cb.fn = NULL;
 
 		ovl->info_dirty = false;
+		oc->ba_only = overlay_cache_ba_only(oc, &ovl->info, mgr);
 		if (ovl->info.enabled || oc->enabled)
 			oc->dirty = true;
 		oc->enabled = ovl->info.enabled;
@@ -368,6 +368,14 @@ done:
 		info.color_mode, info.zorder, info.global_alpha,
 		info.pre_mult_alpha);
 #endif
+	/*
+	 * Skip unchanged overlays so that apply does not reprogram DISPC for
+	 * them. info started out as a copy of ovl->info, so any padding
+	 * matches as well. The callback is not part of the comparison.
+	 */
+	if (!memcmp(&info, &ovl->info, offsetof(struct omap_overlay_info, cb)))
+		return 0;
+
 	/* set overlay info */
 	return ovl->set_overlay_info(ovl, &info);
 }
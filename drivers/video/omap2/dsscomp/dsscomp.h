@@ -114,6 +114,7 @@ struct dsscomp_data {
 	void *extra_cb_data;
 	bool must_apply;	/* whether composition must be applied */
 	bool m2m_only;
+	struct dsscomp_data *apply_next;	/* link on manager apply list */
 #ifdef CONFIG_DEBUG_FS
 	struct list_head dbg_q;
 	u32 dbg_used;
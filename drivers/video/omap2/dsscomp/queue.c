@@ -24,6 +24,8 @@
 #include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/ratelimit.h>
+#include <linux/kthread.h>
+#include <linux/wait.h>
 
 #include <video/omapdss.h>
 #include <video/dsscomp.h>
@@ -34,7 +36,12 @@
 #include "dsscomp.h"
 /* queue state */
 
-static DEFINE_MUTEX(mtx);
+/*
+ * Apply threads run just below the default priority of threaded interrupt
+ * handlers, so that a composition is applied before the next VSYNC even
+ * when the system is busy.
+ */
+#define DSSCOMP_APPLY_PRIO	(MAX_USER_RT_PRIO / 2 - 1)
 
 /* free overlay structs */
 struct maskref {
@@ -42,15 +49,27 @@ struct maskref {
 	u32 refs[MAX_OVERLAYS];
 };
 
+/*
+ * Each manager has its own lock, apply thread and callback work queue, so
+ * that the pipelines of different displays do not stall each other. Only
+ * the overlay ownership masks are shared, and these are protected by
+ * qmask_lock.
+ */
 static struct {
-	struct workqueue_struct *apply_workq;
+	struct mutex mtx;	/* composition state on this manager */
+
+	/* lockless list of compositions to apply, newest first */
+	struct dsscomp_data *apply_head;
+	wait_queue_head_t apply_wait;
+	struct task_struct *apply_task;
+	struct workqueue_struct *cb_wkq;	/* callback work queue */
 
 	u32 ovl_mask;		/* overlays used on this display */
 	struct maskref ovl_qmask;		/* overlays queued to this display */
 	bool blanking;
 } mgrq[MAX_MANAGERS];
 
-static struct workqueue_struct *cb_wkq;		/* callback work queue */
+static DEFINE_SPINLOCK(qmask_lock);
 static struct dsscomp_dev *cdev;
 
 #ifdef CONFIG_DEBUG_FS
@@ -105,18 +124,25 @@ struct dsscomp_cb_work {
 	int status;
 };
 
-struct dsscomp_apply_work {
-	struct work_struct work;
-	dsscomp_t comp;
-};
-
 /* Local caches */
 static struct kmem_cache *dsscomp_cb_wk_cachep;
-static struct kmem_cache *dsscomp_app_wk_cachep;
+
+static int dsscomp_apply_thread(void *data);
+
+static void dsscomp_queue_free(u32 ix)
+{
+	if (mgrq[ix].apply_task)
+		kthread_stop(mgrq[ix].apply_task);
+	if (mgrq[ix].cb_wkq)
+		destroy_workqueue(mgrq[ix].cb_wkq);
+	mgrq[ix].apply_task = NULL;
+	mgrq[ix].cb_wkq = NULL;
+}
 
 /* Initialize queue structures, and set up state of the displays */
 int dsscomp_queue_init(struct dsscomp_dev *cdev_)
 {
+	struct sched_param param = { .sched_priority = DSSCOMP_APPLY_PRIO };
 	u32 i, j;
 	cdev = cdev_;
 
@@ -126,9 +152,24 @@ int dsscomp_queue_init(struct dsscomp_dev *cdev_)
 	ZERO(mgrq);
 	for (i = 0; i < cdev->num_mgrs; i++) {
 		struct omap_overlay_manager *mgr;
-		mgrq[i].apply_workq = create_singlethread_workqueue("dsscomp_apply");
-		if (!mgrq[i].apply_workq)
+
+		mutex_init(&mgrq[i].mtx);
+		init_waitqueue_head(&mgrq[i].apply_wait);
+
+		mgrq[i].cb_wkq = create_singlethread_workqueue("dsscomp_cb");
+		if (!mgrq[i].cb_wkq)
+			goto error;
+
+		mgrq[i].apply_task = kthread_run(dsscomp_apply_thread,
+						 (void *) i,
+						 "dsscomp_apply/%u", i);
+		if (IS_ERR(mgrq[i].apply_task)) {
+			mgrq[i].apply_task = NULL;
+			destroy_workqueue(mgrq[i].cb_wkq);
+			mgrq[i].cb_wkq = NULL;
 			goto error;
+		}
+		sched_setscheduler(mgrq[i].apply_task, SCHED_FIFO, &param);
 
 		/* record overlays on this display */
 		mgr = cdev->mgrs[i];
@@ -143,10 +184,6 @@ int dsscomp_queue_init(struct dsscomp_dev *cdev_)
 				mgrq[i].ovl_mask |= 1 << OMAP_DSS_WB;
 	}
 
-	cb_wkq = create_singlethread_workqueue("dsscomp_cb");
-	if (!cb_wkq)
-		goto error;
-
 	/* create cache for dsscomp_cb_work structures */
 	if (!dsscomp_cb_wk_cachep) {
 		dsscomp_cb_wk_cachep = kmem_cache_create("cb_wk_cache",
@@ -159,23 +196,10 @@ int dsscomp_queue_init(struct dsscomp_dev *cdev_)
 		}
 	}
 
-	/* create cache for dsscomp_apply_work structures */
-	if (!dsscomp_app_wk_cachep) {
-		dsscomp_app_wk_cachep = kmem_cache_create("app_wk_cache",
-					sizeof(struct dsscomp_apply_work), 0,
-						SLAB_HWCACHE_ALIGN, NULL);
-		if (!dsscomp_app_wk_cachep) {
-			pr_err("DSSCOMP: %s: can't create cache\n", __func__);
-			/* destroy previously created cache */
-			kmem_cache_destroy(dsscomp_cb_wk_cachep);
-			goto error;
-		}
-	}
-
 	return 0;
 error:
 	while (i--)
-		destroy_workqueue(mgrq[i].apply_workq);
+		dsscomp_queue_free(i);
 	return -ENOMEM;
 }
 
@@ -239,10 +263,10 @@ u32 dsscomp_get_ovls(dsscomp_t comp)
 {
 	u32 mask;
 
-	mutex_lock(&mtx);
+	mutex_lock(&mgrq[comp->ix].mtx);
 	BUG_ON(comp->state != DSSCOMP_STATE_ACTIVE);
 	mask = comp->ovl_mask;
-	mutex_unlock(&mtx);
+	mutex_unlock(&mgrq[comp->ix].mtx);
 
 	return mask;
 }
@@ -255,13 +279,12 @@ int dsscomp_set_ovl(dsscomp_t comp, struct dss2_ovl_info *ovl)
 	u32 i, mask, oix, ix;
 	struct omap_overlay *o;
 
-	mutex_lock(&mtx);
+	ix = comp->ix;
+	mutex_lock(&mgrq[ix].mtx);
 
 	BUG_ON(!ovl);
 	BUG_ON(comp->state != DSSCOMP_STATE_ACTIVE);
 
-	ix = comp->ix;
-
 	if (ovl->cfg.ix >= cdev->num_ovls && ovl->cfg.ix != OMAP_DSS_WB) {
 		r = -EINVAL;
 		goto done;
@@ -281,13 +304,15 @@ int dsscomp_set_ovl(dsscomp_t comp, struct dss2_ovl_info *ovl)
 		if (comp->frm.num_ovls >= ARRAY_SIZE(comp->ovls))
 			goto done;
 
+		spin_lock(&qmask_lock);
+
 		/* not in any other displays queue */
 		if (mask & ~mgrq[ix].ovl_qmask.mask) {
 			for (i = 0; i < cdev->num_mgrs; i++) {
 				if (i == ix)
 					continue;
 				if (mgrq[i].ovl_qmask.mask & mask)
-					goto done;
+					goto done_qmask;
 			}
 		}
 
@@ -296,19 +321,24 @@ int dsscomp_set_ovl(dsscomp_t comp, struct dss2_ovl_info *ovl)
 		if (ovl->cfg.ix != OMAP_DSS_WB) {
 			if (o->info.enabled &&
 			   (!o->manager || o->manager->id != ix))
-				goto done;
+				goto done_qmask;
 		}
 
 		/* add overlay to composition & display */
 		comp->ovl_mask |= mask;
 		oix = comp->frm.num_ovls++;
 		maskref_incbit(&mgrq[ix].ovl_qmask, ovl->cfg.ix);
+
+		spin_unlock(&qmask_lock);
 	}
 
 	comp->ovls[oix] = *ovl;
 	r = 0;
+	goto done;
+done_qmask:
+	spin_unlock(&qmask_lock);
 done:
-	mutex_unlock(&mtx);
+	mutex_unlock(&mgrq[ix].mtx);
 
 	return r;
 }
@@ -320,7 +350,7 @@ int dsscomp_get_ovl(dsscomp_t comp, u32 ix, struct dss2_ovl_info *ovl)
 	int r;
 	u32 oix;
 
-	mutex_lock(&mtx);
+	mutex_lock(&mgrq[comp->ix].mtx);
 
 	BUG_ON(!ovl);
 	BUG_ON(comp->state != DSSCOMP_STATE_ACTIVE);
@@ -339,7 +369,7 @@ int dsscomp_get_ovl(dsscomp_t comp, u32 ix, struct dss2_ovl_info *ovl)
 		r = -ENOENT;
 	}
 
-	mutex_unlock(&mtx);
+	mutex_unlock(&mgrq[comp->ix].mtx);
 
 	return r;
 }
@@ -348,14 +378,14 @@ EXPORT_SYMBOL(dsscomp_get_ovl);
 /* set manager info */
 int dsscomp_set_mgr(dsscomp_t comp, struct dss2_mgr_info *mgr)
 {
-	mutex_lock(&mtx);
+	mutex_lock(&mgrq[comp->ix].mtx);
 
 	BUG_ON(comp->state != DSSCOMP_STATE_ACTIVE);
 	BUG_ON(mgr->ix != comp->frm.mgr.ix);
 
 	comp->frm.mgr = *mgr;
 
-	mutex_unlock(&mtx);
+	mutex_unlock(&mgrq[comp->ix].mtx);
 
 	return 0;
 }
@@ -364,14 +394,14 @@ EXPORT_SYMBOL(dsscomp_set_mgr);
 /* get manager info */
 int dsscomp_get_mgr(dsscomp_t comp, struct dss2_mgr_info *mgr)
 {
-	mutex_lock(&mtx);
+	mutex_lock(&mgrq[comp->ix].mtx);
 
 	BUG_ON(!mgr);
 	BUG_ON(comp->state != DSSCOMP_STATE_ACTIVE);
 
 	*mgr = comp->frm.mgr;
 
-	mutex_unlock(&mtx);
+	mutex_unlock(&mgrq[comp->ix].mtx);
 
 	return 0;
 }
@@ -381,14 +411,14 @@ EXPORT_SYMBOL(dsscomp_get_mgr);
 int dsscomp_setup(dsscomp_t comp, enum dsscomp_setup_mode mode,
 			struct dss2_rect_t win)
 {
-	mutex_lock(&mtx);
+	mutex_lock(&mgrq[comp->ix].mtx);
 
 	BUG_ON(comp->state != DSSCOMP_STATE_ACTIVE);
 
 	comp->frm.mode = mode;
 	comp->frm.win = win;
 
-	mutex_unlock(&mtx);
+	mutex_unlock(&mgrq[comp->ix].mtx);
 
 	return 0;
 }
@@ -402,8 +432,11 @@ EXPORT_SYMBOL(dsscomp_setup);
 void dsscomp_drop(dsscomp_t comp)
 {
 	/* decrement unprogrammed references */
-	if (comp->state < DSSCOMP_STATE_PROGRAMMED)
+	if (comp->state < DSSCOMP_STATE_PROGRAMMED) {
+		spin_lock(&qmask_lock);
 		maskref_decmask(&mgrq[comp->ix].ovl_qmask, comp->ovl_mask);
+		spin_unlock(&qmask_lock);
+	}
 	comp->state = 0;
 
 	if (debug & DEBUG_COMPOSITIONS)
@@ -424,10 +457,10 @@ static void dsscomp_mgr_delayed_cb(struct work_struct *work)
 
 	kmem_cache_free(dsscomp_cb_wk_cachep, wk);
 
-	mutex_lock(&mtx);
+	ix = comp->ix;
+	mutex_lock(&mgrq[ix].mtx);
 
 	BUG_ON(comp->state == DSSCOMP_STATE_ACTIVE);
-	ix = comp->ix;
 
 	/* call extra callbacks if requested */
 	if (comp->extra_cb)
@@ -439,8 +472,10 @@ static void dsscomp_mgr_delayed_cb(struct work_struct *work)
 		log_state(comp, dsscomp_mgr_delayed_cb, status);
 
 		/* update used overlay mask */
+		spin_lock(&qmask_lock);
 		mgrq[ix].ovl_mask = comp->ovl_mask & ~comp->ovl_dmask;
 		maskref_decmask(&mgrq[ix].ovl_qmask, comp->ovl_mask);
+		spin_unlock(&qmask_lock);
 
 		if (debug & DEBUG_PHASES)
 			dev_info(DEV(cdev), "[%p] programmed\n", comp);
@@ -458,7 +493,7 @@ static void dsscomp_mgr_delayed_cb(struct work_struct *work)
 				(u32) log_status_str(status));
 		dsscomp_drop(comp);
 	}
-	mutex_unlock(&mtx);
+	mutex_unlock(&mgrq[ix].mtx);
 }
 
 u32 dsscomp_mgr_callback(void *data, int id, int status)
@@ -482,7 +517,7 @@ u32 dsscomp_mgr_callback(void *data, int id, int status)
 		wk->comp = comp;
 		wk->status = status;
 		INIT_WORK(&wk->work, dsscomp_mgr_delayed_cb);
-		queue_work(cb_wkq, &wk->work);
+		queue_work(mgrq[comp->ix].cb_wkq, &wk->work);
 	}
 
 	/* get each callback only once */
@@ -618,7 +653,7 @@ int dsscomp_apply(dsscomp_t comp)
 			}
 
 			if (ovl->manager != mgr) {
-				mutex_lock(&mtx);
+				mutex_lock(&mgrq[comp->ix].mtx);
 				if (!mgrq[comp->ix].blanking || m2m_mgr_mode) {
 					/*
 					 * Ideally, we should call
@@ -640,7 +675,7 @@ int dsscomp_apply(dsscomp_t comp)
 						, mgr->name, oi->cfg.ix);
 					r = -ENODEV;
 				}
-				mutex_unlock(&mtx);
+				mutex_unlock(&mgrq[comp->ix].mtx);
 
 				if (r)
 					goto skip_ovl_set;
@@ -689,10 +724,10 @@ skip_ovl_set:
 			if ((~comp->ovl_mask & mask) &&
 			    cdev->ovls[i]->info.enabled &&
 			    cdev->ovls[i]->manager == mgr) {
-				mutex_lock(&mtx);
+				spin_lock(&qmask_lock);
 				comp->ovl_mask |= mask;
 				maskref_incbit(&mgrq[comp->ix].ovl_qmask, i);
-				mutex_unlock(&mtx);
+				spin_unlock(&qmask_lock);
 			}
 		}
 		/*
@@ -704,10 +739,10 @@ skip_ovl_set:
 			if ((~comp->ovl_mask & mask) &&
 			    cdev->wb_ovl->info.enabled &&
 			    cdev->wb_ovl->info.source == mgr->id) {
-				mutex_lock(&mtx);
+				spin_lock(&qmask_lock);
 				comp->ovl_mask |= mask;
 				maskref_incbit(&mgrq[comp->ix].ovl_qmask, i);
-				mutex_unlock(&mtx);
+				spin_unlock(&qmask_lock);
 			}
 		}
 	}
@@ -742,7 +777,7 @@ skip_ovl_set:
 			wb->register_framedone(wb);
 	}
 
-	mutex_lock(&mtx);
+	mutex_lock(&mgrq[comp->ix].mtx);
 	if (mgrq[comp->ix].blanking && !m2m_mgr_mode) {
 		pr_info_ratelimited("ignoring apply mgr(%s) while blanking\n",
 								mgr->name);
@@ -763,7 +798,7 @@ skip_ovl_set:
 		if (!r && !cb_programmed)
 			r = -EINVAL;
 	}
-	mutex_unlock(&mtx);
+	mutex_unlock(&mgrq[comp->ix].mtx);
 
 	/*
 	 * TRICKY: try to unregister callback to see if callbacks have
@@ -827,53 +862,89 @@ int dsscomp_state_notifier(struct notifier_block *nb,
 	enum omap_dss_display_state state = arg;
 	struct omap_overlay_manager *mgr = dssdev->manager;
 	if (mgr) {
-		mutex_lock(&mtx);
+		mutex_lock(&mgrq[mgr->id].mtx);
 		if (state == OMAP_DSS_DISPLAY_DISABLED) {
 			mgr->blank(mgr, true);
 			mgrq[mgr->id].blanking = true;
 		} else if (state == OMAP_DSS_DISPLAY_ACTIVE) {
 			mgrq[mgr->id].blanking = false;
 		}
-		mutex_unlock(&mtx);
+		mutex_unlock(&mgrq[mgr->id].mtx);
 	}
 	return 0;
 }
 
-static void dsscomp_do_apply(struct work_struct *work)
+static void dsscomp_do_apply(dsscomp_t comp)
 {
-	struct dsscomp_apply_work *wk = container_of(work, typeof(*wk), work);
 	/* complete compositions that failed to apply */
-	if (dsscomp_apply(wk->comp))
-		dsscomp_mgr_callback(wk->comp, -1, DSS_COMPLETION_ECLIPSED_SET);
-	kmem_cache_free(dsscomp_app_wk_cachep, wk);
+	if (dsscomp_apply(comp))
+		dsscomp_mgr_callback(comp, -1, DSS_COMPLETION_ECLIPSED_SET);
 }
 
-int dsscomp_delayed_apply(dsscomp_t comp)
+/* apply all queued compositions of a manager in submission order */
+static void dsscomp_apply_drain(u32 ix)
 {
-	/* don't block in case we are called from interrupt context */
-	struct dsscomp_apply_work *wk;
+	struct dsscomp_data *comp, *next, *list = NULL;
+
+	/* detach the whole list, then reverse it to get FIFO order */
+	comp = xchg(&mgrq[ix].apply_head, NULL);
+	while (comp) {
+		next = comp->apply_next;
+		comp->apply_next = list;
+		list = comp;
+		comp = next;
+	}
 
-	/* allocate work object from cache */
-	wk = kmem_cache_zalloc(dsscomp_app_wk_cachep, GFP_NOWAIT);
-	if (!wk) {
-		pr_warn("DSSCOMP: %s: can't allocate object from cache\n",
-								__func__);
-		return -ENOMEM;
+	for (comp = list; comp; comp = next) {
+		next = comp->apply_next;
+		dsscomp_do_apply(comp);
+	}
+}
+
+static int dsscomp_apply_thread(void *data)
+{
+	u32 ix = (u32) data;
+
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(mgrq[ix].apply_wait,
+					 ACCESS_ONCE(mgrq[ix].apply_head) ||
+					 kthread_should_stop());
+		dsscomp_apply_drain(ix);
 	}
 
-	mutex_lock(&mtx);
+	/* do not leave compositions behind */
+	dsscomp_apply_drain(ix);
+	return 0;
+}
+
+int dsscomp_delayed_apply(dsscomp_t comp)
+{
+	struct dsscomp_data *head;
+	u32 ix = comp->ix;
 
+	/* the composition is still private to the caller, so no locking */
 	BUG_ON(comp->state != DSSCOMP_STATE_ACTIVE);
 	comp->state = DSSCOMP_STATE_APPLYING;
 	log_state(comp, dsscomp_delayed_apply, 0);
 
 	if (debug & DEBUG_PHASES)
 		dev_info(DEV(cdev), "[%p] applying\n", comp);
-	mutex_unlock(&mtx);
 
-	wk->comp = comp;
-	INIT_WORK(&wk->work, dsscomp_do_apply);
-	return queue_work(mgrq[comp->ix].apply_workq, &wk->work) ? 0 : -EBUSY;
+	if (!mgrq[ix].apply_task)
+		return -EBUSY;
+
+	/*
+	 * Push onto the manager's apply list without taking any lock, so
+	 * we never block behind an apply in progress. cmpxchg implies a
+	 * full barrier, which publishes the composition to the apply thread.
+	 */
+	do {
+		head = ACCESS_ONCE(mgrq[ix].apply_head);
+		comp->apply_next = head;
+	} while (cmpxchg(&mgrq[ix].apply_head, head, comp) != head);
+
+	wake_up(&mgrq[ix].apply_wait);
+	return 0;
 }
 EXPORT_SYMBOL(dsscomp_delayed_apply);
 
@@ -987,9 +1058,8 @@ void dsscomp_queue_exit(void)
 {
 	if (cdev) {
 		int i;
-		for (i = 0; i < cdev->num_displays; i++)
-			destroy_workqueue(mgrq[i].apply_workq);
-		destroy_workqueue(cb_wkq);
+		for (i = 0; i < cdev->num_mgrs; i++)
+			dsscomp_queue_free(i);
 		cdev = NULL;
 	}
 }
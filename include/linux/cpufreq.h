@@ -331,6 +331,35 @@ static inline unsigned int cpufreq_quick_get(unsigned int cpu)
 }
 #endif
 
+/*
+ * Frequency invariance: the capacity of a CPU at its current frequency and
+ * at the highest frequency it may currently run at, relative to its fastest
+ * OPP.  Drivers publish it on every transition; it reads as full capacity
+ * until they do.  The scale matches SCHED_POWER_SCALE.
+ */
+#define CPUFREQ_CAPACITY_SHIFT	10
+#define CPUFREQ_CAPACITY_SCALE	(1UL << CPUFREQ_CAPACITY_SHIFT)
+
+#ifdef CONFIG_CPU_FREQ
+void cpufreq_set_capacity(unsigned int cpu, unsigned long cur,
+			  unsigned long max);
+unsigned long cpufreq_cur_capacity(unsigned int cpu);
+unsigned long cpufreq_max_capacity(unsigned int cpu);
+#else
+static inline void cpufreq_set_capacity(unsigned int cpu, unsigned long cur,
+					unsigned long max)
+{
+}
+static inline unsigned long cpufreq_cur_capacity(unsigned int cpu)
+{
+	return CPUFREQ_CAPACITY_SCALE;
+}
+static inline unsigned long cpufreq_max_capacity(unsigned int cpu)
+{
+	return CPUFREQ_CAPACITY_SCALE;
+}
+#endif
+
 #if defined(CONFIG_CPU_FREQ_GOV_INTERACTIVE) && \
 					defined(CONFIG_OMAP4_DPLL_CASCADING)
 extern void cpufreq_interactive_set_timer_rate(unsigned long val,
@@ -369,6 +398,9 @@ extern struct cpufreq_governor cpufreq_gov_interactive;
 #elif defined(CONFIG_CPU_FREQ_DEFAULT_GOV_HOTPLUG)
 extern struct cpufreq_governor cpufreq_gov_hotplug;
 #define CPUFREQ_DEFAULT_GOVERNOR	(&cpufreq_gov_hotplug)
+#elif defined(CONFIG_CPU_FREQ_DEFAULT_GOV_ENERGY)
+extern struct cpufreq_governor cpufreq_gov_energy;
+#define CPUFREQ_DEFAULT_GOVERNOR	(&cpufreq_gov_energy)
 #endif
 
 
@@ -38,6 +38,8 @@
 #include <linux/workqueue.h>
 #include <linux/notifier.h>
 #include <linux/pm_qos_params.h>
+#include <linux/ktime.h>
+#include <linux/wait.h>
 
 /* Must match the BIOS version embeded in the BIOS firmware image */
 #define RPROC_BIOS_VERSION	2
@@ -140,6 +142,75 @@ struct rproc_mem_entry {
 	bool core;
 };
 
+/**
+ * struct rproc_fw_segment - a loadable image section kept in the fw cache
+ *
+ * @type:	fw_section_type of the section (FW_TEXT or FW_DATA)
+ * @da:		device address the section is loaded at
+ * @pa:		physical address the section was last copied to
+ * @len:	length of the section
+ * @crc:	sampled crc32 of @content, checked before resident text is reused
+ * @content:	section payload, inside the cache's data area
+ */
+struct rproc_fw_segment {
+	u32 type;
+	u64 da;
+	phys_addr_t pa;
+	u32 len;
+	u32 crc;
+	void *content;
+};
+
+/**
+ * struct rproc_fw_cache - pre-parsed firmware image kept across stops
+ *
+ * @header:	copy of the textual image header
+ * @header_len:	length of @header
+ * @rsc:	pristine copy of the resource table
+ * @rsc_da:	device address the resource table is loaded at
+ * @rsc_len:	length of @rsc
+ * @segs:	loadable sections, in image order
+ * @num_segs:	number of entries in @segs
+ * @data:	vmalloc'ed area backing the section payloads
+ * @resident:	the text sections are still intact in the carveout
+ */
+struct rproc_fw_cache {
+	char *header;
+	int header_len;
+	void *rsc;
+	u64 rsc_da;
+	u32 rsc_len;
+	struct rproc_fw_segment *segs;
+	int num_segs;
+	void *data;
+	bool resident;
+};
+
+/**
+ * struct rproc_boot_stats - timing of the last boot of a remote processor
+ *
+ * @cold_boots:	boots which went through request_firmware
+ * @cached_boots: boots which were served from the firmware cache
+ * @fw_us:	time spent waiting for request_firmware
+ * @load_us:	time spent parsing and copying the image
+ * @start_us:	time spent in rproc_start
+ * @total_us:	time from rproc_get until the processor was started
+ * @copied:	bytes copied into the carveouts
+ * @skipped:	bytes of resident text which did not need copying
+ * @corrupted:	resident text sections found modified and copied again
+ */
+struct rproc_boot_stats {
+	u32 cold_boots;
+	u32 cached_boots;
+	u32 fw_us;
+	u32 load_us;
+	u32 start_us;
+	u32 total_us;
+	u32 copied;
+	u32 skipped;
+	u32 corrupted;
+};
+
 enum rproc_constraint {
 	RPROC_CONSTRAINT_SCALE,
 	RPROC_CONSTRAINT_LATENCY,
@@ -258,6 +329,16 @@ enum rproc_event {
  * @secure_mode: flag to dictate whether to enable secure loading
  * @secure_ok: restart status flag to be looked up upon the event's completion
  * @secure_reset: flag to uninstall the firewalls
+ * @fw_cache: parsed image used to restart without request_firmware
+ * @fw_cache_work: work which boots the processor from @fw_cache
+ * @boot_stats: timing of the last boot
+ * @boot_start: time the last boot was requested
+ * @trace_wq: wait queue for streaming trace readers
+ * @trace_seq: bumped whenever new trace data may be available
+ * @trace_gen: bumped whenever the trace buffers are (re)mapped
+ * @trace_readers: number of open streaming trace readers
+ * @trace_poll_work: fallback poll for firmware which does not notify
+ * @trace_last_w: write indexes seen by the last fallback poll
  */
 struct rproc {
 	struct list_head next;
@@ -299,6 +380,18 @@ struct rproc {
 	bool halt_on_crash;
 	char *header;
 	int header_len;
+#ifdef CONFIG_REMOTEPROC_FW_CACHE
+	struct rproc_fw_cache *fw_cache;
+	struct work_struct fw_cache_work;
+#endif
+	struct rproc_boot_stats boot_stats;
+	ktime_t boot_start;
+	wait_queue_head_t trace_wq;
+	atomic_t trace_seq;
+	atomic_t trace_gen;
+	int trace_readers;
+	struct delayed_work trace_poll_work;
+	int trace_last_w[2];
 };
 
 int rproc_set_secure(const char *, bool);
@@ -321,5 +414,6 @@ extern const struct dev_pm_ops rproc_gen_pm_ops;
 #endif
 int rproc_set_constraints(struct rproc *, enum rproc_constraint type, long v);
 int rproc_error_notify(struct rproc *rproc);
+void rproc_trace_notify(struct rproc *rproc);
 
 #endif /* REMOTEPROC_H */
@@ -48,6 +48,37 @@ DEFINE_EVENT(cpu, cpu_frequency,
 	TP_ARGS(frequency, cpu_id)
 );
 
+TRACE_EVENT(cpu_frequency_transition,
+
+	TP_PROTO(unsigned int old_freq, unsigned int new_freq,
+		 u32 queue_us, u32 scale_us, unsigned int coalesced),
+
+	TP_ARGS(old_freq, new_freq, queue_us, scale_us, coalesced),
+
+	TP_STRUCT__entry(
+		__field(	u32,		old_freq	)
+		__field(	u32,		new_freq	)
+		__field(	u32,		queue_us	)
+		__field(	u32,		scale_us	)
+		__field(	u32,		coalesced	)
+	),
+
+	TP_fast_assign(
+		__entry->old_freq = old_freq;
+		__entry->new_freq = new_freq;
+		__entry->queue_us = queue_us;
+		__entry->scale_us = scale_us;
+		__entry->coalesced = coalesced;
+	),
+
+	TP_printk("old=%lu new=%lu queued=%luus scaled=%luus coalesced=%lu",
+		  (unsigned long)__entry->old_freq,
+		  (unsigned long)__entry->new_freq,
+		  (unsigned long)__entry->queue_us,
+		  (unsigned long)__entry->scale_us,
+		  (unsigned long)__entry->coalesced)
+);
+
 TRACE_EVENT(machine_suspend,
 
 	TP_PROTO(unsigned int state),
@@ -234,6 +265,43 @@ DEFINE_EVENT(power_domain, power_domain_target,
 
 	TP_ARGS(name, state, cpu_id)
 );
+
+/*
+ * The clock domain events are used for clock domain active (state=1) and
+ * inactive (state=0) transitions, as seen by the clock framework usecount
+ */
+DEFINE_EVENT(power_domain, clock_domain_target,
+
+	TP_PROTO(const char *name, unsigned int state, unsigned int cpu_id),
+
+	TP_ARGS(name, state, cpu_id)
+);
+
+/*
+ * The DPLL events are used for DPLL lock (state=1) and unlock (bypass or
+ * stop, state=0) transitions; lock_us is the time spent waiting for lock
+ */
+TRACE_EVENT(dpll_transition,
+
+	TP_PROTO(const char *name, unsigned int state, unsigned int lock_us),
+
+	TP_ARGS(name, state, lock_us),
+
+	TP_STRUCT__entry(
+		__string(       name,           name            )
+		__field(        u32,            state           )
+		__field(        u32,            lock_us         )
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__entry->state = state;
+		__entry->lock_us = lock_us;
+	),
+
+	TP_printk("%s state=%u lock_us=%u", __get_str(name),
+		__entry->state, __entry->lock_us)
+);
 #endif /* _TRACE_POWER_H */
 
 /* This part must be outside protection */
@@ -1537,6 +1537,9 @@ long do_fork(unsigned long clone_flags,
 		 */
 		p->flags &= ~PF_STARTING;
 
+		if (!(clone_flags & CLONE_THREAD))
+			oom_adj_changed(p);
+
 		wake_up_new_task(p);
 
 		tracehook_report_clone_complete(trace, regs,
@@ -0,0 +1,181 @@
+/*
+ *  LZ4 block compressor
+ *
+ *  Greedy single-pass matcher over a hash table of the last position seen
+ *  for each 4-byte sequence.  Inputs below 64KB (every page-sized user)
+ *  index the table with 16-bit positions, which halves the working memory
+ *  that has to be cleared per call.
+ *
+ *  Compression is deterministic: the same input always produces the same
+ *  output, so callers may compare compressed images to find duplicates.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include <asm/unaligned.h>
+#include "lz4defs.h"
+
+static __always_inline u32 lz4_read32(const unsigned char *p)
+{
+	return get_unaligned((const u32 *)p);
+}
+
+static __always_inline u32 lz4_hash(const unsigned char *p)
+{
+	return (lz4_read32(p) * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+static __always_inline size_t lz4_get_pos(void *table, u32 h, const int small)
+{
+	if (small)
+		return ((u16 *)table)[h];
+	return ((u32 *)table)[h];
+}
+
+static __always_inline void lz4_put_pos(void *table, u32 h, size_t pos,
+					const int small)
+{
+	if (small)
+		((u16 *)table)[h] = pos;
+	else
+		((u32 *)table)[h] = pos;
+}
+
+static __always_inline unsigned char *lz4_put_length(unsigned char *op,
+						     size_t len)
+{
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = len;
+	return op;
+}
+
+static __always_inline size_t
+lz4_do_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, void *table, const int small)
+{
+	const unsigned char * const iend = src + src_len;
+	const unsigned char * const mflimit = iend - LZ4_MFLIMIT;
+	const unsigned char * const matchlimit = iend - LZ4_LASTLITERALS;
+	const unsigned char *ip = src, *anchor = src;
+	unsigned char *op = dst;
+	size_t lit;
+
+	memset(table, 0, (1 << LZ4_HASH_LOG) * (small ? sizeof(u16) :
+						       sizeof(u32)));
+
+	if (src_len < LZ4_MIN_LENGTH)
+		goto last_literals;
+
+	lz4_put_pos(table, lz4_hash(ip), 0, small);
+	ip++;
+
+	for (;;) {
+		const unsigned char *match, *start;
+		unsigned int searches = 1U << LZ4_SKIP_TRIGGER;
+		unsigned int step = 1;
+		unsigned char *token;
+		size_t len;
+
+		/* find a match, stepping faster over incompressible data */
+		for (;;) {
+			u32 h;
+
+			if (unlikely(ip > mflimit))
+				goto last_literals;
+
+			h = lz4_hash(ip);
+			match = src + lz4_get_pos(table, h, small);
+			lz4_put_pos(table, h, ip - src, small);
+
+			if (match < ip && ip - match <= LZ4_MAX_DISTANCE &&
+			    lz4_read32(match) == lz4_read32(ip))
+				break;
+
+			ip += step;
+			step = searches++ >> LZ4_SKIP_TRIGGER;
+		}
+
+		/* extend the match backwards over pending literals */
+		while (ip > anchor && match > src && ip[-1] == match[-1]) {
+			ip--;
+			match--;
+		}
+
+		lit = ip - anchor;
+		token = op++;
+		if (lit >= LZ4_RUN_MASK) {
+			*token = LZ4_RUN_MASK << LZ4_ML_BITS;
+			op = lz4_put_length(op, lit - LZ4_RUN_MASK);
+		} else {
+			*token = lit << LZ4_ML_BITS;
+		}
+		memcpy(op, anchor, lit);
+		op += lit;
+
+		put_unaligned_le16(ip - match, op);
+		op += 2;
+
+		/* extend the match forwards, a word at a time */
+		ip += LZ4_MINMATCH;
+		match += LZ4_MINMATCH;
+		start = ip;
+		while (ip + sizeof(u32) <= matchlimit &&
+		       lz4_read32(ip) == lz4_read32(match)) {
+			ip += sizeof(u32);
+			match += sizeof(u32);
+		}
+		while (ip < matchlimit && *ip == *match) {
+			ip++;
+			match++;
+		}
+
+		len = ip - start;
+		if (len >= LZ4_ML_MASK) {
+			*token |= LZ4_ML_MASK;
+			op = lz4_put_length(op, len - LZ4_ML_MASK);
+		} else {
+			*token |= len;
+		}
+		anchor = ip;
+
+		if (ip > mflimit)
+			break;
+
+		lz4_put_pos(table, lz4_hash(ip - 2), ip - 2 - src, small);
+	}
+
+last_literals:
+	lit = iend - anchor;
+	if (lit >= LZ4_RUN_MASK) {
+		*op++ = LZ4_RUN_MASK << LZ4_ML_BITS;
+		op = lz4_put_length(op, lit - LZ4_RUN_MASK);
+	} else {
+		*op++ = lit << LZ4_ML_BITS;
+	}
+	memcpy(op, anchor, lit);
+	op += lit;
+
+	return op - dst;
+}
+
+int lz4_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem)
+{
+	if (src_len < LZ4_64K_LIMIT)
+		*dst_len = lz4_do_compress(src, src_len, dst, wrkmem, 1);
+	else
+		*dst_len = lz4_do_compress(src, src_len, dst, wrkmem, 0);
+
+	return LZ4_E_OK;
+}
+EXPORT_SYMBOL_GPL(lz4_compress);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Compressor");
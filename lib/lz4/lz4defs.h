@@ -0,0 +1,18 @@
+/*
+ *  lz4defs.h -- common definitions for the LZ4 compressor and decompressor
+ */
+
+#define LZ4_MINMATCH		4
+#define LZ4_LASTLITERALS	5
+#define LZ4_MFLIMIT		(LZ4_MINMATCH + 8)
+#define LZ4_MIN_LENGTH		(LZ4_MFLIMIT + 1)
+#define LZ4_MAX_DISTANCE	65535
+#define LZ4_64K_LIMIT		(65536 + LZ4_MFLIMIT - 1)
+
+/* give up on incompressible data faster after 1 << LZ4_SKIP_TRIGGER misses */
+#define LZ4_SKIP_TRIGGER	6
+
+#define LZ4_ML_BITS		4
+#define LZ4_ML_MASK		((1U << LZ4_ML_BITS) - 1)
+#define LZ4_RUN_BITS		(8 - LZ4_ML_BITS)
+#define LZ4_RUN_MASK		((1U << LZ4_RUN_BITS) - 1)
@@ -586,6 +586,33 @@ int unregister_oom_notifier(struct notifier_block *nb)
 }
 EXPORT_SYMBOL_GPL(unregister_oom_notifier);
 
+static BLOCKING_NOTIFIER_HEAD(oom_adj_notify_list);
+
+int register_oom_adj_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_register(&oom_adj_notify_list, nb);
+}
+EXPORT_SYMBOL_GPL(register_oom_adj_notifier);
+
+int unregister_oom_adj_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_unregister(&oom_adj_notify_list, nb);
+}
+EXPORT_SYMBOL_GPL(unregister_oom_adj_notifier);
+
+/**
+ * oom_adj_changed() - report a new or changed oom_adj of a thread group
+ * @tsk: a task of the thread group, pinned by the caller
+ *
+ * Called, without locks held, when a thread group is created or becomes
+ * led by another task, and after its oom_adj was changed, so that users
+ * like the Android low memory killer can keep an index by oom_adj.
+ */
+void oom_adj_changed(struct task_struct *tsk)
+{
+	blocking_notifier_call_chain(&oom_adj_notify_list, 0, tsk);
+}
+
 /*
  * Try to acquire the OOM killer lock for the zones in zonelist.  Returns zero
  * if a parallel OOM killing is already taking place that includes a zone in